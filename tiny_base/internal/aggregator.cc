@@ -0,0 +1,162 @@
+#include "aggregator.h"
+
+namespace internal {
+
+Aggregator::Aggregator(const std::vector<AggregateSpec>& specs)
+    : specs_(&specs), states_(specs.size(), State{0, 0, 0.0, {}}) {}
+
+void Aggregator::Add(const sql::TypeValueList& tuple) {
+  for (std::size_t i = 0; i < specs_->size(); i++) {
+    const AggregateSpec& spec(specs_->at(i));
+    State& state(states_.at(i));
+
+    // COUNT(*)
+    if (spec.position < 0) {
+      ++state.count;
+      continue;
+    }
+
+    // NULL takes no part in any aggregate
+    const sql::TypeValue& column(tuple.at(spec.position));
+    if (sql::IsTypeCodeNull(column.first)) {
+      continue;
+    }
+    ++state.count;
+
+    switch (spec.type) {
+      case sql::SumAggregate:
+      case sql::AvgAggregate:
+        switch (column.first) {
+          case sql::TinyInt:
+            state.sum_int += sql::ValueCast<int8_t>(column.second);
+            break;
+          case sql::SmallInt:
+            state.sum_int += sql::ValueCast<int16_t>(column.second);
+            break;
+          case sql::Int:
+            state.sum_int += sql::ValueCast<int32_t>(column.second);
+            break;
+          case sql::BigInt:
+            state.sum_int += sql::ValueCast<int64_t>(column.second);
+            break;
+          case sql::Real:
+            state.sum_double += sql::ValueCast<float>(column.second);
+            break;
+          case sql::Double:
+            state.sum_double += sql::ValueCast<double>(column.second);
+            break;
+          default:
+            break;
+        }
+        break;
+      case sql::MinAggregate:
+        if (state.count == 1 ||
+            sql::CompareOrder(column.second, state.extreme.second,
+                              column.first, state.extreme.first) < 0) {
+          state.extreme = column;
+        }
+        break;
+      case sql::MaxAggregate:
+        if (state.count == 1 ||
+            sql::CompareOrder(column.second, state.extreme.second,
+                              column.first, state.extreme.first) > 0) {
+          state.extreme = column;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+void Aggregator::AddRows(const int64_t& row_num) {
+  for (std::size_t i = 0; i < specs_->size(); i++) {
+    if (specs_->at(i).position < 0) {
+      states_.at(i).count += row_num;
+    }
+  }
+}
+
+void Aggregator::Merge(const Aggregator& other) {
+  for (std::size_t i = 0; i < specs_->size(); i++) {
+    State& state(states_.at(i));
+    const State& part(other.states_.at(i));
+
+    if (!part.count) {
+      continue;
+    }
+
+    switch (specs_->at(i).type) {
+      case sql::MinAggregate:
+        if (!state.count ||
+            sql::CompareOrder(part.extreme.second, state.extreme.second,
+                              part.extreme.first, state.extreme.first) < 0) {
+          state.extreme = part.extreme;
+        }
+        break;
+      case sql::MaxAggregate:
+        if (!state.count ||
+            sql::CompareOrder(part.extreme.second, state.extreme.second,
+                              part.extreme.first, state.extreme.first) > 0) {
+          state.extreme = part.extreme;
+        }
+        break;
+      default:
+        break;
+    }
+    state.count += part.count;
+    state.sum_int += part.sum_int;
+    state.sum_double += part.sum_double;
+  }
+}
+
+void Aggregator::GetResult(sql::TypeValueList& tuple) const {
+  const sql::TypeValue null_value(sql::EightByteNull, sql::Value());
+
+  tuple.resize(specs_->size());
+  for (std::size_t i = 0; i < specs_->size(); i++) {
+    const AggregateSpec& spec(specs_->at(i));
+    const State& state(states_.at(i));
+    sql::TypeValue& column(tuple.at(i));
+
+    switch (spec.type) {
+      case sql::CountAggregate:
+        column = sql::TypeValue(sql::BigInt, state.count);
+        break;
+      case sql::SumAggregate:
+        if (!state.count) {
+          column = null_value;
+        } else if (IsIntegral(spec.data_type)) {
+          column = sql::TypeValue(sql::BigInt, state.sum_int);
+        } else {
+          column = sql::TypeValue(sql::Double, state.sum_double);
+        }
+        break;
+      case sql::AvgAggregate:
+        if (!state.count) {
+          column = null_value;
+        } else if (IsIntegral(spec.data_type)) {
+          column = sql::TypeValue(
+              sql::Double, static_cast<double>(state.sum_int) / state.count);
+        } else {
+          column = sql::TypeValue(sql::Double, state.sum_double / state.count);
+        }
+        break;
+      case sql::MinAggregate:
+      case sql::MaxAggregate:
+        if (state.count) {
+          column = state.extreme;
+        } else if (sql::Text == spec.data_type) {
+          column = sql::TypeValue(sql::Text, std::string());
+        } else {
+          column = sql::TypeValue(
+              sql::DataTypeToTypeCode(spec.data_type, "NULL"), sql::Value());
+        }
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+}  // namespace internal
@@ -0,0 +1,58 @@
+#ifndef TINY_BASE_AGGREGATOR_H_
+#define TINY_BASE_AGGREGATOR_H_
+
+#include <vector>
+#include "sql_command.h"
+
+namespace internal {
+
+// one aggregate of a scan, position is the argument in the projected tuple
+// (negative for COUNT(*))
+struct AggregateSpec {
+  sql::AggregateType type;
+  std::ptrdiff_t position;
+  sql::SchemaDataType data_type;
+};
+
+// Folds rows into running aggregates as they stream by, so memory does not
+// grow with the number of rows. The specs are shared, not copied, since
+// GROUP BY keeps one aggregator per group.
+class Aggregator {
+ public:
+  explicit Aggregator(const std::vector<AggregateSpec>& specs);
+
+  void Add(const sql::TypeValueList& tuple);
+
+  // rows known to exist without reading them, only COUNT(*) can use this
+  void AddRows(const int64_t& row_num);
+
+  // folds in the aggregates of other rows over the same specs
+  void Merge(const Aggregator& other);
+
+  // SUM, MIN, MAX and AVG over no values are NULL
+  void GetResult(sql::TypeValueList& tuple) const;
+
+  // memory held by one aggregator over the given specs
+  static std::size_t GetSize(const std::vector<AggregateSpec>& specs) {
+    return sizeof(Aggregator) + specs.size() * sizeof(State);
+  }
+
+ private:
+  struct State {
+    int64_t count;
+    int64_t sum_int;
+    double sum_double;
+    sql::TypeValue extreme;
+  };
+
+  const std::vector<AggregateSpec>* specs_;
+  std::vector<State> states_;
+
+  static bool IsIntegral(const sql::SchemaDataType& data_type) {
+    return (sql::TinyInt <= data_type && data_type <= sql::BigInt);
+  }
+};
+
+}  // namespace internal
+
+#endif  // TINY_BASE_AGGREGATOR_H_
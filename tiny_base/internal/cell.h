@@ -1,68 +1,148 @@
 #ifndef TINY_BASE_CELL_H_
 #define TINY_BASE_CELL_H_
 
+#include <cstring>
+#include <iterator>
+#include <limits>
+
+#include "endian_util.h"
 #include "page_format.h"
 #include "page_manager.h"
 #include "sql_command.h"
 
 namespace internal {
 
-static PageCell GetValue(const PageCell& cell, const std::ptrdiff_t& index) {
-  PageCell value;
+static std::size_t GetValueOffset(const PageCell& cell,
+                                  const std::ptrdiff_t& index) {
   auto column_num(cell.at(table_leaf_payload_num_of_columns_offset));
-  auto offset(table_leaf_payload_type_codes_offset + column_num);
+  std::size_t offset(table_leaf_payload_type_codes_offset + column_num);
 
   // calc offset
   for (auto i = 0; i < index; i++) {
     auto type_code = cell.at(table_leaf_payload_type_codes_offset + i);
-    auto size = sql::TypeCodeToSize(type_code);
-    offset += size;
+    offset += sql::TypeCodeToSize(type_code);
   }
 
-  // get value
-  auto value_type(cell.at(table_leaf_payload_type_codes_offset + index));
-  auto value_size(sql::TypeCodeToSize(value_type));
-  value.resize(value_size);
-  std::copy(cell.begin() + offset, cell.begin() + offset + value_size,
-            value.begin());
+  return offset;
+}
 
-  // swap endian
-  std::reverse(value.begin(), value.end());
+// Read-only view over a leaf cell. Column offsets are computed once per row,
+// or once per schema when every column is fixed width, and values are
+// decoded in place with a single byteswap.
+class CellView {
+ public:
+  CellView(void) : cell_(nullptr), fixed_width_(false) {}
+
+  explicit CellView(const sql::CreateTableCommand& schema)
+      : cell_(nullptr), fixed_width_(true) {
+    std::size_t offset(table_leaf_payload_type_codes_offset +
+                       schema.column_list.size());
+
+    // NULL type codes keep the size of their type, only TEXT varies
+    for (auto column : schema.column_list) {
+      if (sql::Text == column.type) {
+        fixed_width_ = false;
+        break;
+      }
+      offsets_.push_back(offset);
+      offset += sql::SchemaDataTypeSize.at(column.type);
+    }
 
-  return value;
-}
+    if (!fixed_width_) {
+      offsets_.clear();
+    }
+  }
 
-static void GetValues(const PageCell& cell,
-                      const std::vector<std::ptrdiff_t>& indexes,
-                      std::vector<PageCell>& values) {
-  PageCell value;
-  auto column_num(cell.at(table_leaf_payload_num_of_columns_offset));
-  auto offset(table_leaf_payload_type_codes_offset + column_num);
-  auto value_type(0);
-  auto value_size(0);
-
-  // loop through cell
-  for (auto i = 0, j = 0; i < column_num, j < column_num; i++) {
-    value_type = cell.at(table_leaf_payload_type_codes_offset + i);
-    value_size = sql::TypeCodeToSize(value_type);
-    // accumulate offset
-    if (i != indexes.at(j)) {
-      offset += value_size;
-      continue;
+  void Bind(const PageCell& cell) { Bind(cell.data()); }
+
+  void Bind(const char* cell) {
+    Bind(cell, std::numeric_limits<std::size_t>::max());
+  }
+
+  // only locate the first column_limit columns, later ones are not read
+  void Bind(const char* cell, const std::size_t& column_limit) {
+    cell_ = cell;
+
+    if (fixed_width_ && offsets_.size() == GetColumnNum()) {
+      return;
+    }
+
+    fixed_width_ = false;
+    std::size_t column_num(
+        std::min(column_limit, static_cast<std::size_t>(GetColumnNum())));
+    offsets_.resize(column_num);
+    std::size_t offset(table_leaf_payload_type_codes_offset + GetColumnNum());
+    for (auto i = 0; i < column_num; i++) {
+      offsets_[i] = offset;
+      offset += sql::TypeCodeToSize(GetTypeCode(i));
     }
-    // get value
-    value.clear();
-    value.resize(value_size);
-    std::copy(cell.begin() + offset, cell.begin() + offset + value_size,
-              value.begin());
-    // swap endian
-    std::reverse(value.begin(), value.end());
-    values.push_back(value);
-
-    offset += value_size;
-    j++;
   }
-}
+
+  uint8_t GetColumnNum(void) const {
+    return cell_[table_leaf_payload_num_of_columns_offset];
+  }
+
+  sql::TypeCode GetTypeCode(const std::ptrdiff_t& index) const {
+    return cell_[table_leaf_payload_type_codes_offset + index];
+  }
+
+  const char* GetData(const std::ptrdiff_t& index) const {
+    return cell_ + offsets_[index];
+  }
+
+  sql::Value GetValue(const std::ptrdiff_t& index) const {
+    sql::TypeCode type_code(GetTypeCode(index));
+    const char* data(GetData(index));
+    sql::Value value;
+
+    switch (type_code) {
+      case sql::TinyInt:
+        value = Read<int8_t>(data);
+        break;
+      case sql::SmallInt:
+        value = Read<int16_t>(data);
+        break;
+      case sql::Int:
+        value = Read<int32_t>(data);
+        break;
+      case sql::BigInt:
+      case sql::DateTime:
+      case sql::Date:
+        value = Read<int64_t>(data);
+        break;
+      case sql::Real:
+        value = Read<float>(data);
+        break;
+      case sql::Double:
+        value = Read<double>(data);
+        break;
+      default:
+        break;
+    }
+
+    // contain empty string for NULL (text is stored reversed)
+    if (type_code >= sql::Text) {
+      using ReverseIterator = std::reverse_iterator<const char*>;
+      value = std::string(
+          ReverseIterator(data + sql::TypeCodeToSize(type_code)),
+          ReverseIterator(data));
+    }
+
+    return value;
+  }
+
+ private:
+  const char* cell_;
+  bool fixed_width_;
+  std::vector<std::size_t> offsets_;
+
+  template <typename T>
+  static T Read(const char* data) {
+    T value;
+    std::memcpy(&value, data, sizeof(value));
+    return utils::SwapEndian<T>(value);
+  }
+};
 
 static bool UpdateValue(PageCell& cell, const std::ptrdiff_t& index,
                         const sql::TypeCode& type_code,
@@ -77,15 +157,7 @@ static bool UpdateValue(PageCell& cell, const std::ptrdiff_t& index,
     return false;
   }
 
-  auto column_num(cell.at(table_leaf_payload_num_of_columns_offset));
-  auto offset(table_leaf_payload_type_codes_offset + column_num);
-
-  // calc offset
-  for (auto i = 0; i < index; i++) {
-    auto type_code = cell.at(table_leaf_payload_type_codes_offset + i);
-    auto size = sql::TypeCodeToSize(type_code);
-    offset += size;
-  }
+  auto offset(GetValueOffset(cell, index));
 
   // modify type code
   cell.at(table_leaf_payload_type_codes_offset + index) = type_code;
@@ -125,14 +197,6 @@ static sql::TypeCode GetTypeCode(const PageCell& cell,
   return cell.at(table_leaf_payload_type_codes_offset + index);
 }
 
-static void GetTypeCodes(const PageCell& cell,
-                         const std::vector<std::ptrdiff_t>& indexes,
-                         std::vector<sql::TypeCode>& type_codes) {
-  for (auto index : indexes) {
-    type_codes.push_back(GetTypeCode(cell, index));
-  }
-}
-
 }  // namespace internal
 
 #endif  // TINY_BASE_CELL_H_
@@ -0,0 +1,452 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include "csv_loader.h"
+#include "endian_util.h"
+#include "page_format.h"
+
+namespace internal {
+
+namespace {
+
+constexpr int64_t seconds_per_day = 86400;
+
+// days since 1970-01-01 of a date in the proleptic Gregorian calendar
+int64_t DaysFromCivil(int64_t year, const int64_t& month, const int64_t& day) {
+  year -= (month <= 2);
+  const int64_t era((year >= 0 ? year : year - 399) / 400);
+  const int64_t year_of_era(year - era * 400);
+  const int64_t day_of_year((153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 +
+                            day - 1);
+  const int64_t day_of_era(year_of_era * 365 + year_of_era / 4 -
+                           year_of_era / 100 + day_of_year);
+
+  return era * 146097 + day_of_era - 719468;
+}
+
+int64_t DaysInMonth(const int64_t& year, const int64_t& month) {
+  static const int64_t days[] = {31, 28, 31, 30, 31, 30,
+                                 31, 31, 30, 31, 30, 31};
+  bool leap((year % 4 == 0 && year % 100 != 0) || year % 400 == 0);
+
+  return (2 == month && leap) ? 29 : days[month - 1];
+}
+
+// digits from pos up to max_digits of them, at least one
+bool ParseDigits(const char*& pos, const char* end,
+                 const std::size_t& max_digits, int64_t& value) {
+  const char* begin(pos);
+
+  value = 0;
+  while (pos < end && pos - begin < static_cast<std::ptrdiff_t>(max_digits) &&
+         *pos >= '0' && *pos <= '9') {
+    value = value * 10 + (*pos++ - '0');
+  }
+  return (pos != begin);
+}
+
+bool ParseInteger(const CsvField& field, const int64_t& min_value,
+                  const int64_t& max_value, int64_t& value) {
+  const char* pos(field.data);
+  const char* end(field.data + field.size);
+  bool negative(false);
+  uint64_t magnitude(0);
+  const uint64_t limit(static_cast<uint64_t>(max_value) + 1);
+
+  if (pos < end && (*pos == '-' || *pos == '+')) {
+    negative = (*pos++ == '-');
+  }
+  if (pos == end) {
+    return false;
+  }
+
+  // one past the maximum is the magnitude of the minimum
+  for (; pos < end; pos++) {
+    if (*pos < '0' || *pos > '9' ||
+        magnitude > (limit - (*pos - '0')) / 10) {
+      return false;
+    }
+    magnitude = magnitude * 10 + (*pos - '0');
+  }
+
+  if (negative) {
+    value = (magnitude == limit) ? min_value : -static_cast<int64_t>(magnitude);
+  } else {
+    value = static_cast<int64_t>(magnitude);
+  }
+  return negative || magnitude < limit;
+}
+
+template <typename T>
+void AppendBigEndian(const T& value, std::vector<char>& bytes) {
+  T swapped(utils::SwapEndian<T>(value));
+  const char* data(reinterpret_cast<const char*>(&swapped));
+
+  bytes.insert(bytes.end(), data, data + sizeof(swapped));
+}
+
+// one row from pos, which is left at the start of the next
+bool ScanRow(const char*& pos, const char* end, const char& delimiter,
+             std::vector<CsvField>& fields, std::string& error) {
+  for (;;) {
+    CsvField field = {pos, 0, false, false};
+
+    if (pos < end && *pos == '"') {
+      field.quoted = true;
+      field.data = ++pos;
+      for (;;) {
+        const char* quote(static_cast<const char*>(
+            std::memchr(pos, '"', end - pos)));
+        if (!quote) {
+          error = "unterminated quoted field";
+          return false;
+        }
+        if (quote + 1 < end && quote[1] == '"') {
+          field.escaped = true;
+          pos = quote + 2;
+          continue;
+        }
+        field.size = quote - field.data;
+        pos = quote + 1;
+        break;
+      }
+    } else {
+      while (pos < end && *pos != delimiter && *pos != '\n' && *pos != '\r') {
+        if (*pos == '"') {
+          error = "quote inside an unquoted field";
+          return false;
+        }
+        pos++;
+      }
+      field.size = pos - field.data;
+    }
+    fields.push_back(field);
+
+    if (pos < end && *pos == delimiter) {
+      pos++;
+      continue;
+    }
+    break;
+  }
+
+  if (pos < end && *pos == '\r') {
+    pos++;
+  }
+  if (pos < end && *pos != '\n') {
+    error = "unexpected character after a quoted field";
+    return false;
+  }
+  if (pos < end) {
+    pos++;
+  }
+  return true;
+}
+
+}  // namespace
+
+void SplitCsvRows(const char* data, const std::size_t& size,
+                  const std::size_t& part_num, const bool& at_end,
+                  std::vector<std::size_t>& bounds) {
+  std::size_t complete(0);
+  const std::size_t step(std::max<std::size_t>(size / part_num, 1));
+
+  bounds.assign(1, 0);
+
+  if (!std::memchr(data, '"', size)) {
+    // every newline ends a row
+    for (complete = size; complete && data[complete - 1] != '\n';) {
+      --complete;
+    }
+    if (at_end) {
+      complete = size;
+    }
+    for (std::size_t target = step; target < complete; target += step) {
+      if (target < bounds.back()) {
+        continue;
+      }
+      const char* newline(static_cast<const char*>(
+          std::memchr(data + target, '\n', complete - target)));
+      std::size_t bound(newline ? newline - data + 1 : complete);
+      if (bound >= complete) {
+        break;
+      }
+      bounds.push_back(bound);
+    }
+  } else {
+    bool in_quote(false);
+    std::size_t target(step);
+    for (std::size_t i = 0; i < size; i++) {
+      if (data[i] == '"') {
+        in_quote = !in_quote;
+      } else if (data[i] == '\n' && !in_quote) {
+        complete = i + 1;
+        if (complete >= target) {
+          bounds.push_back(complete);
+          target = complete + step;
+        }
+      }
+    }
+    // the scanner reports a quote left open at the end
+    if (at_end) {
+      complete = size;
+    }
+    while (bounds.size() > 1 && bounds.back() >= complete) {
+      bounds.pop_back();
+    }
+  }
+
+  bounds.push_back(complete);
+}
+
+DateParser::DateParser(void)
+    : day_(std::numeric_limits<int64_t>::min()),
+      with_offset_(false),
+      offset_(0) {}
+
+bool DateParser::Parse(const char* data, const std::size_t& size,
+                       const bool& with_time, int64_t& seconds) {
+  const char* pos(data);
+  const char* end(data + size);
+  int64_t year(0), month(0), day(0), hour(0), minute(0), second(0);
+  int64_t days(0);
+  int64_t second_of_day(0);
+
+  if (!ParseDigits(pos, end, 4, year) || pos == end || *pos++ != '-' ||
+      !ParseDigits(pos, end, 2, month) || pos == end || *pos++ != '-' ||
+      !ParseDigits(pos, end, 2, day)) {
+    return false;
+  }
+  if (with_time) {
+    if (pos == end || (*pos != '_' && *pos != ' ' && *pos != 'T')) {
+      return false;
+    }
+    pos++;
+    if (!ParseDigits(pos, end, 2, hour) || pos == end || *pos++ != ':' ||
+        !ParseDigits(pos, end, 2, minute) || pos == end || *pos++ != ':' ||
+        !ParseDigits(pos, end, 2, second)) {
+      return false;
+    }
+  }
+  if (pos != end || month < 1 || month > 12 || day < 1 ||
+      day > DaysInMonth(year, month) || hour > 23 || minute > 59 ||
+      second > 59) {
+    return false;
+  }
+
+  days = DaysFromCivil(year, month, day);
+  second_of_day = hour * 3600 + minute * 60 + second;
+
+  // both ends of the day agree unless the clock changes that day
+  if (days != day_) {
+    int64_t first(days * seconds_per_day - ToLocal(days, 0));
+    int64_t last(days * seconds_per_day + seconds_per_day - 1 -
+                 ToLocal(days, seconds_per_day - 1));
+    day_ = days;
+    with_offset_ = (first == last);
+    offset_ = first;
+  }
+
+  seconds = with_offset_ ? days * seconds_per_day + second_of_day - offset_
+                         : ToLocal(days, second_of_day);
+  return true;
+}
+
+int64_t DateParser::ToLocal(const int64_t& day, const int64_t& second) {
+  std::time_t wall(day * seconds_per_day + second);
+  std::tm tm;
+
+  // the calendar fields of the wall clock, mktime reads them as local time
+  gmtime_r(&wall, &tm);
+  tm.tm_isdst = -1;
+  return std::mktime(&tm);
+}
+
+CellEncoder::CellEncoder(const sql::CreateTableCommand& schema)
+    : schema_(schema) {}
+
+bool CellEncoder::Encode(const std::vector<CsvField>& fields,
+                         CellBatch& batch, std::string& error) {
+  const std::size_t begin(batch.bytes.size());
+  const std::size_t column_num(schema_.column_list.size());
+  std::size_t size(0);
+  sql::TypeCode type_code(0);
+  CellKey key(0);
+  int16_t payload_size(0);
+
+  if (fields.size() != column_num) {
+    error = "expected " + std::to_string(column_num) + " fields, found " +
+            std::to_string(fields.size());
+    return false;
+  }
+
+  // header first, the type codes are filled in along the values
+  batch.bytes.resize(begin + table_leaf_payload_type_codes_offset +
+                     column_num);
+  batch.bytes.at(begin + table_leaf_payload_num_of_columns_offset) =
+      static_cast<char>(column_num);
+  for (std::size_t i = 0; i < column_num; i++) {
+    if (!EncodeValue(fields.at(i), schema_.column_list.at(i), type_code,
+                     batch.bytes, error)) {
+      batch.bytes.resize(begin);
+      return false;
+    }
+    batch.bytes.at(begin + table_leaf_payload_type_codes_offset + i) =
+        static_cast<char>(type_code);
+  }
+
+  size = batch.bytes.size() - begin;
+  if (size + cell_pointer_length + table_header_length > page_size) {
+    error = "row does not fit in a page";
+    batch.bytes.resize(begin);
+    return false;
+  }
+
+  // the primary key is the first value and the rowid
+  std::memcpy(&key, batch.bytes.data() + begin +
+                        table_leaf_payload_type_codes_offset + column_num,
+              sizeof(key));
+  std::memcpy(batch.bytes.data() + begin + table_leaf_rowid_offset, &key,
+              table_leaf_rowid_length);
+  payload_size = utils::SwapEndian<int16_t>(size - table_leaf_payload_offset);
+  std::memcpy(batch.bytes.data() + begin + table_leaf_payload_length_offset,
+              &payload_size, table_leaf_payload_length_length);
+
+  batch.entries.push_back({utils::SwapEndian<CellKey>(key), begin, size});
+  return true;
+}
+
+bool CellEncoder::EncodeValue(const CsvField& field,
+                              const sql::CreateTableColumn& column,
+                              sql::TypeCode& type_code,
+                              std::vector<char>& bytes, std::string& error) {
+  int64_t integer(0);
+  char* number_end(nullptr);
+  bool result(true);
+
+  // an empty field is NULL, which keeps the size of its type
+  if (!field.size) {
+    if (sql::could_null != column.attribute) {
+      error = "Not Null violation found for column " + column.column_name;
+      return false;
+    }
+    type_code = sql::DataTypeToTypeCode(column.type, "NULL");
+    bytes.resize(bytes.size() + sql::TypeCodeToSize(type_code), 0);
+    return true;
+  }
+
+  type_code = static_cast<sql::TypeCode>(column.type);
+  switch (column.type) {
+    case sql::TinyInt:
+      result = ParseInteger(field, std::numeric_limits<int8_t>::min(),
+                            std::numeric_limits<int8_t>::max(), integer);
+      bytes.push_back(static_cast<char>(integer));
+      break;
+    case sql::SmallInt:
+      result = ParseInteger(field, std::numeric_limits<int16_t>::min(),
+                            std::numeric_limits<int16_t>::max(), integer);
+      AppendBigEndian(static_cast<int16_t>(integer), bytes);
+      break;
+    case sql::Int:
+      result = ParseInteger(field, std::numeric_limits<int32_t>::min(),
+                            std::numeric_limits<int32_t>::max(), integer);
+      AppendBigEndian(static_cast<int32_t>(integer), bytes);
+      break;
+    case sql::BigInt:
+      result = ParseInteger(field, std::numeric_limits<int64_t>::min(),
+                            std::numeric_limits<int64_t>::max(), integer);
+      AppendBigEndian(integer, bytes);
+      break;
+    case sql::Real: {
+      // the input ends with a NUL, the field with a delimiter, quote or
+      // newline, so strtof stops inside the buffer
+      errno = 0;
+      float value(std::strtof(field.data, &number_end));
+      result = (number_end == field.data + field.size && !errno);
+      AppendBigEndian(value, bytes);
+    } break;
+    case sql::Double: {
+      errno = 0;
+      double value(std::strtod(field.data, &number_end));
+      result = (number_end == field.data + field.size && !errno);
+      AppendBigEndian(value, bytes);
+    } break;
+    case sql::DateTime:
+    case sql::Date:
+      result = date_parser_.Parse(field.data, field.size,
+                                  sql::DateTime == column.type, integer);
+      AppendBigEndian(integer, bytes);
+      break;
+    case sql::Text: {
+      const char* data(field.data);
+      std::size_t size(field.size);
+      if (field.escaped) {
+        scratch_.clear();
+        for (std::size_t i = 0; i < field.size; i++) {
+          scratch_.push_back(field.data[i]);
+          i += (field.data[i] == '"');
+        }
+        data = scratch_.data();
+        size = scratch_.size();
+      }
+      // the type code holds the size
+      if (size > std::numeric_limits<sql::TypeCode>::max() - sql::Text) {
+        error = "text too long for column " + column.column_name;
+        return false;
+      }
+      type_code = sql::Text + size;
+      // stored reversed
+      bytes.insert(bytes.end(), std::reverse_iterator<const char*>(data + size),
+                   std::reverse_iterator<const char*>(data));
+    } break;
+    default:
+      result = false;
+      break;
+  }
+
+  if (!result) {
+    error = "invalid value '" + std::string(field.data, field.size) +
+            "' for column " + column.column_name;
+  }
+  return result;
+}
+
+void LoadCsvRange(const char* begin, const char* end, const CsvFormat& format,
+                  const bool& skip_first, CellEncoder& encoder,
+                  CellBatch& batch) {
+  std::vector<CsvField> fields;
+  const char* pos(begin);
+  bool skip(skip_first);
+
+  batch.row_num = 0;
+  batch.failed = false;
+
+  while (pos < end) {
+    fields.clear();
+    if (!ScanRow(pos, end, format.delimiter, fields, batch.error)) {
+      ++batch.row_num;
+      batch.failed = true;
+      return;
+    }
+
+    // blank line
+    if (fields.size() == 1 && !fields.front().size &&
+        !fields.front().quoted) {
+      continue;
+    }
+    if (skip) {
+      skip = false;
+      continue;
+    }
+
+    ++batch.row_num;
+    if (!encoder.Encode(fields, batch, batch.error)) {
+      batch.failed = true;
+      return;
+    }
+  }
+}
+
+}  // namespace internal
@@ -0,0 +1,104 @@
+#ifndef TINY_BASE_CSV_LOADER_H_
+#define TINY_BASE_CSV_LOADER_H_
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+#include "page_manager.h"
+#include "sql_command.h"
+
+namespace internal {
+
+// least input COPY FROM reads at once
+constexpr std::size_t copy_min_read_size = (64 << 10);
+
+struct CsvFormat {
+  char delimiter;
+  // the first row names the columns and is skipped
+  bool header;
+};
+
+// one field of a row, pointing into the input. Quotes are taken off, a
+// doubled quote inside is still doubled when escaped is set.
+struct CsvField {
+  const char* data;
+  std::size_t size;
+  bool quoted;
+  bool escaped;
+};
+
+// Row starts splitting data into about part_num ranges of whole rows, first
+// 0 and last the end of the last complete row. Without a quote in data the
+// split points are found with memchr alone; otherwise a single pass tracks
+// which newlines are inside a quoted field. At the end of the input a last
+// row without a newline is complete too.
+void SplitCsvRows(const char* data, const std::size_t& size,
+                  const std::size_t& part_num, const bool& at_end,
+                  std::vector<std::size_t>& bounds);
+
+// Cells of the rows of a range, back to back in one buffer
+struct CellBatch {
+  struct Entry {
+    CellKey key;
+    std::size_t offset;
+    std::size_t size;
+  };
+
+  std::vector<char> bytes;
+  std::vector<Entry> entries;
+  // rows read, a failed row is the last one
+  std::size_t row_num;
+  bool failed;
+  std::string error;
+};
+
+// DATE and DATETIME text to seconds since the epoch in local time, as mktime
+// gives them. The calendar part is days_from_civil; the UTC offset of the
+// last day seen is kept and mktime only runs when the day changes or has a
+// daylight saving switch in it.
+class DateParser {
+ public:
+  DateParser(void);
+
+  // YYYY-MM-DD, with _HH:MM:SS when with_time (a space or T also separates)
+  bool Parse(const char* data, const std::size_t& size, const bool& with_time,
+             int64_t& seconds);
+
+ private:
+  int64_t day_;
+  // seconds east of UTC for the whole day, or unknown when it changes
+  bool with_offset_;
+  int64_t offset_;
+
+  static int64_t ToLocal(const int64_t& day, const int64_t& second);
+};
+
+// Encodes the fields of a row straight into the bytes of a leaf cell, with
+// the checks INSERT makes
+class CellEncoder {
+ public:
+  explicit CellEncoder(const sql::CreateTableCommand& schema);
+
+  // appends the cell to the batch, false with the reason when the row is bad
+  bool Encode(const std::vector<CsvField>& fields, CellBatch& batch,
+              std::string& error);
+
+ private:
+  sql::CreateTableCommand schema_;
+  DateParser date_parser_;
+  std::string scratch_;
+
+  bool EncodeValue(const CsvField& field, const sql::CreateTableColumn& column,
+                   sql::TypeCode& type_code, std::vector<char>& bytes,
+                   std::string& error);
+};
+
+// Scans the rows of [begin, end) into cells. skip_first drops a header row.
+void LoadCsvRange(const char* begin, const char* end, const CsvFormat& format,
+                  const bool& skip_first, CellEncoder& encoder,
+                  CellBatch& batch);
+
+}  // namespace internal
+
+#endif  // TINY_BASE_CSV_LOADER_H_
@@ -0,0 +1,220 @@
+#include "group_aggregator.h"
+
+namespace internal {
+
+const std::size_t GroupAggregator::partition_fan_out;
+const std::size_t GroupAggregator::max_depth;
+
+GroupAggregator::GroupAggregator(const std::vector<std::size_t>& key_positions,
+                                 const std::vector<AggregateSpec>& specs,
+                                 const std::size_t& memory_budget)
+    : GroupAggregator(key_positions, specs, memory_budget, 0) {}
+
+GroupAggregator::GroupAggregator(const std::vector<std::size_t>& key_positions,
+                                 const std::vector<AggregateSpec>& specs,
+                                 const std::size_t& memory_budget,
+                                 const std::size_t& depth)
+    : key_positions_(key_positions),
+      specs_(specs),
+      memory_budget_(memory_budget),
+      memory_used_(0),
+      depth_(depth),
+      slots_(64, 0) {
+  memory_used_ += slots_.size() * sizeof(std::size_t);
+}
+
+void GroupAggregator::Add(const sql::TypeValueList& tuple) {
+  std::size_t hash(HashKey(tuple));
+  std::size_t slot(FindSlot(hash, tuple));
+
+  if (slots_.at(slot)) {
+    groups_.at(slots_.at(slot) - 1).aggregator.Add(tuple);
+    return;
+  }
+
+  // the table is full, rows of new groups wait in a partition
+  if (memory_used_ > memory_budget_ && !groups_.empty() &&
+      depth_ < max_depth) {
+    SpillTuple(hash, tuple);
+    return;
+  }
+
+  Group group = {hash, {}, Aggregator(specs_)};
+  for (auto position : key_positions_) {
+    group.key.push_back(tuple.at(position));
+  }
+  group.aggregator.Add(tuple);
+
+  memory_used_ += sizeof(Group) + GetTupleSize(group.key) +
+                  Aggregator::GetSize(specs_);
+  groups_.push_back(std::move(group));
+  slots_.at(slot) = groups_.size();
+
+  // load factor stays under one half
+  if (groups_.size() * 2 > slots_.size()) {
+    Grow();
+  }
+}
+
+bool GroupAggregator::Finish(const TupleConsumer& consumer) {
+  sql::TypeValueList result;
+  sql::TypeValueList tuple;
+
+  for (auto& group : groups_) {
+    group.aggregator.GetResult(result);
+    group.key.insert(group.key.end(), result.begin(), result.end());
+    if (!consumer(group.key)) {
+      return false;
+    }
+  }
+
+  // release the table before the partitions build theirs
+  std::vector<Group>().swap(groups_);
+  std::vector<std::size_t>().swap(slots_);
+  memory_used_ = 0;
+
+  for (auto& partition : partitions_) {
+    if (!partition->GetTupleNum()) {
+      continue;
+    }
+
+    GroupAggregator child(key_positions_, specs_, memory_budget_, depth_ + 1);
+    partition->Rewind();
+    while (partition->Read(tuple)) {
+      child.Add(tuple);
+    }
+    partition.reset();
+
+    if (!child.Finish(consumer)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+std::size_t GroupAggregator::HashKey(const sql::TypeValueList& tuple) const {
+  std::size_t hash(0);
+
+  for (auto position : key_positions_) {
+    const sql::TypeValue& column(tuple.at(position));
+    hash = sql::MixHash(hash ^ sql::HashValue(column.second, column.first));
+  }
+
+  return hash;
+}
+
+bool GroupAggregator::IsSameKey(const Group& group, const std::size_t& hash,
+                                const sql::TypeValueList& tuple) const {
+  if (group.hash != hash) {
+    return false;
+  }
+
+  for (std::size_t i = 0; i < key_positions_.size(); i++) {
+    const sql::TypeValue& column(tuple.at(key_positions_.at(i)));
+    if (sql::CompareOrder(column.second, group.key.at(i).second, column.first,
+                          group.key.at(i).first)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+std::size_t GroupAggregator::FindSlot(const std::size_t& hash,
+                                      const sql::TypeValueList& tuple) const {
+  std::size_t mask(slots_.size() - 1);
+  std::size_t slot(hash & mask);
+
+  // linear probing up to the group or a free slot
+  while (slots_.at(slot) &&
+         !IsSameKey(groups_.at(slots_.at(slot) - 1), hash, tuple)) {
+    slot = (slot + 1) & mask;
+  }
+
+  return slot;
+}
+
+void GroupAggregator::Grow(void) {
+  std::size_t mask(slots_.size() * 2 - 1);
+
+  memory_used_ += slots_.size() * sizeof(std::size_t);
+  slots_.assign(slots_.size() * 2, 0);
+
+  for (std::size_t i = 0; i < groups_.size(); i++) {
+    std::size_t slot(groups_.at(i).hash & mask);
+    while (slots_.at(slot)) {
+      slot = (slot + 1) & mask;
+    }
+    slots_.at(slot) = i + 1;
+  }
+}
+
+void GroupAggregator::SpillTuple(const std::size_t& hash,
+                                 const sql::TypeValueList& tuple) {
+  if (partitions_.empty()) {
+    for (std::size_t i = 0; i < partition_fan_out; i++) {
+      partitions_.emplace_back(new SpillFile);
+    }
+  }
+
+  // the slot uses the low bits, each level splits on a fresh mix
+  std::size_t partition(sql::MixHash(hash + depth_ + 1) % partition_fan_out);
+  partitions_.at(partition)->Write(tuple);
+}
+
+StreamGroupAggregator::StreamGroupAggregator(
+    const std::vector<std::size_t>& key_positions,
+    const std::vector<AggregateSpec>& specs)
+    : key_positions_(key_positions),
+      specs_(specs),
+      with_group_(false),
+      aggregator_(specs) {}
+
+bool StreamGroupAggregator::Add(const sql::TypeValueList& tuple,
+                                const TupleConsumer& consumer) {
+  bool same(with_group_);
+
+  for (std::size_t i = 0; same && i < key_positions_.size(); i++) {
+    const sql::TypeValue& column(tuple.at(key_positions_.at(i)));
+    same = !sql::CompareOrder(column.second, key_.at(i).second, column.first,
+                              key_.at(i).first);
+  }
+
+  // key changed, the previous group is complete
+  if (!same) {
+    if (with_group_ && !EmitGroup(consumer)) {
+      return false;
+    }
+
+    key_.clear();
+    for (auto position : key_positions_) {
+      key_.push_back(tuple.at(position));
+    }
+    aggregator_ = Aggregator(specs_);
+    with_group_ = true;
+  }
+
+  aggregator_.Add(tuple);
+  return true;
+}
+
+bool StreamGroupAggregator::Finish(const TupleConsumer& consumer) {
+  if (!with_group_) {
+    return true;
+  }
+
+  with_group_ = false;
+  return EmitGroup(consumer);
+}
+
+bool StreamGroupAggregator::EmitGroup(const TupleConsumer& consumer) {
+  sql::TypeValueList result;
+  sql::TypeValueList row(key_);
+
+  aggregator_.GetResult(result);
+  row.insert(row.end(), result.begin(), result.end());
+  return consumer(row);
+}
+
+}  // namespace internal
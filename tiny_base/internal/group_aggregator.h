@@ -0,0 +1,98 @@
+#ifndef TINY_BASE_GROUP_AGGREGATOR_H_
+#define TINY_BASE_GROUP_AGGREGATOR_H_
+
+#include <memory>
+#include <vector>
+#include "aggregator.h"
+#include "spill_file.h"
+#include "sql_command.h"
+#include "tuple_sorter.h"
+
+namespace internal {
+
+// Hash aggregation for GROUP BY. Groups live in an open addressing table keyed
+// on the decoded group columns. Once the table outgrows the memory budget,
+// rows of groups not in the table yet are hash partitioned into spill files,
+// and each partition is aggregated on its own after the input ends. A group
+// is therefore either wholly in memory or wholly in one partition.
+class GroupAggregator {
+ public:
+  GroupAggregator(const std::vector<std::size_t>& key_positions,
+                  const std::vector<AggregateSpec>& specs,
+                  const std::size_t& memory_budget);
+
+  void Add(const sql::TypeValueList& tuple);
+
+  // hands over one tuple per group, the group columns then the aggregates,
+  // stops early when the consumer says so
+  bool Finish(const TupleConsumer& consumer);
+
+  std::size_t GetPartitionNum(void) const { return partitions_.size(); }
+
+ private:
+  using Partition = std::unique_ptr<SpillFile>;
+
+  struct Group {
+    std::size_t hash;
+    sql::TypeValueList key;
+    Aggregator aggregator;
+  };
+
+  // files per spill, and how often a partition may split again before the
+  // budget is ignored (a partition of one huge group cannot shrink)
+  static const std::size_t partition_fan_out = 16;
+  static const std::size_t max_depth = 4;
+
+  std::vector<std::size_t> key_positions_;
+  const std::vector<AggregateSpec>& specs_;
+  std::size_t memory_budget_;
+  std::size_t memory_used_;
+  std::size_t depth_;
+  std::vector<Group> groups_;
+  // group index plus one, zero marks a free slot
+  std::vector<std::size_t> slots_;
+  std::vector<Partition> partitions_;
+
+  // a partition is aggregated by a child one level deeper
+  GroupAggregator(const std::vector<std::size_t>& key_positions,
+                  const std::vector<AggregateSpec>& specs,
+                  const std::size_t& memory_budget, const std::size_t& depth);
+
+  std::size_t HashKey(const sql::TypeValueList& tuple) const;
+
+  bool IsSameKey(const Group& group, const std::size_t& hash,
+                 const sql::TypeValueList& tuple) const;
+
+  std::size_t FindSlot(const std::size_t& hash,
+                       const sql::TypeValueList& tuple) const;
+
+  void Grow(void);
+
+  void SpillTuple(const std::size_t& hash, const sql::TypeValueList& tuple);
+};
+
+// GROUP BY over rows that arrive with equal keys next to each other, so only
+// the current group is held.
+class StreamGroupAggregator {
+ public:
+  StreamGroupAggregator(const std::vector<std::size_t>& key_positions,
+                        const std::vector<AggregateSpec>& specs);
+
+  // false once the consumer wants no more groups
+  bool Add(const sql::TypeValueList& tuple, const TupleConsumer& consumer);
+
+  bool Finish(const TupleConsumer& consumer);
+
+ private:
+  std::vector<std::size_t> key_positions_;
+  const std::vector<AggregateSpec>& specs_;
+  bool with_group_;
+  sql::TypeValueList key_;
+  Aggregator aggregator_;
+
+  bool EmitGroup(const TupleConsumer& consumer);
+};
+
+}  // namespace internal
+
+#endif  // TINY_BASE_GROUP_AGGREGATOR_H_
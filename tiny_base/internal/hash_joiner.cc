@@ -0,0 +1,153 @@
+#include "hash_joiner.h"
+#include "tuple_sorter.h"
+
+namespace internal {
+
+const std::size_t HashJoiner::partition_fan_out;
+const std::size_t HashJoiner::max_depth;
+
+HashJoiner::HashJoiner(const std::size_t& build_key,
+                       const std::size_t& probe_key,
+                       const std::size_t& memory_budget)
+    : HashJoiner(build_key, probe_key, memory_budget, 0) {}
+
+HashJoiner::HashJoiner(const std::size_t& build_key,
+                       const std::size_t& probe_key,
+                       const std::size_t& memory_budget,
+                       const std::size_t& depth)
+    : build_key_(build_key),
+      probe_key_(probe_key),
+      memory_budget_(memory_budget),
+      memory_used_(0),
+      depth_(depth),
+      buckets_(64, 0) {
+  memory_used_ += buckets_.size() * sizeof(std::size_t);
+}
+
+void HashJoiner::Build(sql::TypeValueList& tuple) {
+  const sql::TypeValue& key(tuple.at(build_key_));
+
+  if (sql::IsTypeCodeNull(key.first)) {
+    return;
+  }
+
+  std::size_t hash(HashKey(key));
+
+  if (!build_partitions_.empty()) {
+    build_partitions_.at(GetPartition(hash))->Write(tuple);
+    return;
+  }
+
+  memory_used_ += sizeof(Entry) + GetTupleSize(tuple);
+  entries_.push_back(Entry{hash, 0, std::move(tuple)});
+
+  std::size_t& bucket(buckets_.at(hash & (buckets_.size() - 1)));
+  entries_.back().next = bucket;
+  bucket = entries_.size();
+
+  if (entries_.size() > buckets_.size()) {
+    Grow();
+  }
+
+  // one huge key cannot be split, past the depth the budget gives way
+  if (memory_used_ > memory_budget_ && depth_ < max_depth) {
+    SpillEntries();
+  }
+}
+
+bool HashJoiner::Probe(const sql::TypeValueList& tuple,
+                       const JoinConsumer& consumer) {
+  const sql::TypeValue& key(tuple.at(probe_key_));
+
+  if (sql::IsTypeCodeNull(key.first)) {
+    return true;
+  }
+
+  std::size_t hash(HashKey(key));
+
+  if (!build_partitions_.empty()) {
+    probe_partitions_.at(GetPartition(hash))->Write(tuple);
+    return true;
+  }
+
+  for (std::size_t iter = buckets_.at(hash & (buckets_.size() - 1)); iter;
+       iter = entries_.at(iter - 1).next) {
+    const Entry& entry(entries_.at(iter - 1));
+    const sql::TypeValue& build_key(entry.tuple.at(build_key_));
+    if (entry.hash == hash &&
+        !sql::CompareOrder(key.second, build_key.second, key.first,
+                           build_key.first) &&
+        !consumer(entry.tuple, tuple)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool HashJoiner::Finish(const JoinConsumer& consumer) {
+  sql::TypeValueList tuple;
+
+  for (std::size_t i = 0; i < build_partitions_.size(); i++) {
+    Partition& build(build_partitions_.at(i));
+    Partition& probe(probe_partitions_.at(i));
+
+    // either side empty, nothing to match
+    if (!build->GetTupleNum() || !probe->GetTupleNum()) {
+      build.reset();
+      probe.reset();
+      continue;
+    }
+
+    HashJoiner child(build_key_, probe_key_, memory_budget_, depth_ + 1);
+    build->Rewind();
+    while (build->Read(tuple)) {
+      child.Build(tuple);
+    }
+    build.reset();
+
+    probe->Rewind();
+    while (probe->Read(tuple)) {
+      if (!child.Probe(tuple, consumer)) {
+        return false;
+      }
+    }
+    probe.reset();
+
+    if (!child.Finish(consumer)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void HashJoiner::Grow(void) {
+  std::size_t mask(buckets_.size() * 2 - 1);
+
+  memory_used_ += buckets_.size() * sizeof(std::size_t);
+  buckets_.assign(buckets_.size() * 2, 0);
+
+  for (std::size_t i = 0; i < entries_.size(); i++) {
+    std::size_t& bucket(buckets_.at(entries_.at(i).hash & mask));
+    entries_.at(i).next = bucket;
+    bucket = i + 1;
+  }
+}
+
+void HashJoiner::SpillEntries(void) {
+  for (std::size_t i = 0; i < partition_fan_out; i++) {
+    build_partitions_.emplace_back(new SpillFile);
+    probe_partitions_.emplace_back(new SpillFile);
+  }
+
+  for (const auto& entry : entries_) {
+    build_partitions_.at(GetPartition(entry.hash))->Write(entry.tuple);
+  }
+
+  std::vector<Entry>().swap(entries_);
+  std::vector<std::size_t>().swap(buckets_);
+  memory_used_ = 0;
+}
+
+}  // namespace internal
@@ -0,0 +1,79 @@
+#ifndef TINY_BASE_HASH_JOINER_H_
+#define TINY_BASE_HASH_JOINER_H_
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include "spill_file.h"
+#include "sql_command.h"
+
+namespace internal {
+
+// receives a build tuple and a probe tuple with equal keys, returns false to
+// stop the join
+using JoinConsumer = std::function<bool(const sql::TypeValueList& build,
+                                        const sql::TypeValueList& probe)>;
+
+// Equi-join on one column. The build side is hashed in memory and the probe
+// side streams past it. When the build side outgrows the memory budget, both
+// sides are hash partitioned into spill files (Grace join) and each pair of
+// partitions is joined on its own afterwards. NULL keys match nothing.
+class HashJoiner {
+ public:
+  HashJoiner(const std::size_t& build_key, const std::size_t& probe_key,
+             const std::size_t& memory_budget);
+
+  // all build tuples come before the first probe tuple
+  void Build(sql::TypeValueList& tuple);
+
+  // matches are handed over at once while the build side is in memory,
+  // otherwise the tuple waits in its partition for Finish
+  bool Probe(const sql::TypeValueList& tuple, const JoinConsumer& consumer);
+
+  bool Finish(const JoinConsumer& consumer);
+
+  std::size_t GetPartitionNum(void) const { return build_partitions_.size(); }
+
+ private:
+  using Partition = std::unique_ptr<SpillFile>;
+
+  struct Entry {
+    std::size_t hash;
+    // next entry of the bucket plus one, zero ends the chain
+    std::size_t next;
+    sql::TypeValueList tuple;
+  };
+
+  static const std::size_t partition_fan_out = 16;
+  static const std::size_t max_depth = 4;
+
+  std::size_t build_key_;
+  std::size_t probe_key_;
+  std::size_t memory_budget_;
+  std::size_t memory_used_;
+  std::size_t depth_;
+  std::vector<Entry> entries_;
+  // first entry of the bucket plus one
+  std::vector<std::size_t> buckets_;
+  std::vector<Partition> build_partitions_;
+  std::vector<Partition> probe_partitions_;
+
+  HashJoiner(const std::size_t& build_key, const std::size_t& probe_key,
+             const std::size_t& memory_budget, const std::size_t& depth);
+
+  static std::size_t HashKey(const sql::TypeValue& key) {
+    return sql::MixHash(sql::HashValue(key.second, key.first));
+  }
+
+  std::size_t GetPartition(const std::size_t& hash) const {
+    return sql::MixHash(hash + depth_ + 1) % partition_fan_out;
+  }
+
+  void Grow(void);
+
+  void SpillEntries(void);
+};
+
+}  // namespace internal
+
+#endif  // TINY_BASE_HASH_JOINER_H_
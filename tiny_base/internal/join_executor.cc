@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+#include "join_executor.h"
+
+namespace internal {
+
+const std::size_t JoinExecutor::left_side;
+const std::size_t JoinExecutor::right_side;
+
+JoinExecutor::JoinExecutor(TableManager& left, TableManager& right,
+                           const sql::SelectFromCommand& command,
+                           const std::size_t& memory_budget)
+    : command_(command),
+      memory_budget_(memory_budget),
+      output_plan_(),
+      strategy_(HashJoinStrategy),
+      inner_(right_side) {
+  const sql::JoinClause& join(*command.join);
+
+  // each side scans the columns it contributes plus its join key
+  sides_[left_side].table = &left;
+  sides_[left_side].table_name = command.table_name;
+  sides_[left_side].command = {command.table_name, {}, command.where};
+  sides_[left_side].key_position =
+      AddColumn(sides_[left_side], join.left_column);
+
+  sides_[right_side].table = &right;
+  sides_[right_side].table_name = join.table_name;
+  sides_[right_side].command = {join.table_name, {}, join.where};
+  sides_[right_side].key_position =
+      AddColumn(sides_[right_side], join.right_column);
+
+  for (const auto& name : command.column_name) {
+    output_.push_back(AddColumn(name));
+  }
+
+  // ORDER BY, a column outside the SELECT list rides along hidden
+  if (command.order_by) {
+    auto column = AddColumn(command.order_by->column_name);
+    auto res = std::find(output_.begin(), output_.end(), column);
+    if (res == output_.end()) {
+      output_.push_back(column);
+      output_plan_.hidden_column_num = 1;
+      res = output_.end() - 1;
+    }
+    output_plan_.with_order = true;
+    output_plan_.order_position = std::distance(output_.begin(), res);
+    output_plan_.order_desc = command.order_by->descending;
+  }
+
+  output_plan_.with_limit = static_cast<bool>(command.limit);
+  output_plan_.offset = output_plan_.with_limit ? command.limit->offset : 0;
+  output_plan_.limit = output_plan_.with_limit
+                           ? command.limit->row_count
+                           : std::numeric_limits<uint64_t>::max();
+
+  for (auto& side : sides_) {
+    side.plan = side.table->PlanScan(side.command);
+    side.row_num = side.table->EstimateRowNum(side.plan);
+  }
+
+  ChooseStrategy();
+}
+
+uint64_t JoinExecutor::SelectFrom(ResultWriter& writer) {
+  TableManager& table(*sides_[left_side].table);
+
+  return table.FilterTuple(command_,
+                           [&](const TupleConsumer& consumer) {
+                             table.PullOrderedTuple(
+                                 output_plan_,
+                                 [&](const TupleConsumer& sink) {
+                                   PullJoinedTuple(sink);
+                                 },
+                                 consumer);
+                           },
+                           writer);
+}
+
+const std::string JoinExecutor::Explain(void) const {
+  std::stringstream out_stream;
+  const Side& inner(sides_[inner_]);
+  const Side& outer(sides_[inner_ == left_side ? right_side : left_side]);
+
+  if (HashJoinStrategy == strategy_) {
+    out_stream << "hash join, build " << inner.table_name << ", probe "
+               << outer.table_name << "\n";
+    for (const auto& side : sides_) {
+      out_stream << side.table->ExplainScan(side.table_name, side.plan);
+    }
+    return out_stream.str();
+  }
+
+  // each outer row descends the inner tree once
+  out_stream << "index nested loop join, outer " << outer.table_name
+             << ", inner " << inner.table_name << "\n"
+             << outer.table->ExplainScan(outer.table_name, outer.plan)
+             << inner.table_name << ": primary key lookup, "
+             << std::llround(outer.row_num * inner.table->GetTreeHeight())
+             << " page reads, "
+             << std::llround(std::min(outer.row_num, inner.row_num))
+             << " rows\n";
+  return out_stream.str();
+}
+
+std::pair<std::size_t, std::size_t> JoinExecutor::AddColumn(
+    const std::string& qualified_name) {
+  std::size_t side(left_side);
+  std::string prefix(sides_[right_side].table_name + ".");
+
+  if (!qualified_name.compare(0, prefix.size(), prefix)) {
+    side = right_side;
+  } else {
+    prefix = sides_[left_side].table_name + ".";
+  }
+
+  return std::make_pair(
+      side, AddColumn(sides_[side], qualified_name.substr(prefix.size())));
+}
+
+std::size_t JoinExecutor::AddColumn(Side& side,
+                                    const std::string& column_name) {
+  std::vector<std::string>& columns(side.command.column_name);
+  auto res = std::find(columns.begin(), columns.end(), column_name);
+
+  if (res == columns.end()) {
+    res = columns.insert(res, column_name);
+  }
+  return std::distance(columns.begin(), res);
+}
+
+void JoinExecutor::ChooseStrategy(void) {
+  const Side& left(sides_[left_side]);
+  const Side& right(sides_[right_side]);
+  std::size_t build(left.row_num < right.row_num ? left_side : right_side);
+  double build_size(sides_[build].row_num *
+                    (sizeof(sql::TypeValueList) +
+                     sides_[build].command.column_name.size() *
+                         sizeof(sql::TypeValue)));
+
+  // hash join: both tables are scanned and every build row is hashed, a
+  // build side past the budget is written out and read back with its probe
+  // side
+  double cost(left.table->GetRowCount() + right.table->GetRowCount() +
+              sides_[build].row_num);
+  if (build_size > memory_budget_) {
+    cost += 2 * (left.row_num + right.row_num);
+  }
+  strategy_ = HashJoinStrategy;
+  inner_ = build;
+
+  // nested loop join: only the outer table is scanned, each outer row
+  // descends the inner tree
+  for (std::size_t inner = left_side; inner <= right_side; inner++) {
+    const Side& inner_side(sides_[inner]);
+    const Side& outer_side(sides_[inner == left_side ? right_side : left_side]);
+    const std::string& key(
+        inner_side.command.column_name.at(inner_side.key_position));
+
+    if (!inner_side.table->IsPrimaryKey(key)) {
+      continue;
+    }
+
+    double loop_cost(outer_side.table->GetRowCount() +
+                     outer_side.row_num * inner_side.table->GetTreeHeight());
+    if (loop_cost < cost) {
+      cost = loop_cost;
+      strategy_ = NestedLoopJoinStrategy;
+      inner_ = inner;
+    }
+  }
+}
+
+bool JoinExecutor::Emit(const sql::TypeValueList& left,
+                        const sql::TypeValueList& right,
+                        const TupleConsumer& consumer) {
+  row_.resize(output_.size());
+  for (std::size_t i = 0; i < output_.size(); i++) {
+    const sql::TypeValueList& source(output_.at(i).first == left_side ? left
+                                                                      : right);
+    row_.at(i) = source.at(output_.at(i).second);
+  }
+  return consumer(row_);
+}
+
+void JoinExecutor::PullJoinedTuple(const TupleConsumer& consumer) {
+  switch (strategy_) {
+    case HashJoinStrategy:
+      HashJoin(consumer);
+      break;
+    case NestedLoopJoinStrategy:
+      NestedLoopJoin(consumer);
+      break;
+    default:
+      break;
+  }
+}
+
+void JoinExecutor::HashJoin(const TupleConsumer& consumer) {
+  Side& build(sides_[inner_]);
+  Side& probe(sides_[inner_ == left_side ? right_side : left_side]);
+  HashJoiner joiner(build.key_position, probe.key_position, memory_budget_);
+  bool more(true);
+
+  JoinConsumer emit = [&](const sql::TypeValueList& build_tuple,
+                          const sql::TypeValueList& probe_tuple) {
+    return (inner_ == left_side) ? Emit(build_tuple, probe_tuple, consumer)
+                                 : Emit(probe_tuple, build_tuple, consumer);
+  };
+
+  build.table->PullResultTuple(build.plan,
+                               [&joiner](sql::TypeValueList& tuple) {
+                                 joiner.Build(tuple);
+                                 return true;
+                               });
+
+  probe.table->PullResultTuple(probe.plan, [&](sql::TypeValueList& tuple) {
+    more = joiner.Probe(tuple, emit);
+    return more;
+  });
+
+  if (more) {
+    joiner.Finish(emit);
+  }
+}
+
+void JoinExecutor::NestedLoopJoin(const TupleConsumer& consumer) {
+  Side& inner(sides_[inner_]);
+  Side& outer(sides_[inner_ == left_side ? right_side : left_side]);
+  sql::TypeValueList inner_tuple;
+
+  outer.table->PullResultTuple(outer.plan, [&](sql::TypeValueList& tuple) {
+    const sql::TypeValue& key(tuple.at(outer.key_position));
+
+    // NULL matches nothing, the key column types are equal
+    if (sql::IsTypeCodeNull(key.first) ||
+        !inner.table->LookupTuple(inner.plan,
+                                  sql::ValueCast<int32_t>(key.second),
+                                  inner_tuple)) {
+      return true;
+    }
+
+    return (inner_ == left_side) ? Emit(inner_tuple, tuple, consumer)
+                                 : Emit(tuple, inner_tuple, consumer);
+  });
+}
+
+}  // namespace internal
@@ -0,0 +1,76 @@
+#ifndef TINY_BASE_JOIN_EXECUTOR_H_
+#define TINY_BASE_JOIN_EXECUTOR_H_
+
+#include <string>
+#include <vector>
+#include "hash_joiner.h"
+#include "sql_command.h"
+#include "table_manager.h"
+
+namespace internal {
+
+enum JoinStrategy { HashJoinStrategy, NestedLoopJoinStrategy };
+
+// Inner equi-join of two tables. Each side is a scan filtered by its own part
+// of the WHERE. The join is either a hash join that builds on the side
+// expected to be smaller, or an index nested loop join that looks each outer
+// row up in the primary key tree of the other side. The planner takes the
+// cheaper by estimated rows.
+class JoinExecutor {
+ public:
+  JoinExecutor(TableManager& left, TableManager& right,
+               const sql::SelectFromCommand& command,
+               const std::size_t& memory_budget);
+
+  uint64_t SelectFrom(ResultWriter& writer);
+
+  JoinStrategy GetStrategy(void) const { return strategy_; }
+
+  // strategy, then the access path of each side
+  const std::string Explain(void) const;
+
+ private:
+  struct Side {
+    TableManager* table;
+    std::string table_name;
+    sql::SelectFromCommand command;
+    ScanPlan plan;
+    std::size_t key_position;
+    double row_num;
+  };
+
+  static const std::size_t left_side = 0;
+  static const std::size_t right_side = 1;
+
+  const sql::SelectFromCommand& command_;
+  std::size_t memory_budget_;
+  Side sides_[2];
+  // side and position in its tuple of each output column
+  std::vector<std::pair<std::size_t, std::size_t>> output_;
+  // ORDER BY and LIMIT over the joined rows
+  ScanPlan output_plan_;
+  JoinStrategy strategy_;
+  // built side of a hash join, looked up side of a nested loop join
+  std::size_t inner_;
+  sql::TypeValueList row_;
+
+  std::pair<std::size_t, std::size_t> AddColumn(
+      const std::string& qualified_name);
+
+  static std::size_t AddColumn(Side& side, const std::string& column_name);
+
+  void ChooseStrategy(void);
+
+  bool Emit(const sql::TypeValueList& left, const sql::TypeValueList& right,
+            const TupleConsumer& consumer);
+
+  void PullJoinedTuple(const TupleConsumer& consumer);
+
+  void HashJoin(const TupleConsumer& consumer);
+
+  void NestedLoopJoin(const TupleConsumer& consumer);
+};
+
+}  // namespace internal
+
+#endif  // TINY_BASE_JOIN_EXECUTOR_H_
@@ -178,10 +178,16 @@ void PageManager::DeleteCell(const CellIndex& cell_index) {
 }
 
 void PageManager::UpdateInfo(void) {
+  std::vector<uint8_t> data_out(table_header_length +
+                                cell_num_ * cell_pointer_length);
+
+  EncodeInfo(data_out.data());
+  table_file_->Write(page_base_, reinterpret_cast<char*>(data_out.data()),
+                     data_out.size());
+}
+
+void PageManager::EncodeInfo(uint8_t* data_out) const {
   auto value(0);
-  std::vector<uint8_t> data_out;
-  auto length(table_header_length + cell_num_ * cell_pointer_length);
-  data_out.resize(length);
 
   // start filling data
   data_out[page_type_offset] = page_type_;
@@ -189,23 +195,37 @@ void PageManager::UpdateInfo(void) {
 
   value =
       utils::SwapEndian<decltype(cell_content_offset_)>(cell_content_offset_);
-  std::memcpy(data_out.data() + cell_content_offset_offset, &value,
+  std::memcpy(data_out + cell_content_offset_offset, &value,
               cell_content_offset_length);
 
   value = utils::SwapEndian<decltype(right_most_pointer_)>(right_most_pointer_);
-  std::memcpy(data_out.data() + right_most_pointer_offset, &value,
+  std::memcpy(data_out + right_most_pointer_offset, &value,
               right_most_pointer_length);
 
   // TODO: check copy will work or not because data type is not the same
   if (cell_num_) {
-    std::memcpy(data_out.data() + cell_pointer_array_offset,
+    std::memcpy(data_out + cell_pointer_array_offset,
                 utils::SwapEndian<decltype(cell_pointer_array_)::value_type>(
                     cell_pointer_array_).data(),
                 cell_num_ * cell_pointer_length);
   }
+}
+
+void PageManager::Fill(const std::vector<CellSlice>& cells) {
+  std::vector<uint8_t> data_out(page_size, 0);
 
+  Reset();
+  for (const auto& cell : cells) {
+    cell_content_offset_ -= cell.size;
+    std::memcpy(data_out.data() + cell_content_offset_, cell.data, cell.size);
+    cell_pointer_array_.push_back(cell_content_offset_);
+    key_set_.insert(key_set_.end(), cell.key);
+    ++cell_num_;
+  }
+
+  EncodeInfo(data_out.data());
   table_file_->Write(page_base_, reinterpret_cast<char*>(data_out.data()),
-                     length);
+                     page_size);
 }
 
 void PageManager::Clear(void) {
@@ -262,7 +282,12 @@ bool PageManager::FindCell(const CellKey& key, PageCell& cell) const {
 }
 
 void PageManager::AppendAllCells(std::vector<PageCell>& tuples) const {
-  for (auto i = 0; i < cell_num_; i++) {
+  AppendCells(0, cell_num_, tuples);
+}
+
+void PageManager::AppendCells(const CellIndex& begin, const CellIndex& end,
+                              std::vector<PageCell>& tuples) const {
+  for (auto i = begin; i < end; i++) {
     tuples.push_back(GetCell(i));
   }
 }
@@ -284,8 +309,45 @@ CellIndex PageManager::GetCellIndex(const CellKey& cell_key) const {
   return std::distance(key_set_.begin(), key_set_.find(cell_key));
 }
 
+CellIndex PageManager::SearchSlot(const CellKey& cell_key) const {
+  CellIndex low(0);
+  CellIndex high(cell_num_);
+
+  // slots are kept in key order
+  while (low < high) {
+    CellIndex middle(low + (high - low) / 2);
+    if (GetCellKey(middle) < cell_key) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
 bool PageManager::IsKeyDuplicate(const CellKey& key) const {
   return (key_set_.find(key) != key_set_.end());
 }
 
+void PageBuffer::Read(utils::FileUtil& file, const PageIndex& page_index) {
+  file.Read(page_index * page_size, data_.data(), page_size);
+}
+
+PagePointer PageBuffer::GetRightMostPagePointer(void) const {
+  PagePointer page_pointer;
+  std::memcpy(&page_pointer, data_.data() + right_most_pointer_offset,
+              right_most_pointer_length);
+  return utils::SwapEndian<decltype(page_pointer)>(page_pointer);
+}
+
+const char* PageBuffer::GetCell(const CellIndex& cell_index) const {
+  uint16_t cell_pointer;
+  std::memcpy(&cell_pointer,
+              data_.data() + cell_pointer_array_offset +
+                  cell_index * cell_pointer_length,
+              cell_pointer_length);
+  return data_.data() + utils::SwapEndian<decltype(cell_pointer)>(cell_pointer);
+}
+
 }  // namespace internal
@@ -1,10 +1,12 @@
 #ifndef TINY_BASE_PAGE_MANAGER_H_
 #define TINY_BASE_PAGE_MANAGER_H_
 
+#include <array>
 #include <set>
 #include <vector>
 #include <utility>
 #include "file_util.h"
+#include "page_format.h"
 
 namespace internal {
 
@@ -16,6 +18,13 @@ using PagePointer = PageIndex;
 using PageRange = std::pair<PageIndex, PageIndex>;
 using PageCell = std::vector<char>;
 
+// cell bytes owned elsewhere, with their key
+struct CellSlice {
+  CellKey key;
+  const char* data;
+  std::size_t size;
+};
+
 enum PageType {
   InvalidCell = 0x00,
   TableInteriorCell = 0x05,
@@ -47,6 +56,9 @@ class PageManager {
 
   CellIndex GetCellIndex(const CellKey& cell_key) const;
 
+  // first slot whose key is not less than the given one
+  CellIndex SearchSlot(const CellKey& cell_key) const;
+
   PageIndex GetParent(void) { return parent_; }
 
   PageIndex GetLeftMostPagePointer(void);
@@ -79,6 +91,10 @@ class PageManager {
 
   void InsertCell(const CellKey& primary_key, const PageCell& cell);
 
+  // cells in ascending key order into an empty page, the whole page is
+  // written with one call
+  void Fill(const std::vector<CellSlice>& cells);
+
   void DeleteCell(const CellIndex& cell_index);
 
   bool FindCell(const CellKey& key, PageCell& cell) const;
@@ -87,6 +103,10 @@ class PageManager {
 
   void AppendAllCells(std::vector<PageCell>& tuples) const;
 
+  // cells in slots [begin, end)
+  void AppendCells(const CellIndex& begin, const CellIndex& end,
+                   std::vector<PageCell>& tuples) const;
+
   void Clear(void);
 
   void Reset(void);
@@ -112,6 +132,25 @@ class PageManager {
 
   // parent
   PageIndex parent_;
+
+  // header and cell pointer array into the front of a page image
+  void EncodeInfo(uint8_t* data_out) const;
+};
+
+// A whole leaf page read with one call, for readers that do not own the
+// table's file handle (workers of a parallel scan)
+class PageBuffer {
+ public:
+  void Read(utils::FileUtil& file, const PageIndex& page_index);
+
+  uint8_t GetCellNum(void) const { return data_[cell_num_offset]; }
+
+  PagePointer GetRightMostPagePointer(void) const;
+
+  const char* GetCell(const CellIndex& cell_index) const;
+
+ private:
+  std::array<char, page_size> data_;
 };
 
 }  // namespace internal
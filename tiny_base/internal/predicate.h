@@ -0,0 +1,338 @@
+#ifndef TINY_BASE_PREDICATE_H_
+#define TINY_BASE_PREDICATE_H_
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "cell.h"
+#include "endian_util.h"
+#include "sql_command.h"
+
+namespace internal {
+
+// WHERE clause compiled once per query: the literal is unboxed up front and
+// the column type and operator are fixed by template instantiation, so
+// matching a row is a direct typed comparison on the (big endian) cell bytes.
+class CompiledPredicate {
+ public:
+  CompiledPredicate(void) : match_(&MatchNothing) {}
+
+  static CompiledPredicate Compile(const sql::WhereClause& clause);
+
+  bool Match(const sql::TypeCode& type_code, const char* data) const {
+    return match_(*this, type_code, data);
+  }
+
+ private:
+  using MatchFunction = bool (*)(const CompiledPredicate&,
+                                 const sql::TypeCode&, const char*);
+
+  MatchFunction match_;
+
+  // unboxed literal
+  union {
+    int8_t value_8;
+    int16_t value_16;
+    int32_t value_32;
+    int64_t value_64;
+    float value_float;
+    double value_double;
+  } literal_;
+  std::string literal_str_;
+
+  template <typename T>
+  const T& Literal(void) const;
+
+  static bool MatchNothing(const CompiledPredicate&, const sql::TypeCode&,
+                           const char*) {
+    return false;
+  }
+
+  template <typename T, typename Op>
+  static bool MatchFixed(const CompiledPredicate& predicate,
+                         const sql::TypeCode& type_code, const char* data) {
+    if (sql::IsTypeCodeNull(type_code)) {
+      return false;
+    }
+
+    T value;
+    std::memcpy(&value, data, sizeof(value));
+    return Op()(utils::SwapEndian<T>(value), predicate.Literal<T>());
+  }
+
+  // text is stored reversed in the cell, so walk it backwards
+  template <typename Op>
+  static bool MatchText(const CompiledPredicate& predicate,
+                        const sql::TypeCode& type_code, const char* data) {
+    if (type_code <= sql::Text) {
+      return false;
+    }
+
+    const std::string& literal(predicate.literal_str_);
+    std::size_t length(type_code - sql::Text);
+    std::size_t common(std::min(length, literal.size()));
+    int order(0);
+
+    for (std::size_t i = 0; i < common && !order; i++) {
+      unsigned char lhs = data[length - i - 1];
+      unsigned char rhs = literal[i];
+      order = (lhs > rhs) - (lhs < rhs);
+    }
+
+    if (!order) {
+      order = (length > literal.size()) - (length < literal.size());
+    }
+
+    return Op()(order, 0);
+  }
+
+  template <typename T>
+  static MatchFunction SelectFixed(const sql::OperatorType& operator_type);
+
+  static MatchFunction SelectText(const sql::OperatorType& operator_type);
+};
+
+template <>
+inline const int8_t& CompiledPredicate::Literal(void) const {
+  return literal_.value_8;
+}
+
+template <>
+inline const int16_t& CompiledPredicate::Literal(void) const {
+  return literal_.value_16;
+}
+
+template <>
+inline const int32_t& CompiledPredicate::Literal(void) const {
+  return literal_.value_32;
+}
+
+template <>
+inline const int64_t& CompiledPredicate::Literal(void) const {
+  return literal_.value_64;
+}
+
+template <>
+inline const float& CompiledPredicate::Literal(void) const {
+  return literal_.value_float;
+}
+
+template <>
+inline const double& CompiledPredicate::Literal(void) const {
+  return literal_.value_double;
+}
+
+template <typename T>
+CompiledPredicate::MatchFunction CompiledPredicate::SelectFixed(
+    const sql::OperatorType& operator_type) {
+  MatchFunction match(&MatchNothing);
+
+  switch (operator_type) {
+    case sql::Equal:
+      match = &MatchFixed<T, std::equal_to<T>>;
+      break;
+    case sql::Unequal:
+      match = &MatchFixed<T, std::not_equal_to<T>>;
+      break;
+    case sql::Larger:
+      match = &MatchFixed<T, std::greater<T>>;
+      break;
+    case sql::Smaller:
+      match = &MatchFixed<T, std::less<T>>;
+      break;
+    case sql::NotLarger:
+      match = &MatchFixed<T, std::less_equal<T>>;
+      break;
+    case sql::NotSmaller:
+      match = &MatchFixed<T, std::greater_equal<T>>;
+      break;
+    default:
+      break;
+  }
+
+  return match;
+}
+
+inline CompiledPredicate::MatchFunction CompiledPredicate::SelectText(
+    const sql::OperatorType& operator_type) {
+  MatchFunction match(&MatchNothing);
+
+  switch (operator_type) {
+    case sql::Equal:
+      match = &MatchText<std::equal_to<int>>;
+      break;
+    case sql::Unequal:
+      match = &MatchText<std::not_equal_to<int>>;
+      break;
+    case sql::Larger:
+      match = &MatchText<std::greater<int>>;
+      break;
+    case sql::Smaller:
+      match = &MatchText<std::less<int>>;
+      break;
+    case sql::NotLarger:
+      match = &MatchText<std::less_equal<int>>;
+      break;
+    case sql::NotSmaller:
+      match = &MatchText<std::greater_equal<int>>;
+      break;
+    default:
+      break;
+  }
+
+  return match;
+}
+
+inline CompiledPredicate CompiledPredicate::Compile(
+    const sql::WhereClause& clause) {
+  CompiledPredicate predicate;
+  const sql::OperatorType& op(clause.condition_operator);
+
+  // NULL literal never matches
+  switch (clause.type_code) {
+    case sql::TinyInt:
+      predicate.literal_.value_8 = sql::ValueCast<int8_t>(clause.value);
+      predicate.match_ = SelectFixed<int8_t>(op);
+      break;
+    case sql::SmallInt:
+      predicate.literal_.value_16 = sql::ValueCast<int16_t>(clause.value);
+      predicate.match_ = SelectFixed<int16_t>(op);
+      break;
+    case sql::Int:
+      predicate.literal_.value_32 = sql::ValueCast<int32_t>(clause.value);
+      predicate.match_ = SelectFixed<int32_t>(op);
+      break;
+    case sql::BigInt:
+    case sql::DateTime:
+    case sql::Date:
+      predicate.literal_.value_64 = sql::ValueCast<int64_t>(clause.value);
+      predicate.match_ = SelectFixed<int64_t>(op);
+      break;
+    case sql::Real:
+      predicate.literal_.value_float = sql::ValueCast<float>(clause.value);
+      predicate.match_ = SelectFixed<float>(op);
+      break;
+    case sql::Double:
+      predicate.literal_.value_double = sql::ValueCast<double>(clause.value);
+      predicate.match_ = SelectFixed<double>(op);
+      break;
+    default:
+      break;
+  }
+
+  if (clause.type_code > sql::Text) {
+    predicate.literal_str_ = sql::ValueCast<std::string>(clause.value);
+    predicate.match_ = SelectText(op);
+  }
+
+  return predicate;
+}
+
+// WHERE expression compiled for a scan. Leaves carry their column index and
+// compiled predicate. NOT is gone by now, folded into the leaf operators.
+// Operands of AND and OR are ordered by rank so the cheapest decisive test
+// runs first, and evaluation short-circuits.
+class CompiledCondition {
+ public:
+  CompiledCondition(void)
+      : type_(sql::LeafCondition),
+        column_index_(0),
+        selectivity_(1.0),
+        cost_(0.0) {}
+
+  static CompiledCondition Leaf(const std::ptrdiff_t& column_index,
+                                const sql::WhereClause& clause,
+                                const double& selectivity) {
+    CompiledCondition leaf;
+    leaf.column_index_ = column_index;
+    leaf.predicate_ = CompiledPredicate::Compile(clause);
+    leaf.selectivity_ = selectivity;
+    // text compares byte by byte, fixed width types in one instruction
+    leaf.cost_ = (clause.type_code > sql::Text) ? 2.0 : 1.0;
+    return leaf;
+  }
+
+  static CompiledCondition Node(const sql::ConditionType& type,
+                                std::vector<CompiledCondition> operands) {
+    CompiledCondition node;
+    node.type_ = type;
+    node.operands_ = std::move(operands);
+
+    // AND: most rows rejected per unit of cost first
+    // OR: most rows accepted per unit of cost first
+    bool is_and(sql::AndCondition == type);
+    std::stable_sort(node.operands_.begin(), node.operands_.end(),
+                     [is_and](const CompiledCondition& lhs,
+                              const CompiledCondition& rhs) {
+                       return is_and ? (lhs.RejectRank() > rhs.RejectRank())
+                                     : (lhs.AcceptRank() > rhs.AcceptRank());
+                     });
+
+    // expected cost with short-circuit evaluation
+    double reach(1.0);
+    node.cost_ = 0.0;
+    for (const auto& operand : node.operands_) {
+      node.cost_ += reach * operand.cost_;
+      reach *= is_and ? operand.selectivity_ : (1.0 - operand.selectivity_);
+    }
+    node.selectivity_ = is_and ? reach : (1.0 - reach);
+
+    return node;
+  }
+
+  bool Match(const CellView& view) const {
+    switch (type_) {
+      case sql::LeafCondition:
+        return predicate_.Match(view.GetTypeCode(column_index_),
+                                view.GetData(column_index_));
+      case sql::AndCondition:
+        for (const auto& operand : operands_) {
+          if (!operand.Match(view)) {
+            return false;
+          }
+        }
+        return true;
+      case sql::OrCondition:
+        for (const auto& operand : operands_) {
+          if (operand.Match(view)) {
+            return true;
+          }
+        }
+        return false;
+      default:
+        return false;
+    }
+  }
+
+  double GetSelectivity(void) const { return selectivity_; }
+
+  double GetCost(void) const { return cost_; }
+
+  // highest column index the condition reads
+  std::ptrdiff_t GetLastColumn(void) const {
+    std::ptrdiff_t last(column_index_);
+    for (const auto& operand : operands_) {
+      last = std::max(last, operand.GetLastColumn());
+    }
+    return last;
+  }
+
+ private:
+  sql::ConditionType type_;
+  std::ptrdiff_t column_index_;
+  CompiledPredicate predicate_;
+  std::vector<CompiledCondition> operands_;
+  double selectivity_;
+  double cost_;
+
+  double RejectRank(void) const { return (1.0 - selectivity_) / cost_; }
+
+  double AcceptRank(void) const { return selectivity_ / cost_; }
+};
+
+}  // namespace internal
+
+#endif  // TINY_BASE_PREDICATE_H_
@@ -0,0 +1,599 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "endian_util.h"
+#include "result_writer.h"
+#include "sql_value.h"
+
+namespace internal {
+
+namespace {
+
+// decimal digits of the integer, written backwards from end
+char* FormatInteger(const int64_t& value, char* end) {
+  uint64_t magnitude(value < 0 ? 0 - static_cast<uint64_t>(value)
+                               : static_cast<uint64_t>(value));
+
+  do {
+    *--end = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude);
+  if (value < 0) {
+    *--end = '-';
+  }
+  return end;
+}
+
+// zero padded, written forwards
+char* FormatTwoDigits(const int& value, char* begin) {
+  *begin++ = '0' + value / 10 % 10;
+  *begin++ = '0' + value % 10;
+  return begin;
+}
+
+// JSON string content, plain runs are emitted in one piece
+template <typename Emit>
+void EscapeJson(const char* data, const std::size_t& size, Emit emit) {
+  static const char hex_digits[] = "0123456789abcdef";
+  const char* begin(data);
+  const char* end(data + size);
+
+  for (const char* pos = data; pos != end; pos++) {
+    unsigned char c(*pos);
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+    emit(begin, pos - begin);
+    begin = pos + 1;
+    switch (c) {
+      case '"':
+        emit("\\\"", 2);
+        break;
+      case '\\':
+        emit("\\\\", 2);
+        break;
+      case '\n':
+        emit("\\n", 2);
+        break;
+      case '\r':
+        emit("\\r", 2);
+        break;
+      case '\t':
+        emit("\\t", 2);
+        break;
+      default: {
+        const char escape[6] = {'\\', 'u', '0', '0', hex_digits[c >> 4],
+                                hex_digits[c & 0xF]};
+        emit(escape, sizeof(escape));
+      } break;
+    }
+  }
+  emit(begin, end - begin);
+}
+
+template <typename T>
+void AppendBigEndian(const T& value, std::string& out) {
+  T swapped(utils::SwapEndian<T>(value));
+  out.append(reinterpret_cast<const char*>(&swapped), sizeof(swapped));
+}
+
+}  // namespace
+
+ResultWriter::ResultWriter(std::ostream& out_stream)
+    : row_num_(0),
+      out_stream_(out_stream),
+      last_time_(0),
+      last_time_type_(sql::InvalidType),
+      last_time_size_(0) {
+  buffer_.reserve(output_buffer_size);
+}
+
+ResultWriter::~ResultWriter(void) {}
+
+void ResultWriter::Flush(void) {
+  out_stream_.write(buffer_.data(), buffer_.size());
+  out_stream_.flush();
+  buffer_.clear();
+}
+
+void ResultWriter::AppendValue(const sql::TypeCode& type_code,
+                               const sql::Value& value) {
+  // enough for any double in %f
+  char number[384];
+
+  switch (type_code) {
+    case sql::OneByteNull:
+    case sql::TwoByteNull:
+    case sql::FourByteNull:
+    case sql::EightByteNull:
+      Append("NULL", 4);
+      break;
+    case sql::TinyInt:
+      AppendInteger(sql::ValueCast<int8_t>(value));
+      break;
+    case sql::SmallInt:
+      AppendInteger(sql::ValueCast<int16_t>(value));
+      break;
+    case sql::Int:
+      AppendInteger(sql::ValueCast<int32_t>(value));
+      break;
+    case sql::BigInt:
+      AppendInteger(sql::ValueCast<int64_t>(value));
+      break;
+    case sql::Real:
+      Append(number, std::snprintf(number, sizeof(number), "%f",
+                                   sql::ValueCast<float>(value)));
+      break;
+    case sql::Double:
+      Append(number, std::snprintf(number, sizeof(number), "%f",
+                                   sql::ValueCast<double>(value)));
+      break;
+    case sql::DateTime:
+    case sql::Date:
+      AppendTime(type_code, sql::ValueCast<int64_t>(value));
+      break;
+    default: {
+      const std::string& text(sql::ValueCast<std::string>(value));
+      Append(text.data(), text.size());
+    } break;
+  }
+}
+
+void ResultWriter::AppendInteger(const int64_t& value) {
+  char number[24];
+  char* end(number + sizeof(number));
+  char* begin(FormatInteger(value, end));
+
+  Append(begin, end - begin);
+}
+
+void ResultWriter::AppendTime(const sql::TypeCode& type_code,
+                              const std::time_t& time) {
+  std::tm tm;
+  char* pos(last_time_str_);
+  char year[16];
+  char* year_end(year + sizeof(year));
+  char* year_begin(nullptr);
+
+  if (type_code == last_time_type_ && time == last_time_) {
+    Append(last_time_str_, last_time_size_);
+    return;
+  }
+
+  // %F and %F_%T of ValueToString
+  localtime_r(&time, &tm);
+  year_begin = FormatInteger(tm.tm_year + 1900, year_end);
+  for (auto i = year_end - year_begin; i < 4; i++) {
+    *pos++ = '0';
+  }
+  pos = std::copy(year_begin, year_end, pos);
+  *pos++ = '-';
+  pos = FormatTwoDigits(tm.tm_mon + 1, pos);
+  *pos++ = '-';
+  pos = FormatTwoDigits(tm.tm_mday, pos);
+  if (sql::DateTime == type_code) {
+    *pos++ = '_';
+    pos = FormatTwoDigits(tm.tm_hour, pos);
+    *pos++ = ':';
+    pos = FormatTwoDigits(tm.tm_min, pos);
+    *pos++ = ':';
+    pos = FormatTwoDigits(tm.tm_sec, pos);
+  }
+
+  last_time_ = time;
+  last_time_type_ = type_code;
+  last_time_size_ = pos - last_time_str_;
+  Append(last_time_str_, last_time_size_);
+}
+
+TableResultWriter::TableResultWriter(std::ostream& out_stream)
+    : ResultWriter(out_stream), streaming_(false) {}
+
+void TableResultWriter::Begin(const std::vector<std::string>& column_names) {
+  column_names_ = column_names;
+  column_widths_.clear();
+  for (const auto& name : column_names_) {
+    column_widths_.push_back(name.size());
+  }
+}
+
+bool TableResultWriter::Write(const sql::TypeValueList& tuple) {
+  std::vector<std::string> row;
+
+  for (std::size_t i = 0; i < tuple.size(); i++) {
+    row.push_back(sql::ValueToString(tuple.at(i).first, tuple.at(i).second));
+  }
+  ++row_num_;
+
+  if (streaming_) {
+    AppendRow(row);
+    return true;
+  }
+
+  for (std::size_t i = 0; i < row.size(); i++) {
+    column_widths_.at(i) = std::max(column_widths_.at(i), row.at(i).size());
+  }
+  window_.push_back(std::move(row));
+  if (window_.size() >= lookahead_row_num) {
+    StartStreaming();
+  }
+  return true;
+}
+
+void TableResultWriter::Finish(void) {
+  if (!row_num_) {
+    Append(std::string("Empty set\n"));
+    Flush();
+    return;
+  }
+
+  if (!streaming_) {
+    StartStreaming();
+  }
+  Append(delimit_line_);
+  Append(std::to_string(row_num_) + " rows in set\n");
+  Flush();
+}
+
+void TableResultWriter::StartStreaming(void) {
+  // form delimited line
+  delimit_line_ = "+";
+  for (auto width : column_widths_) {
+    delimit_line_.append(width + 2, '-');
+    delimit_line_.append("+");
+  }
+  delimit_line_.append("\n");
+
+  Append(delimit_line_);
+  AppendRow(column_names_);
+  Append(delimit_line_);
+
+  for (const auto& row : window_) {
+    AppendRow(row);
+  }
+  window_.clear();
+  window_.shrink_to_fit();
+  streaming_ = true;
+}
+
+void TableResultWriter::AppendRow(const std::vector<std::string>& row) {
+  for (std::size_t i = 0; i < row.size(); i++) {
+    Append("| ", 2);
+    Append(row.at(i));
+    // at least one space, also after a value wider than its column
+    std::size_t pad(column_widths_.at(i) > row.at(i).size()
+                        ? column_widths_.at(i) - row.at(i).size() + 1
+                        : 1);
+    AppendFill(pad, ' ');
+  }
+  Append("|\n", 2);
+}
+
+CsvResultWriter::CsvResultWriter(std::ostream& out_stream, const bool& header)
+    : ResultWriter(out_stream), header_(header) {}
+
+void CsvResultWriter::Begin(const std::vector<std::string>& column_names) {
+  if (!header_) {
+    return;
+  }
+  for (std::size_t i = 0; i < column_names.size(); i++) {
+    if (i) {
+      Append(',');
+    }
+    AppendField(column_names.at(i).data(), column_names.at(i).size());
+  }
+  Append('\n');
+}
+
+bool CsvResultWriter::Write(const sql::TypeValueList& tuple) {
+  for (std::size_t i = 0; i < tuple.size(); i++) {
+    const sql::TypeCode& type_code(tuple.at(i).first);
+    if (i) {
+      Append(',');
+    }
+    if (sql::IsTypeCodeNull(type_code)) {
+      continue;
+    } else if (type_code > sql::Text) {
+      const std::string& text(sql::ValueCast<std::string>(tuple.at(i).second));
+      AppendField(text.data(), text.size());
+    } else {
+      AppendValue(type_code, tuple.at(i).second);
+    }
+  }
+  Append('\n');
+  ++row_num_;
+  return true;
+}
+
+void CsvResultWriter::Finish(void) { Flush(); }
+
+void CsvResultWriter::AppendField(const char* data, const std::size_t& size) {
+  const char* end(data + size);
+
+  if (std::find_if(data, end, [](const char& c) {
+        return c == ',' || c == '"' || c == '\n' || c == '\r';
+      }) == end) {
+    Append(data, size);
+    return;
+  }
+
+  Append('"');
+  for (const char* pos = data; pos != end; pos++) {
+    if (*pos == '"') {
+      Append('"');
+    }
+    Append(*pos);
+  }
+  Append('"');
+}
+
+TsvResultWriter::TsvResultWriter(std::ostream& out_stream)
+    : ResultWriter(out_stream) {}
+
+void TsvResultWriter::Begin(const std::vector<std::string>& column_names) {
+  for (std::size_t i = 0; i < column_names.size(); i++) {
+    if (i) {
+      Append('\t');
+    }
+    AppendField(column_names.at(i).data(), column_names.at(i).size());
+  }
+  Append('\n');
+}
+
+bool TsvResultWriter::Write(const sql::TypeValueList& tuple) {
+  for (std::size_t i = 0; i < tuple.size(); i++) {
+    const sql::TypeCode& type_code(tuple.at(i).first);
+    if (i) {
+      Append('\t');
+    }
+    if (sql::IsTypeCodeNull(type_code)) {
+      Append("\\N", 2);
+    } else if (type_code > sql::Text) {
+      const std::string& text(sql::ValueCast<std::string>(tuple.at(i).second));
+      AppendField(text.data(), text.size());
+    } else {
+      AppendValue(type_code, tuple.at(i).second);
+    }
+  }
+  Append('\n');
+  ++row_num_;
+  return true;
+}
+
+void TsvResultWriter::Finish(void) { Flush(); }
+
+void TsvResultWriter::AppendField(const char* data, const std::size_t& size) {
+  const char* begin(data);
+  const char* end(data + size);
+
+  // plain runs go out in one piece
+  for (const char* pos = data; pos != end; pos++) {
+    char escape(0);
+    switch (*pos) {
+      case '\t':
+        escape = 't';
+        break;
+      case '\n':
+        escape = 'n';
+        break;
+      case '\r':
+        escape = 'r';
+        break;
+      case '\\':
+        escape = '\\';
+        break;
+      default:
+        continue;
+    }
+    Append(begin, pos - begin);
+    Append('\\');
+    Append(escape);
+    begin = pos + 1;
+  }
+  Append(begin, end - begin);
+}
+
+JsonLinesResultWriter::JsonLinesResultWriter(std::ostream& out_stream)
+    : ResultWriter(out_stream) {}
+
+void JsonLinesResultWriter::Begin(
+    const std::vector<std::string>& column_names) {
+  // the keys are the same on every row, escape them once
+  keys_.clear();
+  for (const auto& name : column_names) {
+    std::string key("\"");
+    EscapeJson(name.data(), name.size(),
+               [&key](const char* part, const std::size_t& length) {
+                 key.append(part, length);
+               });
+    key.append("\":");
+    keys_.push_back(std::move(key));
+  }
+}
+
+bool JsonLinesResultWriter::Write(const sql::TypeValueList& tuple) {
+  Append('{');
+  for (std::size_t i = 0; i < tuple.size(); i++) {
+    const sql::TypeCode& type_code(tuple.at(i).first);
+    if (i) {
+      Append(',');
+    }
+    Append(keys_.at(i));
+    if (sql::IsTypeCodeNull(type_code)) {
+      Append("null", 4);
+    } else if (type_code > sql::Text) {
+      const std::string& text(sql::ValueCast<std::string>(tuple.at(i).second));
+      AppendString(text.data(), text.size());
+    } else if (sql::DateTime == type_code || sql::Date == type_code) {
+      Append('"');
+      AppendValue(type_code, tuple.at(i).second);
+      Append('"');
+    } else if ((sql::Real == type_code &&
+                !std::isfinite(sql::ValueCast<float>(tuple.at(i).second))) ||
+               (sql::Double == type_code &&
+                !std::isfinite(sql::ValueCast<double>(tuple.at(i).second)))) {
+      // JSON has no infinity or NaN
+      Append("null", 4);
+    } else {
+      AppendValue(type_code, tuple.at(i).second);
+    }
+  }
+  Append("}\n", 2);
+  ++row_num_;
+  return true;
+}
+
+void JsonLinesResultWriter::Finish(void) { Flush(); }
+
+void JsonLinesResultWriter::AppendString(const char* data,
+                                         const std::size_t& size) {
+  Append('"');
+  EscapeJson(data, size, [this](const char* part, const std::size_t& length) {
+    Append(part, length);
+  });
+  Append('"');
+}
+
+BinaryResultWriter::BinaryResultWriter(std::ostream& out_stream)
+    : ResultWriter(out_stream), block_row_num_(0) {}
+
+void BinaryResultWriter::Begin(const std::vector<std::string>& column_names) {
+  std::string header("TBRB");
+
+  header.push_back(1);
+  AppendBigEndian<uint32_t>(column_names.size(), header);
+  for (const auto& name : column_names) {
+    AppendBigEndian<uint16_t>(name.size(), header);
+    header.append(name);
+  }
+  Append(header);
+
+  segments_.assign(column_names.size(), std::string());
+  block_row_num_ = 0;
+}
+
+bool BinaryResultWriter::Write(const sql::TypeValueList& tuple) {
+  for (std::size_t i = 0; i < tuple.size(); i++) {
+    const sql::TypeCode& type_code(tuple.at(i).first);
+    const sql::Value& value(tuple.at(i).second);
+    std::string& segment(segments_.at(i));
+
+    segment.push_back(static_cast<char>(type_code));
+    switch (type_code) {
+      case sql::TinyInt:
+        segment.push_back(sql::ValueCast<int8_t>(value));
+        break;
+      case sql::SmallInt:
+        AppendBigEndian(sql::ValueCast<int16_t>(value), segment);
+        break;
+      case sql::Int:
+        AppendBigEndian(sql::ValueCast<int32_t>(value), segment);
+        break;
+      case sql::BigInt:
+      case sql::DateTime:
+      case sql::Date:
+        AppendBigEndian(sql::ValueCast<int64_t>(value), segment);
+        break;
+      case sql::Real:
+        AppendBigEndian(sql::ValueCast<float>(value), segment);
+        break;
+      case sql::Double:
+        AppendBigEndian(sql::ValueCast<double>(value), segment);
+        break;
+      default:
+        if (type_code > sql::Text) {
+          segment.append(sql::ValueCast<std::string>(value));
+        }
+        break;
+    }
+  }
+
+  ++row_num_;
+  if (++block_row_num_ >= binary_block_row_num) {
+    FlushBlock();
+  }
+  return true;
+}
+
+void BinaryResultWriter::Finish(void) {
+  std::string end;
+
+  FlushBlock();
+  AppendBigEndian<uint32_t>(0, end);
+  Append(end);
+  Flush();
+}
+
+void BinaryResultWriter::FlushBlock(void) {
+  std::string size;
+
+  if (!block_row_num_) {
+    return;
+  }
+
+  AppendBigEndian<uint32_t>(block_row_num_, size);
+  Append(size);
+  for (auto& segment : segments_) {
+    size.clear();
+    AppendBigEndian<uint32_t>(segment.size(), size);
+    Append(size);
+    Append(segment);
+    segment.clear();
+  }
+  block_row_num_ = 0;
+}
+
+bool ParseOutputMode(const std::string& name, OutputMode& mode) {
+  static const std::vector<std::pair<std::string, OutputMode>> modes = {
+      {"table", TableMode},
+      {"csv", CsvMode},
+      {"tsv", TsvMode},
+      {"jsonl", JsonLinesMode},
+      {"binary", BinaryMode}};
+
+  for (const auto& entry : modes) {
+    if (entry.first == name) {
+      mode = entry.second;
+      return true;
+    }
+  }
+  return false;
+}
+
+const std::string OutputModeToString(const OutputMode& mode) {
+  switch (mode) {
+    case CsvMode:
+      return "csv";
+    case TsvMode:
+      return "tsv";
+    case JsonLinesMode:
+      return "jsonl";
+    case BinaryMode:
+      return "binary";
+    default:
+      break;
+  }
+  return "table";
+}
+
+std::unique_ptr<ResultWriter> MakeResultWriter(const OutputMode& mode,
+                                               std::ostream& out_stream) {
+  switch (mode) {
+    case CsvMode:
+      return std::unique_ptr<ResultWriter>(
+          new CsvResultWriter(out_stream, true));
+    case TsvMode:
+      return std::unique_ptr<ResultWriter>(new TsvResultWriter(out_stream));
+    case JsonLinesMode:
+      return std::unique_ptr<ResultWriter>(
+          new JsonLinesResultWriter(out_stream));
+    case BinaryMode:
+      return std::unique_ptr<ResultWriter>(new BinaryResultWriter(out_stream));
+    default:
+      break;
+  }
+  return std::unique_ptr<ResultWriter>(new TableResultWriter(out_stream));
+}
+
+}  // namespace internal
@@ -0,0 +1,199 @@
+#ifndef TINY_BASE_RESULT_WRITER_H_
+#define TINY_BASE_RESULT_WRITER_H_
+
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "sql_command.h"
+
+namespace internal {
+
+// output collected before a single write to the stream
+constexpr std::size_t output_buffer_size = (1 << 20);
+// rows a table is measured on before it starts printing
+constexpr std::size_t lookahead_row_num = 1024;
+// rows of one block of the binary format
+constexpr std::size_t binary_block_row_num = 4096;
+
+enum OutputMode { TableMode, CsvMode, TsvMode, JsonLinesMode, BinaryMode };
+
+// Result rows of a query, written out as the scan produces them through a
+// large buffer instead of being held until the query ends.
+class ResultWriter {
+ public:
+  explicit ResultWriter(std::ostream& out_stream);
+
+  virtual ~ResultWriter(void);
+
+  ResultWriter(const ResultWriter&) = delete;
+
+  ResultWriter& operator=(const ResultWriter&) = delete;
+
+  virtual void Begin(const std::vector<std::string>& column_names) = 0;
+
+  // false once the writer wants no more rows
+  virtual bool Write(const sql::TypeValueList& tuple) = 0;
+
+  virtual void Finish(void) = 0;
+
+  uint64_t GetRowNum(void) const { return row_num_; }
+
+ protected:
+  uint64_t row_num_;
+
+  void Append(const char* data, const std::size_t& size) {
+    buffer_.append(data, size);
+    if (buffer_.size() >= output_buffer_size) {
+      Flush();
+    }
+  }
+
+  void Append(const std::string& str) { Append(str.data(), str.size()); }
+
+  void Append(const char& c) { Append(&c, 1); }
+
+  void AppendFill(const std::size_t& count, const char& c) {
+    buffer_.append(count, c);
+    if (buffer_.size() >= output_buffer_size) {
+      Flush();
+    }
+  }
+
+  void Flush(void);
+
+  // a value as ValueToString prints it, written straight into the buffer;
+  // TEXT goes out as is, NULL as "NULL"
+  void AppendValue(const sql::TypeCode& type_code, const sql::Value& value);
+
+ private:
+  std::ostream& out_stream_;
+  std::string buffer_;
+  // DATE and DATETIME of the last call, rows often repeat them
+  std::time_t last_time_;
+  sql::TypeCode last_time_type_;
+  char last_time_str_[32];
+  std::size_t last_time_size_;
+
+  void AppendInteger(const int64_t& value);
+
+  void AppendTime(const sql::TypeCode& type_code, const std::time_t& time);
+};
+
+// The ASCII table of the REPL. Column widths are measured on the first
+// lookahead_row_num rows, which are held back until then; a later value that
+// is wider than its column still prints in full.
+class TableResultWriter : public ResultWriter {
+ public:
+  explicit TableResultWriter(std::ostream& out_stream);
+
+  void Begin(const std::vector<std::string>& column_names) override;
+
+  bool Write(const sql::TypeValueList& tuple) override;
+
+  void Finish(void) override;
+
+ private:
+  std::vector<std::string> column_names_;
+  std::vector<std::size_t> column_widths_;
+  std::vector<std::vector<std::string>> window_;
+  bool streaming_;
+  std::string delimit_line_;
+
+  // widths are fixed from here on
+  void StartStreaming(void);
+
+  void AppendRow(const std::vector<std::string>& row);
+};
+
+// RFC 4180: a header line unless header is off, then one line per row.
+// Fields with a comma, quote or line break are quoted, NULL is an empty field.
+class CsvResultWriter : public ResultWriter {
+ public:
+  CsvResultWriter(std::ostream& out_stream, const bool& header);
+
+  void Begin(const std::vector<std::string>& column_names) override;
+
+  bool Write(const sql::TypeValueList& tuple) override;
+
+  void Finish(void) override;
+
+ private:
+  bool header_;
+
+  void AppendField(const char* data, const std::size_t& size);
+};
+
+// Tab separated with a header line. Tab, line break and backslash in a value
+// are escaped with a backslash, NULL is \N.
+class TsvResultWriter : public ResultWriter {
+ public:
+  explicit TsvResultWriter(std::ostream& out_stream);
+
+  void Begin(const std::vector<std::string>& column_names) override;
+
+  bool Write(const sql::TypeValueList& tuple) override;
+
+  void Finish(void) override;
+
+ private:
+  void AppendField(const char* data, const std::size_t& size);
+};
+
+// One JSON object per row keyed on the column names. Numbers are bare, TEXT,
+// DATE and DATETIME are strings.
+class JsonLinesResultWriter : public ResultWriter {
+ public:
+  explicit JsonLinesResultWriter(std::ostream& out_stream);
+
+  void Begin(const std::vector<std::string>& column_names) override;
+
+  bool Write(const sql::TypeValueList& tuple) override;
+
+  void Finish(void) override;
+
+ private:
+  // quoted and escaped keys, with the colon
+  std::vector<std::string> keys_;
+
+  void AppendString(const char* data, const std::size_t& size);
+};
+
+// Columnar blocks, all integers big endian as in the pages:
+//   header  "TBRB", u8 version, u32 column number, per column u16 name size
+//           and the name
+//   block   u32 row number, per column u32 segment size and the segment
+//   end     u32 0
+// A segment holds the values of one column: the type code of the value, then
+// its bytes as a cell stores them (TEXT not reversed, its size is the type
+// code less 0x0C). NULL has the type code only.
+class BinaryResultWriter : public ResultWriter {
+ public:
+  explicit BinaryResultWriter(std::ostream& out_stream);
+
+  void Begin(const std::vector<std::string>& column_names) override;
+
+  bool Write(const sql::TypeValueList& tuple) override;
+
+  void Finish(void) override;
+
+ private:
+  std::vector<std::string> segments_;
+  std::size_t block_row_num_;
+
+  void FlushBlock(void);
+};
+
+// names as .mode and --mode take them
+bool ParseOutputMode(const std::string& name, OutputMode& mode);
+
+const std::string OutputModeToString(const OutputMode& mode);
+
+std::unique_ptr<ResultWriter> MakeResultWriter(const OutputMode& mode,
+                                               std::ostream& out_stream);
+
+}  // namespace internal
+
+#endif  // TINY_BASE_RESULT_WRITER_H_
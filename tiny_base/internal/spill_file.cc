@@ -0,0 +1,93 @@
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+#include "spill_file.h"
+
+namespace internal {
+
+namespace {
+
+const std::size_t spill_buffer_size = 1 << 16;
+
+}  // namespace
+
+SpillFile::SpillFile(void)
+    : stream_buffer_(spill_buffer_size), tuple_num_(0) {
+  std::string name_template(
+      (fs::temp_directory_path() / "tiny_base_spill_XXXXXX").string());
+
+  int fd = mkstemp(&name_template[0]);
+  if (fd < 0) {
+    throw std::runtime_error("cannot create spill file");
+  }
+  close(fd);
+  file_path_ = name_template;
+
+  // the buffer has to be installed before the file is opened
+  file_stream_.rdbuf()->pubsetbuf(stream_buffer_.data(),
+                                  stream_buffer_.size());
+  file_stream_.open(file_path_, (std::ios::binary | std::ios::in |
+                                 std::ios::out | std::ios::trunc));
+  if (!file_stream_) {
+    fs::remove(file_path_);
+    throw std::runtime_error("cannot open spill file");
+  }
+}
+
+SpillFile::~SpillFile(void) {
+  file_stream_.close();
+  std::error_code error;
+  fs::remove(file_path_, error);
+}
+
+void SpillFile::Write(const sql::TypeValueList& tuple) {
+  uint16_t column_num(tuple.size());
+
+  file_stream_.write(reinterpret_cast<const char*>(&column_num),
+                     sizeof(column_num));
+
+  // type code, then the value bytes unless it is a fixed width NULL
+  for (const auto& column : tuple) {
+    file_stream_.put(static_cast<char>(column.first));
+    if (column.first < sql::Text && sql::IsTypeCodeNull(column.first)) {
+      continue;
+    }
+    sql::ValueToBytes(column.first, column.second, bytes_);
+    file_stream_.write(bytes_.data(), bytes_.size());
+  }
+
+  ++tuple_num_;
+}
+
+void SpillFile::Rewind(void) {
+  file_stream_.flush();
+  file_stream_.clear();
+  file_stream_.seekg(0);
+}
+
+bool SpillFile::Read(sql::TypeValueList& tuple) {
+  uint16_t column_num(0);
+
+  if (!file_stream_.read(reinterpret_cast<char*>(&column_num),
+                         sizeof(column_num))) {
+    return false;
+  }
+
+  tuple.resize(column_num);
+  for (auto& column : tuple) {
+    column.first = static_cast<sql::TypeCode>(file_stream_.get());
+    if (column.first < sql::Text && sql::IsTypeCodeNull(column.first)) {
+      column.second = sql::Value();
+      continue;
+    }
+    bytes_.resize(sql::TypeCodeToSize(column.first));
+    file_stream_.read(bytes_.data(), bytes_.size());
+    column.second = sql::BytesToValue(column.first, bytes_.data());
+  }
+
+  return static_cast<bool>(file_stream_);
+}
+
+}  // namespace internal
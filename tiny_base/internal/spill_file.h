@@ -0,0 +1,43 @@
+#ifndef TINY_BASE_SPILL_FILE_H_
+#define TINY_BASE_SPILL_FILE_H_
+
+#include <fstream>
+#include <vector>
+#include "file_util.h"
+#include "sql_command.h"
+
+namespace internal {
+
+// Temporary file holding tuples that do not fit in memory. Tuples are written
+// sequentially, then read back in the same order after Rewind. The file is
+// removed together with the object.
+class SpillFile {
+ public:
+  SpillFile(void);
+
+  ~SpillFile(void);
+
+  SpillFile(const SpillFile&) = delete;
+
+  SpillFile& operator=(const SpillFile&) = delete;
+
+  void Write(const sql::TypeValueList& tuple);
+
+  // switch from writing to reading the first tuple
+  void Rewind(void);
+
+  bool Read(sql::TypeValueList& tuple);
+
+  std::size_t GetTupleNum(void) const { return tuple_num_; }
+
+ private:
+  fs::path file_path_;
+  std::fstream file_stream_;
+  std::vector<char> stream_buffer_;
+  std::vector<char> bytes_;
+  std::size_t tuple_num_;
+};
+
+}  // namespace internal
+
+#endif  // TINY_BASE_SPILL_FILE_H_
@@ -1,13 +1,18 @@
 #include <algorithm>
 #include <cstring>
 #include <cassert>
+#include <cmath>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <numeric>
+#include <random>
 #include <sstream>
 
 #include "cell.h"
 #include "endian_util.h"
 #include "page_format.h"
+#include "predicate.h"
 #include "table_manager.h"
 
 namespace internal {
@@ -17,7 +22,11 @@ TableManager::TableManager(const fs::path& file_path)
       root_page_(0),
       page_num_(0),
       fanout_(std::numeric_limits<decltype(fanout_)>::max()),
-      table_file_(std::make_shared<utils::FileUtil>(file_path_)) {}
+      row_count_(0),
+      max_key_(0),
+      statistics_(),
+      table_file_(std::make_shared<utils::FileUtil>(file_path_)),
+      memory_budget_(default_memory_budget) {}
 
 TableManager::~TableManager(void) {}
 
@@ -45,48 +54,327 @@ void TableManager::CreateTable(const sql::CreateTableCommand& command) {
   CreatePage(TableLeafCell);
 }
 
-const std::pair<int32_t, std::string> TableManager::SelectFrom(
-    const sql::SelectFromCommand& command) {
-  std::vector<PageCell> tuples;
+uint64_t TableManager::SelectFrom(const sql::SelectFromCommand& command,
+                                  ResultWriter& writer) {
+  ScanPlan plan(PlanScan(command));
+
+  return FilterTuple(command,
+                     [&](const TupleConsumer& consumer) {
+                       PullResultTuple(plan, consumer);
+                     },
+                     writer);
+}
 
-  PullTuple(command, tuples);
+uint64_t TableManager::CopyTo(const sql::SelectFromCommand& command,
+                              ResultWriter& writer) {
+  ScanPlan plan(PlanScan(command));
 
-  return FilterTuple(command, tuples);
+  return FilterTuple(
+      command,
+      [&](const TupleConsumer& consumer) {
+        if (KeyRangePath == plan.access_path) {
+          PullTupleWithPrimary(plan, consumer);
+          return;
+        }
+        PageRange range(
+            SearchPage(root_page_, std::numeric_limits<PrimaryKey>::min()),
+            SearchPage(root_page_, std::numeric_limits<PrimaryKey>::max()));
+        ScanLeaves(*table_file_, range, 0, GetCellNum(range.second), plan,
+                   consumer);
+      },
+      writer);
 }
 
 const std::vector<sql::TypeValueList> TableManager::InternalSelectFrom(
     const sql::SelectFromCommand& command) {
-  std::vector<PageCell> tuples;
-
-  PullTuple(command, tuples);
-
-  return InternalFilterTuple(command, tuples);
+  return InternalFilterTuple(command, PlanScan(command));
 }
 
 void TableManager::InsertInto(const sql::InsertIntoCommand& command) {
   CellKey pri_key(GetPrimaryKey(command));
-  PageIndex target_page(SearchPage(root_page_, pri_key));
 
-  if (page_list_.at(target_page).IsKeyDuplicate(pri_key)) {
+  if (!InsertRow(PrepareLeafCell(command), pri_key,
+                 SearchPage(root_page_, pri_key))) {
     std::cerr
         << "Insertion aborted because trying to insert a duplicate primary key."
         << std::endl;
-    return;
   }
+}
+
+void TableManager::InsertBatch(const sql::InsertIntoCommandList& commands) {
+  std::vector<std::size_t> order(commands.size());
+  std::vector<PrimaryKey> keys;
+  PageIndex target_page(0);
+  bool with_target(false);
+
+  // sort positions, a prepared statement points into the commands; equal
+  // keys keep their order so the first written wins
+  for (const auto& command : commands) {
+    keys.push_back(GetPrimaryKey(command));
+  }
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&keys](const std::size_t& l, const std::size_t& r) {
+                     return keys.at(l) < keys.at(r);
+                   });
+
+  for (auto index : order) {
+    if (!with_target || !IsInLeaf(target_page, keys.at(index))) {
+      target_page = SearchPage(root_page_, keys.at(index));
+      with_target = true;
+    }
+    if (!InsertRow(PrepareLeafCell(commands.at(index)), keys.at(index),
+                   target_page)) {
+      std::cerr << "Insertion aborted because trying to insert a duplicate "
+                   "primary key."
+                << std::endl;
+    }
+  }
+}
 
-  PageCell cell(PrepareLeafCell(command));
+bool TableManager::InsertRow(const PageCell& cell,
+                             const PrimaryKey& primary_key,
+                             const PageIndex& target_page) {
+  if (page_list_.at(target_page).IsKeyDuplicate(primary_key)) {
+    return false;
+  }
 
   if ((fanout_ == std::numeric_limits<decltype(fanout_)>::max()) &&
       !HasSpace(target_page, cell.size())) {
     UpdateFanout(target_page);
   }
 
-  InsertCell(target_page, pri_key, cell, nullptr);
+  InsertCell(target_page, primary_key, cell, nullptr);
+
+  if (!row_count_ || primary_key > max_key_) {
+    max_key_ = primary_key;
+  }
+  ++row_count_;
+  return true;
+}
+
+bool TableManager::IsInLeaf(const PageIndex& leaf_page,
+                            const PrimaryKey& primary_key) const {
+  // the leaf covers up to its last key, or everything when it ends the chain;
+  // after a split the key may have moved on to the new right page
+  const CellIndex cell_num(GetCellNum(leaf_page));
+
+  return (!GetRightMostPointer(leaf_page) ||
+          (cell_num && primary_key <= page_list_.at(leaf_page).GetCellKey(
+                                          cell_num - 1)));
+}
+
+bool TableManager::CopyFrom(const fs::path& file_path,
+                            const CsvFormat& format, CopyReport& report) {
+  std::ifstream in_stream(file_path, std::ios::binary);
+  const std::size_t read_size(
+      std::max<std::size_t>(memory_budget_ / 2, copy_min_read_size));
+  const std::size_t part_num(thread_pool_ ? thread_pool_->GetThreadNum() : 1);
+  std::string buffer;
+  std::vector<std::size_t> bounds;
+  std::vector<CellBatch> batches;
+  std::vector<CellSlice> cells;
+  PageCell cell;
+  PageIndex target_page(0);
+  bool with_target(false);
+  bool at_end(false);
+  bool skip_header(format.header);
+  BulkLoad load;
+  bool bulk(!row_count_ && IsLeaf(root_page_) && !GetCellNum(root_page_));
+
+  report = {0, 0, false, 0, ""};
+  if (!in_stream) {
+    report.failed = true;
+    report.error = "cannot open " + file_path.string();
+    return false;
+  }
+
+  while (!at_end && !report.failed) {
+    std::size_t kept(buffer.size());
+    buffer.resize(kept + read_size);
+    in_stream.read(&buffer[kept], read_size);
+    buffer.resize(kept + in_stream.gcount());
+    at_end = !in_stream;
+
+    // a row longer than the read waits for more input
+    SplitCsvRows(buffer.data(), buffer.size(), part_num, at_end, bounds);
+    if (!bounds.back() && !at_end) {
+      continue;
+    }
+
+    batches.assign(bounds.size() - 1, CellBatch());
+    auto load_range = [&](const std::size_t& i) {
+      CellEncoder encoder(table_schema_);
+      LoadCsvRange(buffer.data() + bounds.at(i),
+                   buffer.data() + bounds.at(i + 1), format,
+                   skip_header && !i, encoder, batches.at(i));
+    };
+    if (part_num > 1 && batches.size() > 1) {
+      std::vector<utils::ThreadPool::Task> tasks;
+      for (std::size_t i = 0; i < batches.size(); i++) {
+        tasks.push_back([&load_range, i](const std::size_t&) {
+          load_range(i);
+        });
+      }
+      thread_pool_->Run(tasks);
+    } else {
+      for (std::size_t i = 0; i < batches.size(); i++) {
+        load_range(i);
+      }
+    }
+    skip_header = false;
+
+    // rows up to the first bad one, in key order
+    cells.clear();
+    for (const auto& batch : batches) {
+      for (const auto& entry : batch.entries) {
+        cells.push_back(
+            {entry.key, batch.bytes.data() + entry.offset, entry.size});
+      }
+      if (batch.failed) {
+        report.failed = true;
+        report.error_row = report.row_num + batch.row_num;
+        report.error = batch.error;
+        break;
+      }
+      report.row_num += batch.row_num;
+    }
+    auto key_less = [](const CellSlice& l, const CellSlice& r) {
+      return l.key < r.key;
+    };
+    if (!std::is_sorted(cells.begin(), cells.end(), key_less)) {
+      std::stable_sort(cells.begin(), cells.end(), key_less);
+    }
+
+    with_target = false;
+    for (const auto& slice : cells) {
+      if (bulk && (load.leaves.empty() || slice.key > max_key_)) {
+        BulkAppend(load, slice);
+        continue;
+      } else if (bulk && slice.key == max_key_) {
+        ++report.duplicate_num;
+        continue;
+      } else if (bulk) {
+        BulkFinish(load);
+        bulk = false;
+      }
+
+      if (!with_target || !IsInLeaf(target_page, slice.key)) {
+        target_page = SearchPage(root_page_, slice.key);
+        with_target = true;
+      }
+      cell.assign(slice.data, slice.data + slice.size);
+      if (!InsertRow(cell, slice.key, target_page)) {
+        ++report.duplicate_num;
+      }
+    }
+
+    buffer.erase(0, bounds.back());
+  }
+
+  if (bulk) {
+    BulkFinish(load);
+  }
+  if (report.failed) {
+    report.row_num = report.error_row - 1;
+  }
+  return !report.failed;
+}
+
+void TableManager::BulkAppend(BulkLoad& load, const CellSlice& cell) {
+  std::size_t used(table_header_length +
+                   (load.entries.size() + 1) * cell_pointer_length +
+                   load.bytes.size() + cell.size);
+  bool fanout_full(fanout_ != std::numeric_limits<decltype(fanout_)>::max() &&
+                   load.entries.size() + 1 > fanout_ - 1);
+
+  // the empty root is the first leaf, as with inserts the fanout is fixed
+  // when it fills
+  if (load.leaves.empty()) {
+    load.leaves.emplace_back(root_page_, cell.key);
+  } else if (used > page_size || fanout_full) {
+    if (fanout_ == std::numeric_limits<decltype(fanout_)>::max()) {
+      fanout_ = load.entries.size() + 1;
+    }
+    PageIndex next_page(CreatePage(TableLeafCell));
+    SetRightMostPointer(load.leaves.back().first, next_page);
+    BulkFlushLeaf(load);
+    load.leaves.emplace_back(next_page, cell.key);
+  }
+
+  load.entries.push_back({cell.key, load.bytes.size(), cell.size});
+  load.bytes.insert(load.bytes.end(), cell.data, cell.data + cell.size);
+
+  if (!row_count_ || cell.key > max_key_) {
+    max_key_ = cell.key;
+  }
+  ++row_count_;
+}
+
+void TableManager::BulkFlushLeaf(BulkLoad& load) {
+  std::vector<CellSlice> cells;
+
+  for (const auto& entry : load.entries) {
+    cells.push_back({entry.key, load.bytes.data() + entry.offset, entry.size});
+  }
+  page_list_.at(load.leaves.back().first).Fill(cells);
+
+  load.bytes.clear();
+  load.entries.clear();
+}
+
+void TableManager::BulkFinish(BulkLoad& load) {
+  std::vector<std::pair<PageIndex, CellKey>> level;
+  std::vector<std::pair<PageIndex, CellKey>> upper_level;
+  // children of an interior page, bounded by the fanout and the page
+  const std::size_t capacity(std::min<std::size_t>(
+      fanout_, (page_size - table_header_length) /
+                       (table_interior_cell_length + cell_pointer_length) +
+                   1));
+  std::vector<PageCell> interior_cells;
+  std::vector<CellSlice> cells;
+
+  if (load.leaves.empty()) {
+    return;
+  }
+  BulkFlushLeaf(load);
+
+  // spread the children of a level evenly, so no page is left with one
+  level.swap(load.leaves);
+  while (level.size() > 1) {
+    std::size_t page_num((level.size() + capacity - 1) / capacity);
+    upper_level.clear();
+    for (std::size_t i = 0; i < page_num; i++) {
+      std::size_t begin(level.size() * i / page_num);
+      std::size_t end(level.size() * (i + 1) / page_num);
+      PageIndex page(CreatePage(TableInteriorCell));
+
+      // a separator is the first key of the child to its right
+      interior_cells.clear();
+      cells.clear();
+      for (std::size_t j = begin; j + 1 < end; j++) {
+        interior_cells.push_back(PrepareInteriorCell(
+            level.at(j).first, level.at(j + 1).second));
+      }
+      for (std::size_t j = begin; j + 1 < end; j++) {
+        const PageCell& interior_cell(interior_cells.at(j - begin));
+        cells.push_back({level.at(j + 1).second, interior_cell.data(),
+                         interior_cell.size()});
+      }
+      SetRightMostPointer(page, level.at(end - 1).first);
+      page_list_.at(page).Fill(cells);
+      UpdateParent(page);
+
+      upper_level.emplace_back(page, level.at(begin).second);
+    }
+    level.swap(upper_level);
+  }
+
+  root_page_ = level.front().first;
 }
 
 PrimaryKey TableManager::GetPrimaryKey(const sql::InsertIntoCommand& command) {
-  PrimaryKey primary_key =
-      std::experimental::any_cast<int32_t>(command.value_list[0]);
+  PrimaryKey primary_key = sql::ValueCast<int32_t>(command.value_list[0]);
   return primary_key;
 }
 
@@ -130,53 +418,46 @@ PageCell TableManager::PrepareLeafCell(const sql::InsertIntoCommand& command) {
     switch (command.type_list.at(i)) {
       case sql::OneByteNull:
       case sql::TinyInt:
-        table_leaf_cell[offset] =
-            std::experimental::any_cast<int8_t>(command.value_list[i]);
+        table_leaf_cell[offset] = sql::ValueCast<int8_t>(command.value_list[i]);
         break;
       case sql::TwoByteNull:
       case sql::SmallInt: {
-        int16_t value_16 =
-            std::experimental::any_cast<int16_t>(command.value_list[i]);
+        int16_t value_16 = sql::ValueCast<int16_t>(command.value_list[i]);
         value_16 = utils::SwapEndian<decltype(value_16)>(value_16);
         std::memcpy(table_leaf_cell.data() + offset, &value_16, type_size);
       } break;
       case sql::FourByteNull:
       case sql::Int: {
-        int32_t value_32 =
-            std::experimental::any_cast<int32_t>(command.value_list[i]);
+        int32_t value_32 = sql::ValueCast<int32_t>(command.value_list[i]);
         value_32 = utils::SwapEndian<decltype(value_32)>(value_32);
         std::memcpy(table_leaf_cell.data() + offset, &value_32, type_size);
       } break;
       case sql::EightByteNull:
       case sql::BigInt: {
-        int64_t value_64 =
-            std::experimental::any_cast<int64_t>(command.value_list[i]);
+        int64_t value_64 = sql::ValueCast<int64_t>(command.value_list[i]);
         value_64 = utils::SwapEndian<decltype(value_64)>(value_64);
         std::memcpy(table_leaf_cell.data() + offset, &value_64, type_size);
       } break;
       case sql::Real: {
-        float value_float =
-            sql::expr::any_cast<float>(command.value_list.at(i));
+        float value_float = sql::ValueCast<float>(command.value_list.at(i));
         value_float = utils::SwapEndian<decltype(value_float)>(value_float);
         std::memcpy(table_leaf_cell.data() + offset, &value_float, type_size);
       } break;
       case sql::Double: {
-        double value_double =
-            sql::expr::any_cast<double>(command.value_list.at(i));
+        double value_double = sql::ValueCast<double>(command.value_list.at(i));
         value_double = utils::SwapEndian<decltype(value_double)>(value_double);
         std::memcpy(table_leaf_cell.data() + offset, &value_double, type_size);
       } break;
       case sql::DateTime: {
         int64_t value_date_time =
-            sql::expr::any_cast<int64_t>(command.value_list.at(i));
+            sql::ValueCast<int64_t>(command.value_list.at(i));
         value_date_time =
             utils::SwapEndian<decltype(value_date_time)>(value_date_time);
         std::memcpy(table_leaf_cell.data() + offset, &value_date_time,
                     type_size);
       } break;
       case sql::Date: {
-        int64_t value_date =
-            sql::expr::any_cast<int64_t>(command.value_list.at(i));
+        int64_t value_date = sql::ValueCast<int64_t>(command.value_list.at(i));
         value_date = utils::SwapEndian<decltype(value_date)>(value_date);
         std::memcpy(table_leaf_cell.data() + offset, &value_date, type_size);
       } break;
@@ -186,7 +467,7 @@ PageCell TableManager::PrepareLeafCell(const sql::InsertIntoCommand& command) {
 
     if (command.type_list.at(i) >= sql::Text) {
       std::string value_str =
-          std::experimental::any_cast<std::string>(command.value_list[i]);
+          sql::ValueCast<std::string>(command.value_list[i]);
       std::reverse(value_str.begin(), value_str.end());
       std::copy(value_str.begin(), value_str.end(),
                 table_leaf_cell.data() + offset);
@@ -290,9 +571,10 @@ PageIndex TableManager::SearchPage(const PageIndex& current_page,
     return SearchPage(page_list_[current_page].GetLeftMostPagePointer(),
                       primary_key);
   } else if (primary_key >= key_range.first && primary_key < key_range.second) {
+    // a separator is the smallest key of its right subtree
     return SearchPage(
         GetCellLeftPointer(current_page,
-                           GetLowerBound(current_page, primary_key)),
+                           GetLowerBound(current_page, primary_key + 1)),
         primary_key);
   } else if (primary_key >= key_range.second) {
     return SearchPage(page_list_[current_page].GetRightMostPagePointer(),
@@ -555,283 +837,821 @@ void TableManager::LoadParent(const PageIndex& page_index) {
   LoadParent(iter->GetRightMostPagePointer());
 }
 
-void TableManager::PullTupleWithPrimary(const sql::SelectFromCommand& command,
-                                        std::vector<PageCell>& tuples) {
-  PageRange range;
-  int32_t condition_value = sql::expr::any_cast<int32_t>(command.where->value);
+ScanPlan TableManager::PlanScan(const sql::SelectFromCommand& command) {
+  ScanPlan plan;
+  std::ptrdiff_t last_index(0);
 
-  PageIndex target_page(SearchPage(root_page_, condition_value));
-  PageIndex min_page(
-      SearchPage(root_page_, std::numeric_limits<PrimaryKey>::min()));
-  PageIndex max_page(
-      SearchPage(root_page_, std::numeric_limits<PrimaryKey>::max()));
+  // GROUP BY columns
+  plan.with_group = !command.group_by.empty();
+  plan.group_streaming = false;
+  for (const auto& name : command.group_by) {
+    plan.group_positions.push_back(ProjectColumn(GetColumnIndex(name), plan));
+    plan.group_streaming = plan.group_streaming || IsPrimaryKey(name);
+  }
+
+  // aggregates project each argument column once
+  plan.with_aggregate = !command.aggregates.empty();
+  plan.from_key_edges =
+      plan.with_aggregate && !plan.with_group && !command.where;
+  plan.from_row_count = plan.from_key_edges;
+  for (const auto& aggregate : command.aggregates) {
+    AggregateSpec spec = {aggregate.type, -1, sql::InvalidType};
+
+    // GROUP BY column in the SELECT list
+    if (sql::NoAggregate == aggregate.type) {
+      auto res = std::find(command.group_by.begin(), command.group_by.end(),
+                           aggregate.column_name);
+      plan.result_columns.push_back(
+          std::distance(command.group_by.begin(), res));
+      continue;
+    }
+    plan.result_columns.push_back(command.group_by.size() +
+                                  plan.aggregates.size());
+
+    if (aggregate.column_name != "*") {
+      auto index = GetColumnIndex(aggregate.column_name);
+      spec.position = ProjectColumn(index, plan);
+      spec.data_type = table_schema_.column_list.at(index).type;
+    }
+
+    plan.from_row_count = plan.from_row_count &&
+                          sql::CountAggregate == aggregate.type &&
+                          aggregate.column_name == "*";
+    plan.from_key_edges = plan.from_key_edges &&
+                          (sql::MinAggregate == aggregate.type ||
+                           sql::MaxAggregate == aggregate.type) &&
+                          IsPrimaryKey(aggregate.column_name);
+    plan.aggregates.push_back(spec);
+  }
+
+  // SELECT *
+  if (plan.with_aggregate) {
+    // argument columns are resolved already
+  } else if (command.column_name.size() == 1 &&
+             command.column_name.front() == "*") {
+    for (auto i = 0; i < table_schema_.column_list.size(); i++) {
+      plan.column_indexes.push_back(i);
+    }
+  } else {
+    for (auto name : command.column_name) {
+      plan.column_indexes.push_back(GetColumnIndex(name));
+    }
+  }
+
+  plan.with_where = static_cast<bool>(command.where);
+  plan.with_key_range = false;
+  plan.lower_key = std::numeric_limits<PrimaryKey>::min();
+  plan.upper_key = std::numeric_limits<PrimaryKey>::max();
+  if (plan.with_where) {
+    plan.condition = CompileCondition(*command.where, false);
+    plan.with_key_range =
+        NarrowKeyRange(*command.where, plan.lower_key, plan.upper_key);
+    last_index = plan.condition.GetLastColumn();
+  }
+  ChooseAccessPath(plan);
+
+  // ORDER BY, the primary key comes out of the leaves in order already
+  plan.with_order = false;
+  plan.order_position = 0;
+  plan.order_desc = false;
+  plan.hidden_column_num = 0;
+  if (command.order_by && plan.with_group) {
+    // grouped rows are sorted, the column is one of GROUP BY
+    const std::string& order_name(command.order_by->column_name);
+    std::size_t group_index(std::distance(
+        command.group_by.begin(),
+        std::find(command.group_by.begin(), command.group_by.end(),
+                  order_name)));
+    plan.order_desc = command.order_by->descending;
+    plan.with_order = !(plan.group_streaming && IsPrimaryKey(order_name) &&
+                        !plan.order_desc);
+
+    auto res = std::find(plan.result_columns.begin(),
+                         plan.result_columns.end(), group_index);
+    if (plan.with_order && res == plan.result_columns.end()) {
+      plan.result_columns.push_back(group_index);
+      plan.hidden_column_num = 1;
+      res = plan.result_columns.end() - 1;
+    }
+    plan.order_position = std::distance(plan.result_columns.begin(), res);
+  } else if (command.order_by) {
+    auto order_index = GetColumnIndex(command.order_by->column_name);
+    plan.order_desc = command.order_by->descending;
+    plan.with_order = (!IsPrimaryKey(command.order_by->column_name) ||
+                       plan.order_desc);
+
+    auto res = std::find(plan.column_indexes.begin(),
+                         plan.column_indexes.end(), order_index);
+    if (plan.with_order && res == plan.column_indexes.end()) {
+      plan.column_indexes.push_back(order_index);
+      plan.hidden_column_num = 1;
+      res = plan.column_indexes.end() - 1;
+    }
+    plan.order_position = std::distance(plan.column_indexes.begin(), res);
+  }
+
+  plan.with_limit = static_cast<bool>(command.limit);
+  plan.offset = plan.with_limit ? command.limit->offset : 0;
+  plan.limit = plan.with_limit ? command.limit->row_count
+                               : std::numeric_limits<uint64_t>::max();
+
+  // referenced columns: WHERE, SELECT list and ORDER BY
+  for (auto index : plan.column_indexes) {
+    last_index = std::max(last_index, index);
+  }
+  plan.column_limit = last_index + 1;
+
+  return plan;
+}
+
+CompiledCondition TableManager::CompileCondition(
+    const sql::Condition& condition, const bool& negate) {
+  if (sql::LeafCondition == condition.type) {
+    sql::WhereClause clause(condition.clause);
+    if (negate) {
+      clause.condition_operator =
+          sql::NegateOperator(clause.condition_operator);
+    }
+    return CompiledCondition::Leaf(GetColumnIndex(clause.column_name), clause,
+                                   EstimateSelectivity(clause));
+  }
+
+  if (sql::NotCondition == condition.type) {
+    return CompileCondition(condition.children.front(), !negate);
+  }
+
+  // De Morgan: NOT (a AND b) is NOT a OR NOT b
+  sql::ConditionType type(condition.type);
+  if (negate) {
+    type = (sql::AndCondition == type) ? sql::OrCondition : sql::AndCondition;
+  }
 
-  switch (command.where->condition_operator) {
+  std::vector<CompiledCondition> operands;
+  for (const auto& child : condition.children) {
+    operands.push_back(CompileCondition(child, negate));
+  }
+  return CompiledCondition::Node(type, std::move(operands));
+}
+
+double TableManager::EstimateSelectivity(
+    const sql::WhereClause& clause) const {
+  double selectivity(1.0);
+
+  // keys are unique and their range is known
+  if (IsPrimaryKey(clause.column_name) && sql::Int == clause.type_code &&
+      row_count_) {
+    int64_t key(sql::ValueCast<int32_t>(clause.value));
+    switch (clause.condition_operator) {
+      case sql::Equal:
+        return EstimateKeyFraction(key, key);
+      case sql::Unequal:
+        return 1.0 - EstimateKeyFraction(key, key);
+      case sql::Larger:
+        return EstimateKeyFraction(key + 1, max_key_);
+      case sql::NotSmaller:
+        return EstimateKeyFraction(key, max_key_);
+      case sql::Smaller:
+        return EstimateKeyFraction(GetMinKey(), key - 1);
+      case sql::NotLarger:
+        return EstimateKeyFraction(GetMinKey(), key);
+      default:
+        break;
+    }
+  }
+
+  // distinct counts and histograms of the last ANALYZE
+  for (const auto& column : statistics_.columns) {
+    if (column.column_name == clause.column_name &&
+        !sql::IsTypeCodeNull(clause.type_code)) {
+      selectivity = internal::EstimateSelectivity(column, clause);
+      if (selectivity >= 0.0) {
+        return selectivity;
+      }
+      selectivity = 1.0;
+      break;
+    }
+  }
+
+  // textbook defaults until the table has statistics
+  switch (clause.condition_operator) {
     case sql::Equal:
-      range = std::make_pair(target_page, target_page);
+      selectivity = IsPrimaryKey(clause.column_name) ? 0.01 : 0.1;
       break;
     case sql::Unequal:
-      range = std::make_pair(min_page, max_page);
+      selectivity = 0.9;
       break;
     case sql::Larger:
-      range = std::make_pair(target_page, max_page);
-      break;
     case sql::Smaller:
-      range = std::make_pair(min_page, target_page);
-      break;
     case sql::NotLarger:
-      range = std::make_pair(min_page, target_page);
-      break;
     case sql::NotSmaller:
-      range = std::make_pair(target_page, max_page);
+      selectivity = 1.0 / 3;
       break;
     default:
       break;
   }
 
-  if (range.first == range.second) {
-    page_list_.at(range.first).AppendAllCells(tuples);
-  } else {
-    PageIndex iter = range.first;
-    PageIndex iter_end = GetRightMostPointer(range.second);
+  // NULL literal never matches
+  if (sql::IsTypeCodeNull(clause.type_code)) {
+    selectivity = 0.0;
+  }
 
-    do {
-      page_list_.at(iter).AppendAllCells(tuples);
-      iter = GetRightMostPointer(iter);
-    } while (iter != iter_end);
+  return selectivity;
+}
+
+double TableManager::EstimateKeyFraction(const int64_t& lower_key,
+                                         const int64_t& upper_key) const {
+  if (!row_count_) {
+    return 0.0;
   }
+
+  int64_t min_key(GetMinKey());
+  int64_t lower(std::max(lower_key, min_key));
+  int64_t upper(std::min(upper_key, static_cast<int64_t>(max_key_)));
+  if (lower > upper) {
+    return 0.0;
+  }
+
+  // a single key in a sparse range is still a row when present
+  return std::min(1.0, std::max(static_cast<double>(upper - lower + 1) /
+                                    (max_key_ - min_key + 1),
+                                1.0 / row_count_));
 }
 
-void TableManager::PullTuple(const sql::SelectFromCommand& command,
-                             std::vector<PageCell>& tuples) {
-  // with primary key condition
-  if (command.where && IsPrimaryKey(command.where->column_name)) {
-    PullTupleWithPrimary(command, tuples);
-  } else {
-    // iterate through leaf page
-    PageIndex iter(
-        SearchPage(root_page_, std::numeric_limits<PrimaryKey>::min()));
+void TableManager::ChooseAccessPath(ScanPlan& plan) const {
+  double height(GetTreeHeight());
+  double leaf_num(GetLeafNum());
+  double range_reads(0.0);
+
+  // a full scan descends the leftmost path and reads every leaf
+  plan.access_path = FullScanPath;
+  plan.page_reads = height - 1 + leaf_num;
 
-    do {
-      page_list_.at(iter).AppendAllCells(tuples);
-      iter = page_list_.at(iter).GetRightMostPagePointer();
-      // TODO: start page index from 1 or find a way to identify zero leaf page
-      // in the middle
-    } while (iter);
+  // answered without a scan
+  if (plan.from_row_count) {
+    plan.page_reads = 0.0;
+    return;
+  } else if (plan.from_key_edges) {
+    plan.page_reads = 2 * height;
+    return;
+  }
+
+  // a range descends to its first leaf and reads its share of the leaves,
+  // one that covers most keys is no cheaper and rules out a parallel scan
+  if (!plan.with_key_range) {
+    return;
+  }
+  if (plan.lower_key <= plan.upper_key) {
+    range_reads =
+        height - 1 +
+        std::max(1.0, std::ceil(leaf_num * EstimateKeyFraction(
+                                               plan.lower_key, plan.upper_key)));
+  }
+  if (range_reads < plan.page_reads) {
+    plan.access_path = KeyRangePath;
+    plan.page_reads = range_reads;
   }
 }
 
-const std::pair<int32_t, std::string> TableManager::FilterTuple(
-    const sql::SelectFromCommand& command, std::vector<PageCell>& tuples) {
-  bool select_star(false);
-  // gather type info
-  std::vector<std::ptrdiff_t> column_indexes;
-  std::vector<std::size_t> column_max_length;
+bool TableManager::IsParallelScan(const ScanPlan& plan) const {
+  // a limit on the scan itself is better served by stopping early; workers
+  // open the file again and would miss uncommitted pages
+  return (FullScanPath == plan.access_path && thread_pool_ &&
+          thread_pool_->GetThreadNum() > 1 && !IsLeaf(root_page_) &&
+          !(plan.with_limit && !plan.with_order && !plan.with_aggregate) &&
+          !table_file_->HasDirtyBlocks());
+}
 
-  // SELECT *
-  if (command.column_name.size() == 1 && command.column_name.front() == "*") {
-    select_star = true;
-    for (auto i = 0; i < table_schema_.column_list.size(); i++) {
-      column_indexes.push_back(i);
-      column_max_length.push_back(
-          table_schema_.column_list.at(i).column_name.size());
+PrimaryKey TableManager::GetMinKey(void) const {
+  PageIndex iter(root_page_);
+
+  // leftmost leaf, skipping leaves emptied by deletes
+  while (!IsLeaf(iter)) {
+    iter = GetCellLeftPointer(iter, 0);
+  }
+  while (!GetCellNum(iter) && GetRightMostPointer(iter)) {
+    iter = GetRightMostPointer(iter);
+  }
+  return GetCellNum(iter) ? page_list_.at(iter).GetCellKey(0) : max_key_;
+}
+
+bool TableManager::NarrowKeyRange(const sql::Condition& condition,
+                                  int64_t& lower_key,
+                                  int64_t& upper_key) const {
+  bool narrowed(false);
+
+  if (sql::AndCondition == condition.type) {
+    for (const auto& child : condition.children) {
+      narrowed = NarrowKeyRange(child, lower_key, upper_key) || narrowed;
     }
-  } else {
-    for (auto name : command.column_name) {
-      auto index(GetColumnIndex(name));
-      column_indexes.push_back(index);
-      column_max_length.push_back(name.size());
-    }
-  }
-
-  std::ptrdiff_t cond_var_type_index(0);
-  if (command.where) {
-    cond_var_type_index = GetColumnIndex(command.where->column_name);
-  }
-
-  // core loop
-  bool expr_res;
-  PageCell value;
-  sql::TypeCode type_code;
-  sql::Value lhs;
-  std::vector<std::vector<std::string>> out_str;
-  auto iter = tuples.begin();
-  while (iter != tuples.end()) {
-    // apply condition
-    if (command.where) {
-      value = GetValue(*iter, cond_var_type_index);
-      type_code = GetTypeCode(*iter, cond_var_type_index);
-      lhs = sql::BytesToValue(type_code, value);
-      expr_res = sql::CompareValue(lhs, command.where->value, type_code,
-                                   command.where->type_code,
-                                   command.where->condition_operator);
-
-      if (!expr_res) {
-        iter = tuples.erase(iter);
-        continue;
-      }
+    return narrowed;
+  }
+
+  const sql::WhereClause& clause(condition.clause);
+  if (sql::LeafCondition != condition.type ||
+      !IsPrimaryKey(clause.column_name) || sql::Int != clause.type_code) {
+    return false;
+  }
+
+  int64_t key(sql::ValueCast<int32_t>(clause.value));
+  narrowed = true;
+  switch (clause.condition_operator) {
+    case sql::Equal:
+      lower_key = std::max(lower_key, key);
+      upper_key = std::min(upper_key, key);
+      break;
+    case sql::Larger:
+      lower_key = std::max(lower_key, key + 1);
+      break;
+    case sql::NotSmaller:
+      lower_key = std::max(lower_key, key);
+      break;
+    case sql::Smaller:
+      upper_key = std::min(upper_key, key - 1);
+      break;
+    case sql::NotLarger:
+      upper_key = std::min(upper_key, key);
+      break;
+    default:
+      narrowed = false;
+      break;
+  }
+
+  return narrowed;
+}
+
+bool TableManager::ProjectTuple(const CellView& view, const ScanPlan& plan,
+                                sql::TypeValueList& tuple) {
+  // apply condition
+  if (plan.with_where && !plan.condition.Match(view)) {
+    return false;
+  }
+
+  // select columns, ones added after the row was written read as NULL
+  tuple.resize(plan.column_indexes.size());
+  for (auto i = 0; i < plan.column_indexes.size(); i++) {
+    if (plan.column_indexes[i] >= view.GetColumnNum()) {
+      tuple[i] = sql::TypeValue(sql::EightByteNull, sql::Value());
+      continue;
     }
+    tuple[i].first = view.GetTypeCode(plan.column_indexes[i]);
+    tuple[i].second = view.GetValue(plan.column_indexes[i]);
+  }
 
-    // select columns
-    std::vector<std::string> tuple_str;
-    if (select_star) {
-      std::vector<PageCell> values;
-      std::vector<sql::TypeCode> type_codes;
-      GetValues(*iter, column_indexes, values);
-      GetTypeCodes(*iter, column_indexes, type_codes);
-      for (auto i = 0; i < values.size(); i++) {
-        std::string value_str =
-            sql::BytesToString(type_codes.at(i), values.at(i));
-        tuple_str.push_back(value_str);
-        if (column_max_length.at(i) < value_str.size()) {
-          column_max_length.at(i) = value_str.size();
-        }
-      }
-    } else {
-      for (auto i = 0; i < column_indexes.size(); i++) {
-        value = GetValue(*iter, column_indexes.at(i));
-        type_code = GetTypeCode(*iter, column_indexes.at(i));
-        std::string value_str = sql::BytesToString(type_code, value);
-        tuple_str.push_back(value_str);
-        if (column_max_length.at(i) < value_str.size()) {
-          column_max_length.at(i) = value_str.size();
-        }
+  return true;
+}
+
+std::size_t TableManager::ProjectColumn(const std::ptrdiff_t& column_index,
+                                        ScanPlan& plan) {
+  auto res = std::find(plan.column_indexes.begin(), plan.column_indexes.end(),
+                       column_index);
+  if (res == plan.column_indexes.end()) {
+    res = plan.column_indexes.insert(res, column_index);
+  }
+  return std::distance(plan.column_indexes.begin(), res);
+}
+
+void TableManager::ScanLeaves(utils::FileUtil& file, const PageRange& range,
+                              const CellIndex& begin_slot,
+                              const CellIndex& end_slot, const ScanPlan& plan,
+                              const TupleConsumer& consumer) {
+  PageBuffer page;
+  CellView view(table_schema_);
+  sql::TypeValueList tuple;
+  PageIndex iter(range.first);
+  CellIndex begin(begin_slot);
+  CellIndex end(0);
+
+  // a leaf is read with one call and its cells decoded in place
+  do {
+    page.Read(file, iter);
+    end = (iter == range.second)
+              ? std::min(end_slot, static_cast<CellIndex>(page.GetCellNum()))
+              : page.GetCellNum();
+
+    for (auto i = begin; i < end; i++) {
+      view.Bind(page.GetCell(i), plan.column_limit);
+      if (ProjectTuple(view, plan, tuple) && !consumer(tuple)) {
+        return;
       }
     }
-    out_str.push_back(tuple_str);
 
-    // next line
-    iter++;
+    if (iter == range.second) {
+      break;
+    }
+    iter = page.GetRightMostPagePointer();
+    begin = 0;
+    // TODO: start page index from 1 or find a way to identify zero leaf page
+    // in the middle
+  } while (iter);
+}
+
+void TableManager::PullTupleWithPrimary(const ScanPlan& plan,
+                                        const TupleConsumer& consumer) {
+  // contradicting bounds
+  if (plan.lower_key > plan.upper_key) {
+    return;
   }
 
-  // final output
-  std::stringstream out_stream;
-  uint64_t result_row_num(out_str.size());
+  // both bounds fit in a key now
+  const PrimaryKey lower_key(plan.lower_key);
+  const PrimaryKey upper_key(plan.upper_key);
+  PageRange range(SearchPage(root_page_, lower_key),
+                  SearchPage(root_page_, upper_key));
+
+  // seek into the first leaf and stop right after the upper bound
+  CellIndex begin_slot(page_list_.at(range.first).SearchSlot(lower_key));
+  CellIndex end_slot(GetCellNum(range.second));
+  if (upper_key < std::numeric_limits<PrimaryKey>::max()) {
+    end_slot = page_list_.at(range.second).SearchSlot(upper_key + 1);
+  }
+
+  ScanLeaves(*table_file_, range, begin_slot, end_slot, plan, consumer);
+}
 
-  if (out_str.empty()) {
-    out_stream << "Empty set\n";
+void TableManager::PullTuple(const ScanPlan& plan,
+                             const TupleConsumer& consumer) {
+  // with primary key condition
+  if (KeyRangePath == plan.access_path) {
+    PullTupleWithPrimary(plan, consumer);
   } else {
-    // form delimited line
-    std::string delimit_line("+");
-    for (auto i = 0; i < column_max_length.size(); i++) {
-      delimit_line.append(column_max_length.at(i) + 2, '-');
-      delimit_line.append("+");
-    }
-    delimit_line.append("\n");
-
-    // print header
-    out_stream << delimit_line;
-    if (select_star) {
-      for (auto i = 0; i < column_max_length.size(); i++) {
-        out_stream << "| " << table_schema_.column_list.at(i).column_name;
-        out_stream << std::setw(
-                          column_max_length.at(i) -
-                          table_schema_.column_list.at(i).column_name.size() +
-                          1) << " ";
-      }
-    } else {
-      for (auto i = 0; i < column_max_length.size(); i++) {
-        out_stream << "| " << command.column_name.at(i);
-        out_stream << std::setw(column_max_length.at(i) -
-                                command.column_name.at(i).size() + 1) << " ";
+    if (IsParallelScan(plan)) {
+      ScanLeavesParallel(plan, consumer);
+      return;
+    }
+
+    // iterate through leaf page
+    PageRange range(
+        SearchPage(root_page_, std::numeric_limits<PrimaryKey>::min()),
+        SearchPage(root_page_, std::numeric_limits<PrimaryKey>::max()));
+    ScanLeaves(*table_file_, range, 0, GetCellNum(range.second), plan,
+                   consumer);
+  }
+}
+
+void TableManager::SplitLeafRanges(std::vector<PageRange>& ranges) {
+  std::vector<PageIndex> level(1, root_page_);
+
+  // the tree is balanced, the children of the lowest interior level are all
+  // the leaves in key order
+  while (!IsLeaf(level.front())) {
+    std::vector<PageIndex> children;
+    for (auto page : level) {
+      for (CellIndex i = 0; i < GetCellNum(page); i++) {
+        children.push_back(GetCellLeftPointer(page, i));
       }
+      children.push_back(GetRightMostPointer(page));
+    }
+    level.swap(children);
+  }
+
+  ranges.clear();
+  for (std::size_t i = 0; i < level.size(); i += parallel_range_leaf_num) {
+    ranges.emplace_back(
+        level.at(i),
+        level.at(std::min(i + parallel_range_leaf_num, level.size()) - 1));
+  }
+}
+
+utils::ThreadPool::Task TableManager::MakeRangeTask(
+    const PageRange& range, const ScanPlan& plan,
+    std::vector<std::unique_ptr<utils::FileUtil>>& files,
+    const TupleConsumer& consumer) {
+  return [this, range, &plan, &files, consumer](const std::size_t& worker) {
+    // workers read through their own file handles
+    if (!files.at(worker)) {
+      files.at(worker).reset(new utils::FileUtil(file_path_));
     }
-    out_stream << "|\n" << delimit_line;
+    ScanLeaves(*files.at(worker), range, 0,
+               std::numeric_limits<CellIndex>::max(), plan, consumer);
+  };
+}
 
-    // print body
-    for (auto tuple_str : out_str) {
-      // print each line
-      for (auto i = 0; i < column_max_length.size(); i++) {
-        out_stream << "| " << tuple_str.at(i);
-        out_stream << std::setw(column_max_length.at(i) -
-                                tuple_str.at(i).size() + 1) << " ";
+void TableManager::ScanLeavesParallel(const ScanPlan& plan,
+                                      const TupleConsumer& consumer) {
+  std::vector<PageRange> ranges;
+  std::size_t thread_num(thread_pool_->GetThreadNum());
+  std::size_t wave_size(thread_num * parallel_wave_task_num);
+  std::vector<std::unique_ptr<utils::FileUtil>> files(thread_num);
+  std::vector<std::vector<sql::TypeValueList>> results;
+  std::vector<utils::ThreadPool::Task> tasks;
+
+  SplitLeafRanges(ranges);
+
+  // ranges are disjoint and ascending, so passing on the rows of a wave in
+  // range order keeps primary key order
+  for (std::size_t first = 0; first < ranges.size(); first += wave_size) {
+    std::size_t last(std::min(first + wave_size, ranges.size()));
+
+    results.assign(last - first, std::vector<sql::TypeValueList>());
+    tasks.clear();
+    for (std::size_t i = first; i < last; i++) {
+      std::vector<sql::TypeValueList>& result(results.at(i - first));
+      tasks.push_back(MakeRangeTask(ranges.at(i), plan, files,
+                                    [&result](sql::TypeValueList& tuple) {
+                                      result.push_back(tuple);
+                                      return true;
+                                    }));
+    }
+    thread_pool_->Run(tasks);
+
+    for (auto& result : results) {
+      for (auto& tuple : result) {
+        if (!consumer(tuple)) {
+          return;
+        }
       }
-      out_stream << "|\n";
     }
+  }
+}
 
-    // print tail
-    out_stream << delimit_line;
-    out_stream << result_row_num << " rows in set\n";
+void TableManager::AggregateParallel(const ScanPlan& plan,
+                                     Aggregator& aggregator) {
+  std::vector<PageRange> ranges;
+  std::vector<std::unique_ptr<utils::FileUtil>> files(
+      thread_pool_->GetThreadNum());
+  std::vector<utils::ThreadPool::Task> tasks;
+
+  SplitLeafRanges(ranges);
+
+  // fixed ranges fold in a fixed order whatever the worker count
+  std::vector<Aggregator> partials(ranges.size(), Aggregator(plan.aggregates));
+  for (std::size_t i = 0; i < ranges.size(); i++) {
+    Aggregator& partial(partials.at(i));
+    tasks.push_back(MakeRangeTask(ranges.at(i), plan, files,
+                                  [&partial](sql::TypeValueList& tuple) {
+                                    partial.Add(tuple);
+                                    return true;
+                                  }));
   }
+  thread_pool_->Run(tasks);
 
-  return std::make_pair(result_row_num, out_stream.str());
+  for (const auto& partial : partials) {
+    aggregator.Merge(partial);
+  }
 }
 
-const std::vector<sql::TypeValueList> TableManager::InternalFilterTuple(
-    const sql::SelectFromCommand& command, std::vector<PageCell>& tuples) {
-  bool select_star(false);
-  // gather type info
-  std::vector<std::ptrdiff_t> column_indexes;
+void TableManager::PullOrderedTuple(const ScanPlan& plan,
+                                    const TupleSource& source,
+                                    const TupleConsumer& consumer) {
+  uint64_t skipped(0);
+  uint64_t passed(0);
 
-  // SELECT *
-  if (command.column_name.size() == 1 && command.column_name.front() == "*") {
-    select_star = true;
-    for (auto i = 0; i < table_schema_.column_list.size(); i++) {
-      column_indexes.push_back(i);
+  if (!plan.limit) {
+    return;
+  }
+
+  // OFFSET and LIMIT, the scan or the merge stops once the limit is reached
+  TupleConsumer limited = [&](sql::TypeValueList& tuple) {
+    if (skipped < plan.offset) {
+      ++skipped;
+      return true;
     }
-  } else {
-    for (auto name : command.column_name) {
-      auto index(GetColumnIndex(name));
-      column_indexes.push_back(index);
+    return consumer(tuple) && (++passed < plan.limit);
+  };
+  const TupleConsumer& sink(plan.with_limit ? limited : consumer);
+
+  if (!plan.with_order) {
+    source(sink);
+    return;
+  }
+
+  TupleSorter sorter(plan.order_position, plan.order_desc, memory_budget_);
+  if (plan.with_limit && plan.limit <= std::numeric_limits<uint64_t>::max() -
+                                           plan.offset) {
+    sorter.SetLimit(plan.offset + plan.limit);
+  }
+
+  source([&sorter](sql::TypeValueList& tuple) {
+    sorter.Add(tuple);
+    return true;
+  });
+
+  // drop the sort only columns
+  sorter.Finish([&](sql::TypeValueList& tuple) {
+    tuple.resize(tuple.size() - plan.hidden_column_num);
+    return sink(tuple);
+  });
+}
+
+bool TableManager::PullKeyEdges(const ScanPlan& plan,
+                                const TupleConsumer& consumer) {
+  CellView view(table_schema_);
+  sql::TypeValueList tuple;
+  PageCell cell;
+  PageIndex first(
+      SearchPage(root_page_, std::numeric_limits<PrimaryKey>::min()));
+  PageIndex last(
+      SearchPage(root_page_, std::numeric_limits<PrimaryKey>::max()));
+
+  // deletes may leave the rightmost leaf empty, a single empty leaf is an
+  // empty table
+  if (!GetCellNum(last)) {
+    return (first == last);
+  }
+
+  // skip emptied leaves on the left
+  while (!GetCellNum(first)) {
+    first = GetRightMostPointer(first);
+  }
+
+  // smallest and largest key
+  for (const auto& edge : {std::make_pair(first, CellIndex(0)),
+                           std::make_pair(last, GetCellNum(last) - 1)}) {
+    cell = page_list_.at(edge.first).GetCell(edge.second);
+    view.Bind(cell.data(), plan.column_limit);
+    ProjectTuple(view, plan, tuple);
+    consumer(tuple);
+  }
+
+  return true;
+}
+
+void TableManager::PullResultTuple(const ScanPlan& plan,
+                                   const TupleConsumer& consumer) {
+  if (plan.with_group) {
+    PullOrderedTuple(plan,
+                     [&](const TupleConsumer& sink) {
+                       PullGroupedTuple(plan, sink);
+                     },
+                     consumer);
+    return;
+  }
+
+  if (!plan.with_aggregate) {
+    PullOrderedTuple(plan,
+                     [&](const TupleConsumer& sink) { PullTuple(plan, sink); },
+                     consumer);
+    return;
+  }
+
+  Aggregator aggregator(plan.aggregates);
+  TupleConsumer fold = [&aggregator](sql::TypeValueList& tuple) {
+    aggregator.Add(tuple);
+    return true;
+  };
+
+  if (plan.from_row_count) {
+    aggregator.AddRows(row_count_);
+  } else if (!plan.from_key_edges || !PullKeyEdges(plan, fold)) {
+    if (IsParallelScan(plan)) {
+      AggregateParallel(plan, aggregator);
+    } else {
+      PullTuple(plan, fold);
     }
   }
 
-  std::ptrdiff_t cond_var_type_index(0);
-  if (command.where) {
-    cond_var_type_index = GetColumnIndex(command.where->column_name);
+  // a single row, still subject to OFFSET and LIMIT
+  sql::TypeValueList result;
+  aggregator.GetResult(result);
+  if (!plan.offset && plan.limit) {
+    consumer(result);
   }
+}
 
-  // core loop
-  bool expr_res;
-  PageCell value;
-  sql::TypeCode type_code;
-  sql::Value lhs;
-  std::vector<sql::TypeValueList> out_tuples;
-  auto iter = tuples.begin();
-  while (iter != tuples.end()) {
-    // apply condition
-    if (command.where) {
-      value = GetValue(*iter, cond_var_type_index);
-      type_code = GetTypeCode(*iter, cond_var_type_index);
-      lhs = sql::BytesToValue(type_code, value);
-      expr_res = sql::CompareValue(lhs, command.where->value, type_code,
-                                   command.where->type_code,
-                                   command.where->condition_operator);
-
-      if (!expr_res) {
-        iter = tuples.erase(iter);
-        continue;
+bool TableManager::LookupTuple(const ScanPlan& plan, const PrimaryKey& key,
+                               sql::TypeValueList& tuple) {
+  CellView view(table_schema_);
+  PageCell cell;
+  PageIndex target_page(SearchPage(root_page_, key));
+
+  if (!page_list_.at(target_page).FindCell(key, cell)) {
+    return false;
+  }
+
+  view.Bind(cell.data(), plan.column_limit);
+  return ProjectTuple(view, plan, tuple);
+}
+
+double TableManager::EstimateRowNum(const ScanPlan& plan) const {
+  double row_num(row_count_);
+
+  if (plan.with_where) {
+    row_num *= plan.condition.GetSelectivity();
+  }
+  return row_num;
+}
+
+std::size_t TableManager::GetTreeHeight(void) const {
+  std::size_t height(1);
+
+  // every leaf sits at the same depth, follow the leftmost children
+  for (PageIndex iter = root_page_; !IsLeaf(iter);
+       iter = GetCellLeftPointer(iter, 0)) {
+    ++height;
+  }
+  return height;
+}
+
+std::size_t TableManager::GetLeafNum(void) const {
+  std::vector<PageIndex> level(1, root_page_);
+  std::size_t leaf_num(1);
+
+  // the tree is balanced, count the children of the lowest interior level
+  while (!IsLeaf(level.front())) {
+    std::vector<PageIndex> children;
+    leaf_num = 0;
+    for (auto page : level) {
+      for (auto i = 0; i < GetCellNum(page); i++) {
+        children.push_back(GetCellLeftPointer(page, i));
       }
+      children.push_back(GetRightMostPointer(page));
+      leaf_num += GetCellNum(page) + 1;
     }
+    level.swap(children);
+  }
+  return leaf_num;
+}
 
-    // select columns
-    sql::TypeValueList tuple;
-    if (select_star) {
-      // get all values one time (much faster)
-      std::vector<PageCell> values;
-      std::vector<sql::TypeCode> type_codes;
-      GetValues(*iter, column_indexes, values);
-      GetTypeCodes(*iter, column_indexes, type_codes);
+const std::string TableManager::ExplainScan(const std::string& table_name,
+                                            const ScanPlan& plan) const {
+  std::stringstream out_stream;
 
-      for (auto i = 0; i < values.size(); i++) {
-        tuple.push_back(
-            std::make_pair(type_codes.at(i),
-                           sql::BytesToValue(type_codes.at(i), values.at(i))));
-      }
-    } else {
-      for (auto i = 0; i < column_indexes.size(); i++) {
-        value = GetValue(*iter, column_indexes.at(i));
-        type_code = GetTypeCode(*iter, column_indexes.at(i));
-        tuple.push_back(
-            std::make_pair(type_code, sql::BytesToValue(type_code, value)));
-      }
+  out_stream << table_name << ": ";
+  if (plan.from_row_count) {
+    out_stream << "row count";
+  } else if (plan.from_key_edges) {
+    out_stream << "first and last key";
+  } else if (KeyRangePath == plan.access_path) {
+    out_stream << "primary key range scan [" << plan.lower_key << ", "
+               << plan.upper_key << "]";
+  } else if (IsParallelScan(plan)) {
+    out_stream << "parallel full scan over " << thread_pool_->GetThreadNum()
+               << " workers";
+  } else {
+    out_stream << "full scan";
+  }
+  out_stream << ", " << std::llround(plan.page_reads) << " page reads, "
+             << std::llround(EstimateRowNum(plan)) << " rows\n";
+
+  return out_stream.str();
+}
+
+void TableManager::PullGroupedTuple(const ScanPlan& plan,
+                                    const TupleConsumer& consumer) {
+  sql::TypeValueList row;
+
+  // group columns then aggregates, rearranged into the SELECT list
+  TupleConsumer arrange = [&](sql::TypeValueList& group) {
+    row.resize(plan.result_columns.size());
+    for (auto i = 0; i < plan.result_columns.size(); i++) {
+      row.at(i) = group.at(plan.result_columns.at(i));
     }
-    out_tuples.push_back(tuple);
+    return consumer(row);
+  };
+
+  if (plan.group_streaming) {
+    StreamGroupAggregator aggregator(plan.group_positions, plan.aggregates);
+    bool more(true);
+    PullTuple(plan, [&](sql::TypeValueList& tuple) {
+      more = aggregator.Add(tuple, arrange);
+      return more;
+    });
+    if (more) {
+      aggregator.Finish(arrange);
+    }
+    return;
+  }
+
+  GroupAggregator aggregator(plan.group_positions, plan.aggregates,
+                             memory_budget_);
+  PullTuple(plan, [&aggregator](sql::TypeValueList& tuple) {
+    aggregator.Add(tuple);
+    return true;
+  });
+  aggregator.Finish(arrange);
+}
 
-    // next line
-    iter++;
+uint64_t TableManager::FilterTuple(const sql::SelectFromCommand& command,
+                                   const TupleSource& source,
+                                   ResultWriter& writer) {
+  std::vector<std::string> column_names;
+
+  // SELECT *
+  if (command.column_name.size() == 1 && command.column_name.front() == "*") {
+    for (const auto& column : table_schema_.column_list) {
+      column_names.push_back(column.column_name);
+    }
+  } else {
+    column_names = command.column_name;
   }
 
+  // rows go out as the scan produces them
+  writer.Begin(column_names);
+  source([&writer](sql::TypeValueList& tuple) { return writer.Write(tuple); });
+  writer.Finish();
+
+  return writer.GetRowNum();
+}
+
+const std::vector<sql::TypeValueList> TableManager::InternalFilterTuple(
+    const sql::SelectFromCommand& command, const ScanPlan& plan) {
+  std::vector<sql::TypeValueList> out_tuples;
+
+  PullResultTuple(plan, [&](sql::TypeValueList& tuple) {
+    out_tuples.push_back(tuple);
+    return true;
+  });
+
   return out_tuples;
 }
 
@@ -842,7 +1662,7 @@ const std::string TableManager::UpdateSet(
   PageCell target_cell;
 
   // pinpoint cell
-  int32_t condition_value = sql::expr::any_cast<int32_t>(command.where.value);
+  int32_t condition_value = sql::ValueCast<int32_t>(command.where.value);
   PageIndex target_page(SearchPage(root_page_, condition_value));
   result = page_list_.at(target_page).FindCell(condition_value, target_cell);
 
@@ -878,15 +1698,116 @@ done:
 
 void TableManager::DeleteFrom(const sql::DeleteFromCommand& command) {
   // pinpoint cell
-  int32_t condition_value = sql::expr::any_cast<int32_t>(command.where.value);
+  int32_t condition_value = sql::ValueCast<int32_t>(command.where.value);
   PageIndex target_page(SearchPage(root_page_, condition_value));
   CellIndex target_cell =
       page_list_.at(target_page).GetCellIndex(condition_value);
 
+  if (target_cell >= GetCellNum(target_page)) {
+    return;
+  }
+
   // delete it
   page_list_.at(target_page).DeleteCell(target_cell);
   page_list_.at(target_page).UpdateInfo();
   page_list_.at(target_page).Reorder();
+
+  --row_count_;
+  if (condition_value == max_key_) {
+    FindMaxKey();
+  }
+}
+
+void TableManager::CountRows(void) {
+  PageIndex iter(
+      SearchPage(root_page_, std::numeric_limits<PrimaryKey>::min()));
+
+  row_count_ = 0;
+  do {
+    row_count_ += GetCellNum(iter);
+    iter = GetRightMostPointer(iter);
+  } while (iter);
+
+  FindMaxKey();
+}
+
+void TableManager::Analyze(const std::size_t& sample_page_num,
+                           TableStatistics& statistics) {
+  CellView view(table_schema_);
+  std::vector<PageIndex> leaves;
+  std::vector<ColumnSampler> samplers;
+  std::vector<PageCell> cells;
+  PageIndex iter(
+      SearchPage(root_page_, std::numeric_limits<PrimaryKey>::min()));
+
+  do {
+    leaves.push_back(iter);
+    iter = GetRightMostPointer(iter);
+  } while (iter);
+
+  for (const auto& column : table_schema_.column_list) {
+    samplers.emplace_back(column);
+  }
+
+  // one leaf from each run of step leaves, picked at random so that rows
+  // laid out in a cycle do not alias with the step. A fixed seed keeps
+  // ANALYZE repeatable.
+  std::size_t step((leaves.size() + sample_page_num - 1) / sample_page_num);
+  std::minstd_rand random_engine;
+  statistics.sampled_page_num = 0;
+  for (std::size_t begin = 0; begin < leaves.size(); begin += step) {
+    std::size_t i(begin + random_engine() % std::min(step, leaves.size() -
+                                                               begin));
+    cells.clear();
+    page_list_.at(leaves.at(i)).AppendCells(0, GetCellNum(leaves.at(i)),
+                                            cells);
+    for (const auto& cell : cells) {
+      view.Bind(cell.data());
+      for (std::size_t j = 0; j < samplers.size(); j++) {
+        // columns added after the row was written read as NULL
+        if (j >= view.GetColumnNum()) {
+          samplers.at(j).Add(sql::EightByteNull, sql::Value());
+          continue;
+        }
+        samplers.at(j).Add(view.GetTypeCode(j), view.GetValue(j));
+      }
+    }
+    ++statistics.sampled_page_num;
+  }
+
+  statistics.row_count = row_count_;
+  statistics.page_num = page_list_.size();
+  statistics.columns.resize(samplers.size());
+  for (std::size_t j = 0; j < samplers.size(); j++) {
+    samplers.at(j).Finish(row_count_, statistics.columns.at(j));
+  }
+
+  statistics_ = statistics;
+}
+
+void TableManager::FindMaxKey(void) {
+  PageIndex last(
+      SearchPage(root_page_, std::numeric_limits<PrimaryKey>::max()));
+  PageIndex iter(
+      SearchPage(root_page_, std::numeric_limits<PrimaryKey>::min()));
+
+  max_key_ = 0;
+  if (!row_count_) {
+    return;
+  }
+
+  if (GetCellNum(last)) {
+    max_key_ = GetCellKey(last, GetCellNum(last) - 1);
+    return;
+  }
+
+  // deletes emptied the rightmost leaf, take the last non-empty one
+  do {
+    if (GetCellNum(iter)) {
+      max_key_ = GetCellKey(iter, GetCellNum(iter) - 1);
+    }
+    iter = GetRightMostPointer(iter);
+  } while (iter);
 }
 
 std::ptrdiff_t TableManager::GetColumnIndex(const std::string& column_name) {
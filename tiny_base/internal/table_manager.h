@@ -2,11 +2,23 @@
 #define TINY_BASE_TABLE_MANAGER_H_
 
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
+#include "aggregator.h"
+#include "cell.h"
+#include "commit_journal.h"
+#include "csv_loader.h"
 #include "file_util.h"
+#include "group_aggregator.h"
 #include "page_manager.h"
+#include "predicate.h"
+#include "result_writer.h"
 #include "sql_command.h"
+#include "table_statistics.h"
+#include "thread_pool.h"
+#include "tuple_sorter.h"
 
 namespace internal {
 
@@ -14,6 +26,71 @@ using PrimaryKey = CellKey;
 using CellPivot = std::pair<CellIndex, CellKey>;
 using TableSchema = sql::CreateTableCommand;
 
+// leaves one task of a parallel scan reads
+constexpr std::size_t parallel_range_leaf_num = 32;
+// tasks per worker whose rows are passed on before the next ones start,
+// which bounds the rows a parallel scan holds
+constexpr std::size_t parallel_wave_task_num = 2;
+
+// feeds tuples to a consumer until it says stop
+using TupleSource = std::function<void(const TupleConsumer&)>;
+
+enum AccessPath { FullScanPath, KeyRangePath };
+
+// what COPY FROM did, rows are counted without the header
+struct CopyReport {
+  uint64_t row_num;
+  uint64_t duplicate_num;
+  // the bad row stops the copy, the rows before it stay
+  bool failed;
+  uint64_t error_row;
+  std::string error;
+};
+
+// what a SELECT needs from each cell, resolved once before the scan
+struct ScanPlan {
+  // SELECT list
+  std::vector<std::ptrdiff_t> column_indexes;
+  // WHERE expression
+  bool with_where;
+  CompiledCondition condition;
+  // inclusive primary key bounds implied by the WHERE conjuncts
+  bool with_key_range;
+  int64_t lower_key;
+  int64_t upper_key;
+  // the cheaper of a walk over all leaves and a seek to the key range, by
+  // estimated page reads
+  AccessPath access_path;
+  double page_reads;
+  // columns after this limit are never located nor decoded
+  std::size_t column_limit;
+  // ORDER BY position in the projected tuple, trailing hidden columns are
+  // projected for sorting only
+  bool with_order;
+  std::size_t order_position;
+  bool order_desc;
+  std::size_t hidden_column_num;
+  // rows skipped, then rows passed on before the scan stops
+  bool with_limit;
+  uint64_t offset;
+  uint64_t limit;
+  // aggregate query, all matching rows fold into one output row
+  bool with_aggregate;
+  std::vector<AggregateSpec> aggregates;
+  // only MIN and MAX of the primary key, the edge leaves hold the answer
+  bool from_key_edges;
+  // only COUNT(*), the row count answers it
+  bool from_row_count;
+  // GROUP BY columns in the projected tuple. A group comes out as its group
+  // columns then its aggregates, result_columns picks the SELECT list from
+  // that. With the primary key among them every row is a group of its own in
+  // key order, so groups stream without a hash table.
+  bool with_group;
+  bool group_streaming;
+  std::vector<std::size_t> group_positions;
+  std::vector<std::size_t> result_columns;
+};
+
 class TableManager {
  public:
   /* Let class get ready */
@@ -23,6 +100,21 @@ class TableManager {
 
   bool Exists(void) { return fs::exists(file_path_); }
 
+  // writes stay in memory from here until they are committed or dropped; a
+  // dropped transaction leaves this object stale, the table must be loaded
+  // again
+  void BeginTransaction(void) { table_file_->Begin(); }
+
+  bool HasDirtyBlocks(void) const { return table_file_->HasDirtyBlocks(); }
+
+  void JournalTransaction(utils::CommitJournal& journal) const {
+    table_file_->JournalDirtyBlocks(journal);
+  }
+
+  void CommitTransaction(void) { table_file_->Commit(); }
+
+  void RollbackTransaction(void) { table_file_->Rollback(); }
+
   void Load(const TableSchema& schema, const int32_t& root_page,
             const int32_t& fanout);
 
@@ -30,8 +122,25 @@ class TableManager {
 
   void InsertInto(const sql::InsertIntoCommand& command);
 
-  const std::pair<int32_t, std::string> SelectFrom(
-      const sql::SelectFromCommand& command);
+  // rows of one statement in primary key order, a run of keys falling into
+  // the same leaf searches the tree once
+  void InsertBatch(const sql::InsertIntoCommandList& commands);
+
+  // CSV rows are parsed in parallel chunks straight into cells, then taken in
+  // batches of about half the memory budget sorted by primary key. Into an
+  // empty table rows ascending across batches are packed into leaves and the
+  // interior levels built on top at the end; rows out of that order are
+  // inserted into the tree.
+  bool CopyFrom(const fs::path& file_path, const CsvFormat& format,
+                CopyReport& report);
+
+  // rows go to the writer, returns their number
+  uint64_t SelectFrom(const sql::SelectFromCommand& command,
+                      ResultWriter& writer);
+
+  // whole rows matching the WHERE of the command in key order for COPY TO,
+  // read a leaf at a time without the parallel scan that holds its results
+  uint64_t CopyTo(const sql::SelectFromCommand& command, ResultWriter& writer);
 
   const std::vector<sql::TypeValueList> InternalSelectFrom(
       const sql::SelectFromCommand& command);
@@ -47,10 +156,79 @@ class TableManager {
 
   sql::CreateTableColumn GetColumnInfo(const std::size_t& column_index);
 
+  std::size_t GetColumnNum(void) const {
+    return table_schema_.column_list.size();
+  }
+
   const int32_t GetRootPage(void) const { return root_page_; }
 
   const int32_t GetFanout(void) const { return fanout_; }
 
+  // rows and largest primary key, kept current by insert and delete
+  int64_t GetRowCount(void) const { return row_count_; }
+
+  PrimaryKey GetMaxKey(void) const { return max_key_; }
+
+  void SetRowStats(const int64_t& row_count, const PrimaryKey& max_key) {
+    row_count_ = row_count;
+    max_key_ = max_key;
+  }
+
+  // rebuilds the row stats from the page headers
+  void CountRows(void);
+
+  // ANALYZE, the counts are exact and the column statistics come from up to
+  // sample_page_num leaves
+  void Analyze(const std::size_t& sample_page_num,
+               TableStatistics& statistics);
+
+  const TableStatistics& GetStatistics(void) const { return statistics_; }
+
+  void SetStatistics(const TableStatistics& statistics) {
+    statistics_ = statistics;
+  }
+
+  // full table scans are split across the pool when it has several workers
+  void SetThreadPool(const utils::ThreadPoolHandle& thread_pool) {
+    thread_pool_ = thread_pool;
+  }
+
+  // memory a sort may hold before it spills runs to disk
+  void SetMemoryBudget(const std::size_t& memory_budget) {
+    memory_budget_ = memory_budget;
+  }
+
+  // pieces a join is assembled from
+  ScanPlan PlanScan(const sql::SelectFromCommand& command);
+
+  void PullResultTuple(const ScanPlan& plan, const TupleConsumer& consumer);
+
+  void PullOrderedTuple(const ScanPlan& plan, const TupleSource& source,
+                        const TupleConsumer& consumer);
+
+  // the row with the primary key, if it exists and passes the WHERE
+  bool LookupTuple(const ScanPlan& plan, const PrimaryKey& key,
+                   sql::TypeValueList& tuple);
+
+  // rows the plan is expected to pass on
+  double EstimateRowNum(const ScanPlan& plan) const;
+
+  // levels from the root to the leaves
+  std::size_t GetTreeHeight(void) const;
+
+  std::size_t GetLeafNum(void) const;
+
+  // one EXPLAIN line: access path, page reads and rows of the plan
+  const std::string ExplainScan(const std::string& table_name,
+                                const ScanPlan& plan) const;
+
+  uint64_t FilterTuple(const sql::SelectFromCommand& command,
+                       const TupleSource& source, ResultWriter& writer);
+
+  bool IsPrimaryKey(const std::string& column_name) const {
+    return (column_name == table_schema_.column_list[0].column_name);
+  }
+
  private:
   // info for the table
   fs::path file_path_;
@@ -61,8 +239,17 @@ class TableManager {
   // B plus tree
   int32_t fanout_;
 
+  // row stats, max_key_ is meaningless while the table is empty
+  int64_t row_count_;
+  PrimaryKey max_key_;
+
+  // column statistics of the last ANALYZE, they guide selectivity
+  TableStatistics statistics_;
+
   // tool
   utils::FileHandle table_file_;
+  utils::ThreadPoolHandle thread_pool_;
+  std::size_t memory_budget_;
 
   // sql
   TableSchema table_schema_;
@@ -88,6 +275,30 @@ class TableManager {
   // for leaf pages
   PageCell PrepareLeafCell(const sql::InsertIntoCommand& command);
 
+  // into the leaf found for the key, false for a duplicate key
+  bool InsertRow(const PageCell& cell, const PrimaryKey& primary_key,
+                 const PageIndex& target_page);
+
+  // bottom up build of the tree of an empty table
+  struct BulkLoad {
+    // each leaf with its first key
+    std::vector<std::pair<PageIndex, CellKey>> leaves;
+    // cells of the last leaf, written when it is full
+    std::vector<char> bytes;
+    std::vector<CellBatch::Entry> entries;
+  };
+
+  void BulkAppend(BulkLoad& load, const CellSlice& cell);
+
+  void BulkFlushLeaf(BulkLoad& load);
+
+  // the interior levels, the top page becomes the root
+  void BulkFinish(BulkLoad& load);
+
+  // the leaf found for a smaller key also holds this one
+  bool IsInLeaf(const PageIndex& leaf_page,
+                const PrimaryKey& primary_key) const;
+
   // for interior pages
   PageCell PrepareInteriorCell(const int32_t& left_pointer, const int32_t& key);
 
@@ -104,6 +315,8 @@ class TableManager {
 
   void UpdateFanout(const PageIndex& page_index);
 
+  void FindMaxKey(void);
+
   bool WillOverflow(const PageIndex& page_index) const;
 
   bool IsRoot(const PageIndex& page_index) const {
@@ -165,21 +378,67 @@ class TableManager {
 
   void LoadParent(const PageIndex& page_index);
 
-  bool IsPrimaryKey(const std::string column_name) const {
-    return (column_name == table_schema_.column_list[0].column_name);
-  }
 
-  void PullTupleWithPrimary(const sql::SelectFromCommand& command,
-                            std::vector<PageCell>& tuples);
+  // NOT is pushed down to the leaves, so a NULL column fails the negated
+  // comparison too instead of matching as !false
+  CompiledCondition CompileCondition(const sql::Condition& condition,
+                                     const bool& negate);
+
+  double EstimateSelectivity(const sql::WhereClause& clause) const;
+
+  // share of the rows with a key in [lower_key, upper_key], keys taken as
+  // spread evenly between the smallest and the largest
+  double EstimateKeyFraction(const int64_t& lower_key,
+                             const int64_t& upper_key) const;
+
+  void ChooseAccessPath(ScanPlan& plan) const;
+
+  bool IsParallelScan(const ScanPlan& plan) const;
+
+  PrimaryKey GetMinKey(void) const;
+
+  bool NarrowKeyRange(const sql::Condition& condition, int64_t& lower_key,
+                      int64_t& upper_key) const;
+
+  // slot bounds apply to the first and the last leaf of the range, an end
+  // past the last cell stops at it
+  void ScanLeaves(utils::FileUtil& file, const PageRange& range,
+                  const CellIndex& begin_slot, const CellIndex& end_slot,
+                  const ScanPlan& plan, const TupleConsumer& consumer);
+
+  // rows reach the consumer in key order, a wave of ranges at a time
+  void ScanLeavesParallel(const ScanPlan& plan, const TupleConsumer& consumer);
+
+  // one partial aggregator per range, merged in range order
+  void AggregateParallel(const ScanPlan& plan, Aggregator& aggregator);
+
+  // runs of parallel_range_leaf_num leaves in key order
+  void SplitLeafRanges(std::vector<PageRange>& ranges);
+
+  // task of a parallel scan over the range, with the worker's own file
+  utils::ThreadPool::Task MakeRangeTask(
+      const PageRange& range, const ScanPlan& plan,
+      std::vector<std::unique_ptr<utils::FileUtil>>& files,
+      const TupleConsumer& consumer);
+
+  static bool ProjectTuple(const CellView& view, const ScanPlan& plan,
+                           sql::TypeValueList& tuple);
+
+  // position of the column in the projected tuple, added if missing
+  static std::size_t ProjectColumn(const std::ptrdiff_t& column_index,
+                                   ScanPlan& plan);
+
+  void PullTupleWithPrimary(const ScanPlan& plan,
+                            const TupleConsumer& consumer);
+
+  void PullTuple(const ScanPlan& plan, const TupleConsumer& consumer);
 
-  void PullTuple(const sql::SelectFromCommand& command,
-                 std::vector<PageCell>& tuples);
+  void PullGroupedTuple(const ScanPlan& plan, const TupleConsumer& consumer);
 
-  const std::pair<int32_t, std::string> FilterTuple(
-      const sql::SelectFromCommand& command, std::vector<PageCell>& tuples);
+  bool PullKeyEdges(const ScanPlan& plan, const TupleConsumer& consumer);
 
   const std::vector<sql::TypeValueList> InternalFilterTuple(
-      const sql::SelectFromCommand& command, std::vector<PageCell>& tuples);
+      const sql::SelectFromCommand& command, const ScanPlan& plan);
 
   std::ptrdiff_t GetColumnIndex(const std::string& column_name);
 };
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "table_statistics.h"
+
+namespace internal {
+
+HyperLogLog::HyperLogLog(const std::size_t& precision)
+    : precision_(precision), registers_(std::size_t(1) << precision, 0) {}
+
+void HyperLogLog::Add(const uint64_t& hash) {
+  std::size_t index(hash >> (64 - precision_));
+  uint64_t rest(hash << precision_);
+  uint8_t rank(1);
+
+  // leading zeros of the bits left after the register index, plus one
+  while (rank <= 64 - precision_ && !(rest & (uint64_t(1) << 63))) {
+    rest <<= 1;
+    ++rank;
+  }
+  registers_.at(index) = std::max(registers_.at(index), rank);
+}
+
+double HyperLogLog::Estimate(void) const {
+  double m(registers_.size());
+  double sum(0.0);
+  std::size_t zero_num(0);
+
+  for (auto rank : registers_) {
+    sum += std::ldexp(1.0, -rank);
+    zero_num += !rank;
+  }
+
+  double estimate((0.7213 / (1.0 + 1.079 / m)) * m * m / sum);
+
+  // few values leave registers empty, count those instead
+  if (estimate <= 2.5 * m && zero_num) {
+    estimate = m * std::log(m / zero_num);
+  }
+  return estimate;
+}
+
+ColumnSampler::ColumnSampler(const sql::CreateTableColumn& column_info)
+    : column_info_(column_info), row_num_(0), null_num_(0) {}
+
+void ColumnSampler::Add(const sql::TypeCode& type_code,
+                        const sql::Value& value) {
+  ++row_num_;
+  if (sql::IsTypeCodeNull(type_code)) {
+    ++null_num_;
+    return;
+  }
+
+  uint64_t hash(sql::MixHash(sql::HashValue(value, type_code)));
+  sketch_.Add(hash);
+  ++hash_counts_[hash];
+
+  if (row_num_ - null_num_ == 1 ||
+      sql::CompareOrder(value, min_value_.second, type_code,
+                        min_value_.first) < 0) {
+    min_value_ = sql::TypeValue(type_code, value);
+  }
+  if (row_num_ - null_num_ == 1 ||
+      sql::CompareOrder(value, max_value_.second, type_code,
+                        max_value_.first) > 0) {
+    max_value_ = sql::TypeValue(type_code, value);
+  }
+
+  if (sql::Text != column_info_.type) {
+    values_.push_back(sql::ValueToDouble(value, type_code));
+  }
+}
+
+void ColumnSampler::Finish(const int64_t& row_num,
+                           ColumnStatistics& statistics) {
+  std::size_t value_num(row_num_ - null_num_);
+  double distinct_num(std::min(sketch_.Estimate(),
+                               static_cast<double>(value_num)));
+
+  statistics.column_name = column_info_.column_name;
+  statistics.null_fraction =
+      row_num_ ? static_cast<double>(null_num_) / row_num_ : 0.0;
+
+  // Duj1 (Haas and Stokes): the values sampled once stand for the ones not
+  // sampled at all, a value sampled again is likely seen already
+  double table_value_num((1.0 - statistics.null_fraction) * row_num);
+  if (value_num && table_value_num > value_num) {
+    double once_num(std::count_if(
+        hash_counts_.begin(), hash_counts_.end(),
+        [](const std::pair<const uint64_t, std::size_t>& hash_count) {
+          return hash_count.second == 1;
+        }));
+    distinct_num = value_num * distinct_num /
+                   (value_num - once_num + once_num * value_num /
+                                               table_value_num);
+    distinct_num = std::min(distinct_num, table_value_num);
+  }
+  statistics.distinct_num = std::round(distinct_num);
+
+  statistics.with_range = (value_num > 0);
+  statistics.min_value.clear();
+  statistics.max_value.clear();
+  if (statistics.with_range) {
+    statistics.min_value =
+        sql::ValueToString(min_value_.first, min_value_.second)
+            .substr(0, max_statistics_text_size);
+    statistics.max_value =
+        sql::ValueToString(max_value_.first, max_value_.second)
+            .substr(0, max_statistics_text_size);
+  }
+
+  // equi-depth: bounds at evenly spaced ranks of the sorted sample
+  statistics.histogram.clear();
+  if (values_.empty()) {
+    return;
+  }
+  std::sort(values_.begin(), values_.end());
+  for (std::size_t i = 0; i <= histogram_bucket_num; i++) {
+    std::size_t rank(i * (values_.size() - 1) / histogram_bucket_num);
+    statistics.histogram.push_back(values_.at(rank));
+  }
+}
+
+namespace {
+
+// share of the non-NULL values below the number, by the histogram
+double EstimateFractionBelow(const std::vector<double>& histogram,
+                             const double& number) {
+  std::size_t bucket_num(histogram.size() - 1);
+
+  if (number <= histogram.front()) {
+    return 0.0;
+  } else if (number > histogram.back()) {
+    return 1.0;
+  }
+
+  // the value spreads evenly within its bucket
+  auto res = std::lower_bound(histogram.begin(), histogram.end(), number);
+  std::size_t bucket(std::distance(histogram.begin(), res) - 1);
+  double width(histogram.at(bucket + 1) - histogram.at(bucket));
+  double inside(width > 0 ? (number - histogram.at(bucket)) / width : 1.0);
+
+  return (bucket + inside) / bucket_num;
+}
+
+}  // namespace
+
+double EstimateSelectivity(const ColumnStatistics& statistics,
+                           const sql::WhereClause& clause) {
+  double value_fraction(1.0 - statistics.null_fraction);
+  double below(0.0);
+
+  if (!statistics.with_range || statistics.distinct_num < 1) {
+    return 0.0;
+  }
+
+  switch (clause.condition_operator) {
+    case sql::Equal:
+      return value_fraction / statistics.distinct_num;
+    case sql::Unequal:
+      return value_fraction * (1.0 - 1.0 / statistics.distinct_num);
+    default:
+      break;
+  }
+
+  // ranges need a histogram and a number to place in it
+  if (statistics.histogram.size() < 2 || clause.type_code >= sql::Text) {
+    return -1.0;
+  }
+  below = EstimateFractionBelow(
+      statistics.histogram, sql::ValueToDouble(clause.value, clause.type_code));
+
+  switch (clause.condition_operator) {
+    case sql::Smaller:
+    case sql::NotLarger:
+      return value_fraction * below;
+    case sql::Larger:
+    case sql::NotSmaller:
+      return value_fraction * (1.0 - below);
+    default:
+      break;
+  }
+  return -1.0;
+}
+
+const std::string HistogramToString(const std::vector<double>& histogram) {
+  std::ostringstream out_stream;
+
+  out_stream.precision(10);
+  for (std::size_t i = 0; i < histogram.size(); i++) {
+    out_stream << (i ? "," : "") << histogram.at(i);
+  }
+  return out_stream.str();
+}
+
+const std::vector<double> StringToHistogram(const std::string& histogram_str) {
+  std::vector<double> histogram;
+  std::istringstream in_stream(histogram_str);
+  std::string bound;
+
+  while (std::getline(in_stream, bound, ',')) {
+    histogram.push_back(std::stod(bound));
+  }
+  return histogram;
+}
+
+}  // namespace internal
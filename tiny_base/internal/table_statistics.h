@@ -0,0 +1,90 @@
+#ifndef TINY_BASE_TABLE_STATISTICS_H_
+#define TINY_BASE_TABLE_STATISTICS_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "sql_command.h"
+
+namespace internal {
+
+// leaves ANALYZE reads at most, spread evenly over the leaf chain
+constexpr std::size_t default_sample_page_num = 64;
+// equi-depth buckets of a histogram
+constexpr std::size_t histogram_bucket_num = 8;
+// longest text kept as a minimum or maximum, the catalog cell must fit a page
+constexpr std::size_t max_statistics_text_size = 64;
+
+// Distinct count sketch: each value sets the register its hash picks to the
+// longest run of leading zeros seen there. 2^precision one byte registers
+// give a standard error of about 1.04 / sqrt(2^precision).
+class HyperLogLog {
+ public:
+  explicit HyperLogLog(const std::size_t& precision = 12);
+
+  void Add(const uint64_t& hash);
+
+  double Estimate(void) const;
+
+ private:
+  std::size_t precision_;
+  std::vector<uint8_t> registers_;
+};
+
+struct ColumnStatistics {
+  std::string column_name;
+  double distinct_num;
+  double null_fraction;
+  // smallest and largest sampled value as text, empty when all were NULL
+  bool with_range;
+  std::string min_value;
+  std::string max_value;
+  // bucket bounds of numeric and date columns, every bucket holds about the
+  // same share of the non-NULL rows
+  std::vector<double> histogram;
+};
+
+struct TableStatistics {
+  int64_t row_count;
+  std::size_t page_num;
+  std::size_t sampled_page_num;
+  // in schema order, empty before ANALYZE
+  std::vector<ColumnStatistics> columns;
+};
+
+// Folds the sampled values of one column into its statistics
+class ColumnSampler {
+ public:
+  explicit ColumnSampler(const sql::CreateTableColumn& column_info);
+
+  void Add(const sql::TypeCode& type_code, const sql::Value& value);
+
+  // row_num is the whole table, the sample holds a share of it
+  void Finish(const int64_t& row_num, ColumnStatistics& statistics);
+
+ private:
+  sql::CreateTableColumn column_info_;
+  HyperLogLog sketch_;
+  // times each value hash was sampled, the sample is a few pages at most
+  std::unordered_map<uint64_t, std::size_t> hash_counts_;
+  std::size_t row_num_;
+  std::size_t null_num_;
+  sql::TypeValue min_value_;
+  sql::TypeValue max_value_;
+  std::vector<double> values_;
+};
+
+// share of the rows matching the clause, negative when the statistics say
+// nothing about it
+double EstimateSelectivity(const ColumnStatistics& statistics,
+                           const sql::WhereClause& clause);
+
+// histogram bounds as text and back
+const std::string HistogramToString(const std::vector<double>& histogram);
+
+const std::vector<double> StringToHistogram(const std::string& histogram_str);
+
+}  // namespace internal
+
+#endif  // TINY_BASE_TABLE_STATISTICS_H_
@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <limits>
+#include <queue>
+
+#include "tuple_sorter.h"
+
+namespace internal {
+
+const std::size_t TupleSorter::merge_fan_in;
+
+std::size_t GetTupleSize(const sql::TypeValueList& tuple) {
+  std::size_t size(sizeof(tuple) + tuple.capacity() * sizeof(sql::TypeValue));
+
+  for (const auto& column : tuple) {
+    if (column.first > sql::Text) {
+      size += column.first - sql::Text;
+    }
+  }
+
+  return size;
+}
+
+TupleSorter::TupleSorter(const std::size_t& key_position,
+                         const bool& descending,
+                         const std::size_t& memory_budget)
+    : key_position_(key_position),
+      descending_(descending),
+      memory_budget_(memory_budget),
+      memory_used_(0),
+      limit_(std::numeric_limits<std::size_t>::max()) {}
+
+void TupleSorter::Add(sql::TypeValueList& tuple) {
+  memory_used_ += GetTupleSize(tuple);
+  buffer_.push_back(std::move(tuple));
+
+  // top N: keeps at most twice the limit around
+  if (buffer_.size() / 2 >= limit_) {
+    TrimBuffer();
+  }
+
+  if (memory_used_ > memory_budget_) {
+    SpillBuffer();
+  }
+}
+
+void TupleSorter::Finish(const TupleConsumer& consumer) {
+  // everything fit in memory
+  if (runs_.empty()) {
+    SortBuffer();
+    for (auto& tuple : buffer_) {
+      if (!consumer(tuple)) {
+        break;
+      }
+    }
+    buffer_.clear();
+    memory_used_ = 0;
+    return;
+  }
+
+  if (!buffer_.empty()) {
+    SpillBuffer();
+  }
+
+  // merge the oldest runs first so equal keys keep their order
+  while (runs_.size() > merge_fan_in) {
+    std::vector<Run> group(
+        std::make_move_iterator(runs_.begin()),
+        std::make_move_iterator(runs_.begin() + merge_fan_in));
+    runs_.erase(runs_.begin(), runs_.begin() + merge_fan_in);
+
+    Run merged(new SpillFile);
+    MergeRuns(group, [&merged](sql::TypeValueList& tuple) {
+      merged->Write(tuple);
+      return true;
+    });
+    runs_.insert(runs_.begin(), std::move(merged));
+  }
+
+  MergeRuns(runs_, consumer);
+  runs_.clear();
+}
+
+bool TupleSorter::Less(const sql::TypeValueList& lhs,
+                       const sql::TypeValueList& rhs) const {
+  const sql::TypeValue& l_key(lhs.at(key_position_));
+  const sql::TypeValue& r_key(rhs.at(key_position_));
+  int order = sql::CompareOrder(l_key.second, r_key.second, l_key.first,
+                                r_key.first);
+  return descending_ ? (order > 0) : (order < 0);
+}
+
+void TupleSorter::SortBuffer(void) {
+  std::stable_sort(buffer_.begin(), buffer_.end(),
+                   [this](const sql::TypeValueList& lhs,
+                          const sql::TypeValueList& rhs) {
+                     return Less(lhs, rhs);
+                   });
+}
+
+void TupleSorter::TrimBuffer(void) {
+  SortBuffer();
+  buffer_.resize(limit_);
+
+  memory_used_ = 0;
+  for (const auto& tuple : buffer_) {
+    memory_used_ += GetTupleSize(tuple);
+  }
+}
+
+void TupleSorter::SpillBuffer(void) {
+  Run run(new SpillFile);
+
+  SortBuffer();
+  for (const auto& tuple : buffer_) {
+    run->Write(tuple);
+  }
+  runs_.push_back(std::move(run));
+
+  buffer_.clear();
+  memory_used_ = 0;
+}
+
+bool TupleSorter::MergeRuns(std::vector<Run>& runs,
+                            const TupleConsumer& consumer) const {
+  std::vector<sql::TypeValueList> heads(runs.size());
+
+  // pops the smallest head, the earlier run on ties
+  auto later = [this, &heads](const std::size_t& lhs, const std::size_t& rhs) {
+    if (Less(heads.at(rhs), heads.at(lhs))) {
+      return true;
+    }
+    return !Less(heads.at(lhs), heads.at(rhs)) && lhs > rhs;
+  };
+  std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(later)>
+      queue(later);
+
+  for (std::size_t i = 0; i < runs.size(); i++) {
+    runs.at(i)->Rewind();
+    if (runs.at(i)->Read(heads.at(i))) {
+      queue.push(i);
+    }
+  }
+
+  while (!queue.empty()) {
+    std::size_t run(queue.top());
+    queue.pop();
+
+    if (!consumer(heads.at(run))) {
+      return false;
+    }
+    if (runs.at(run)->Read(heads.at(run))) {
+      queue.push(run);
+    }
+  }
+
+  return true;
+}
+
+}  // namespace internal
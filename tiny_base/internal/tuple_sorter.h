@@ -0,0 +1,70 @@
+#ifndef TINY_BASE_TUPLE_SORTER_H_
+#define TINY_BASE_TUPLE_SORTER_H_
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include "spill_file.h"
+#include "sql_command.h"
+
+namespace internal {
+
+// memory a sort, an aggregation or a join may hold before spilling
+constexpr std::size_t default_memory_budget = (16 << 20);
+
+// receives the projected columns of each matching row, returns false to stop
+// the scan
+using TupleConsumer = std::function<bool(sql::TypeValueList&)>;
+
+// rough memory held by a decoded tuple
+std::size_t GetTupleSize(const sql::TypeValueList& tuple);
+
+// Sorts tuples on one column. Tuples are kept in memory while they fit in the
+// budget; past that, each full buffer is sorted and spilled as a run and the
+// runs are merged at the end. Equal keys keep their arrival order.
+class TupleSorter {
+ public:
+  TupleSorter(const std::size_t& key_position, const bool& descending,
+              const std::size_t& memory_budget);
+
+  // only the first row_num tuples in order are wanted, the rest may be
+  // dropped as soon as they are known to come later
+  void SetLimit(const std::size_t& row_num) { limit_ = row_num; }
+
+  // takes over the columns of the tuple
+  void Add(sql::TypeValueList& tuple);
+
+  // hands the tuples over in order, stops early when the consumer says so
+  void Finish(const TupleConsumer& consumer);
+
+  std::size_t GetRunNum(void) const { return runs_.size(); }
+
+ private:
+  using Run = std::unique_ptr<SpillFile>;
+
+  // runs merged at once, bounds open files and read buffers
+  static const std::size_t merge_fan_in = 64;
+
+  std::size_t key_position_;
+  bool descending_;
+  std::size_t memory_budget_;
+  std::size_t memory_used_;
+  std::size_t limit_;
+  std::vector<sql::TypeValueList> buffer_;
+  std::vector<Run> runs_;
+
+  bool Less(const sql::TypeValueList& lhs,
+            const sql::TypeValueList& rhs) const;
+
+  void SortBuffer(void);
+
+  void TrimBuffer(void);
+
+  void SpillBuffer(void);
+
+  bool MergeRuns(std::vector<Run>& runs, const TupleConsumer& consumer) const;
+};
+
+}  // namespace internal
+
+#endif  // TINY_BASE_TUPLE_SORTER_H_
@@ -1,13 +1,34 @@
+#include <cstring>
+#include <iostream>
+#include <string>
+
 #include "database_engine.h"
 
 int main(int argc, char* argv[]) {
   sql::DatabaseEngine engine;
+  internal::OutputMode mode(internal::TableMode);
+  std::string file_path;
 
-  if (argc == 2) {
-    engine.Run(argv[1]);
-  } else {
-    engine.Run("");
+  // tiny_base [--mode table|csv|tsv|jsonl|binary] [script.sql]
+  for (int i = 1; i < argc; i++) {
+    if (!std::strcmp(argv[i], "--mode")) {
+      if (i + 1 == argc || !internal::ParseOutputMode(argv[i + 1], mode)) {
+        std::cerr << "--mode takes table, csv, tsv, jsonl or binary"
+                  << std::endl;
+        return 1;
+      }
+      i++;
+    } else if (file_path.empty()) {
+      file_path = argv[i];
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [--mode MODE] [script.sql]"
+                << std::endl;
+      return 1;
+    }
   }
 
+  engine.SetOutputMode(mode);
+  engine.Run(file_path);
+
   return 0;
 }
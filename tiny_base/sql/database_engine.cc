@@ -1,23 +1,34 @@
+#include <strings.h>
+#include <sys/resource.h>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
-#include <regex>
+#include <limits>
+#include <sstream>
+#include <thread>
 
 #include "database_engine.h"
+#include "join_executor.h"
 
 namespace sql {
 
 #define FILE_PATH(NAME) "data/" + NAME + ".tbl"
 
 const std::string DatabaseEngine::hidden_file = "data/.table_info";
-const std::string DatabaseEngine::regex_for_name = "([-_\\w\\.]+)";
-const std::string DatabaseEngine::regex_for_value = "([-:_\\w\\.]+)";
-const std::string DatabaseEngine::regex_for_type = "(\\w+)";
+const std::string DatabaseEngine::journal_file = "data/.journal";
+const std::string DatabaseEngine::stale_stats_file = "data/.stale_stats";
 
 const CreateTableCommand DatabaseEngine::root_schema_tables = {
     "tinybase_tables",
     {{"row_id", Int, primary_key},
      {"table_name", Text, not_null},
      {"root_page", Int, not_null},
-     {"fanout", Int, not_null}}};
+     {"fanout", Int, not_null},
+     {"row_count", BigInt, not_null},
+     {"max_key", Int, not_null}}};
 
 const CreateTableCommand DatabaseEngine::root_schema_columns = {
     "tinybase_columns",
@@ -29,7 +40,43 @@ const CreateTableCommand DatabaseEngine::root_schema_columns = {
      {"is_nullable", Text, not_null},
      {"column_key", Text, could_null}}};
 
-DatabaseEngine::DatabaseEngine(void) {
+const CreateTableCommand DatabaseEngine::statistics_schema_tables = {
+    "tinybase_table_stats",
+    {{"row_id", Int, primary_key},
+     {"table_name", Text, not_null},
+     {"row_count", BigInt, not_null},
+     {"page_count", Int, not_null},
+     {"sampled_pages", Int, not_null}}};
+
+const CreateTableCommand DatabaseEngine::statistics_schema_columns = {
+    "tinybase_column_stats",
+    {{"row_id", Int, primary_key},
+     {"table_name", Text, not_null},
+     {"column_name", Text, not_null},
+     {"distinct_count", BigInt, not_null},
+     {"null_fraction", Double, not_null},
+     {"min_value", Text, could_null},
+     {"max_value", Text, could_null},
+     {"histogram", Text, could_null}}};
+
+const std::unordered_set<std::string> DatabaseEngine::keywords = {
+    "AND",    "ASC",   "BETWEEN", "BY",     "DESC",  "FROM",   "GROUP",
+    "INNER",  "INSERT", "INTO",   "JOIN",   "LIMIT", "NOT",    "OFFSET",
+    "ON",     "OR",    "ORDER",   "SELECT", "SET",   "TABLE",  "UPDATE",
+    "VALUES", "WHERE"};
+
+DatabaseEngine::DatabaseEngine(void)
+    : work_memory_(internal::default_memory_budget),
+      plan_cache_size_(default_plan_cache_size),
+      output_mode_(internal::TableMode),
+      in_transaction_(false),
+      stats_stale_(false) {
+  // a COMMIT cut short by a crash is finished before anything is read
+  utils::CommitJournal::Recover(journal_file);
+  LoadCatalog();
+}
+
+void DatabaseEngine::LoadCatalog(void) {
   internal::TableManager* tables_manager = nullptr;
   internal::TableManager* columns_manager = nullptr;
 
@@ -45,14 +92,26 @@ DatabaseEngine::DatabaseEngine(void) {
 
   // TODO: check both file exists or not exists (xor)
 
+  // row stats are not to be trusted after a crash
+  stats_stale_ = fs::exists(stale_stats_file);
+
   if (tables_manager->Exists()) {
     TableInfo info = LoadRootTableInfo(root_schema_tables.table_name);
-    tables_manager->Load(root_schema_tables, info.first, info.second);
+    info.with_row_stats = info.with_row_stats && !stats_stale_;
+    tables_manager->Load(root_schema_tables, info.root_page, info.fanout);
+    RestoreRowStats(info, *tables_manager);
   }
 
   if (columns_manager->Exists()) {
     TableInfo info = LoadRootTableInfo(root_schema_columns.table_name);
-    columns_manager->Load(root_schema_columns, info.first, info.second);
+    info.with_row_stats = info.with_row_stats && !stats_stale_;
+    columns_manager->Load(root_schema_columns, info.root_page, info.fanout);
+    RestoreRowStats(info, *columns_manager);
+  }
+
+  catalog_.clear();
+  if (tables_manager->Exists() && columns_manager->Exists()) {
+    LoadCatalogEntries();
   }
 
   if (!tables_manager->Exists() && !columns_manager->Exists()) {
@@ -60,6 +119,12 @@ DatabaseEngine::DatabaseEngine(void) {
     columns_manager->CreateTable(root_schema_columns);
     RegisterTable(root_schema_tables);
     RegisterTable(root_schema_columns);
+    // tinybase_columns has split already
+    SaveRootTableInfo();
+  }
+
+  if (stats_stale_) {
+    RecountRowStats();
   }
 }
 
@@ -69,7 +134,6 @@ void DatabaseEngine::Run(const std::string file_path) {
   std::string line;
   std::string user_input;
   std::string sql_command;
-  std::vector<std::string> res;
   std::ifstream sql_file;
 
   if (!file_path.empty()) {
@@ -89,6 +153,18 @@ void DatabaseEngine::Run(const std::string file_path) {
 
     while (std::getline(!file_mode ? std::cin : sql_file, line) &&
            !line.empty()) {
+      // shell commands take a line of their own, without a semicolon
+      if (IsBlank(user_input) && IsDotCommand(line)) {
+        if (file_mode && internal::TableMode == output_mode_) {
+          std::cout << "tinysql> " << line << std::endl;
+        }
+        ExecuteDotCommand(line);
+        if (!file_mode) {
+          std::cout << "tinysql> " << std::flush;
+        }
+        continue;
+      }
+
       if (!user_input.empty()) {
         user_input += " ";
       }
@@ -100,12 +176,16 @@ void DatabaseEngine::Run(const std::string file_path) {
       if (size != std::string::npos) {
         sql_command = user_input.substr(0, size);
         user_input.erase(0, size + 1);
-        if (!ExtractStr(user_input, "^\\s*$", res)) {
-          std::cout << std::endl;
-        }
 
-        if (file_mode) {
-          std::cout << "tinysql> " << sql_command << std::endl;
+        // other output formats carry the results only
+        if (internal::TableMode == output_mode_) {
+          if (!IsBlank(user_input)) {
+            std::cout << std::endl;
+          }
+
+          if (file_mode) {
+            std::cout << "tinysql> " << sql_command << std::endl;
+          }
         }
 
         try {
@@ -119,7 +199,7 @@ void DatabaseEngine::Run(const std::string file_path) {
         }
 
         if (!file_mode) {
-          if (ExtractStr(user_input, "^\\s*$", res)) {
+          if (IsBlank(user_input)) {
             std::cout << "tinysql> " << std::flush;
           } else {
             std::cout << "      -> " << std::flush;
@@ -132,319 +212,574 @@ void DatabaseEngine::Run(const std::string file_path) {
   if (file_mode) {
     sql_file.close();
   }
+
+  // also reached at the end of a script without EXIT, which drops an open
+  // transaction
+  if (in_transaction_) {
+    RollbackTransaction();
+  }
+  Checkpoint();
 }
 
 bool DatabaseEngine::Execute(const std::string& sql_command) {
   bool exit(false);
-  bool result;
-  std::string keyword;
-  std::vector<std::string> token;
+  bool result(false);
+  TokenList tokens;
+  TokenReader reader(tokens);
   CreateTableCommand create_command;
-  InsertIntoCommand insert_command;
+  InsertIntoCommandList insert_commands;
   SelectFromCommand select_command;
   UpdateSetCommand update_command;
   DropTableCommand drop_command;
+  SetVariableCommand set_command;
+  ExecuteCommand execute_command;
+  AnalyzeCommand analyze_command;
+  CopyCommand copy_command;
+
+  result = Tokenize(sql_command, tokens);
+  if (!result) {
+    reader.Fail(tokens.size() - 1);
+    goto done;
+  }
+
+  // placeholders only make sense in a prepared statement
+  if (!reader.IsKeyword(0, "PREPARE")) {
+    for (std::size_t i = 0; i < tokens.size(); i++) {
+      if (ParamToken == tokens.at(i).type) {
+        result = reader.Fail(i);
+        goto done;
+      }
+    }
+  }
 
-  // get first keyword
-  result = ExtractStr(sql_command, "\\s*(\\w+).*", token);
-  if (!result || token.size() != 1) {
-    result = false;
+  // a statement seen before with other literals skips the parser
+  if ((reader.IsKeyword(0, "INSERT") || reader.IsKeyword(0, "SELECT") ||
+       reader.IsKeyword(0, "UPDATE")) &&
+      ExecuteCachedStatement(tokens, reader, result)) {
     goto done;
   }
-  keyword = token.front();
-  transform(keyword.begin(), keyword.end(), keyword.begin(), ::toupper);
 
   // parse
-  if (keyword == "CREATE") {
-    result = ParseCreateTableCommand(sql_command, create_command);
+  if (reader.IsKeyword(0, "CREATE")) {
+    result = ParseCreateTableCommand(reader, create_command);
     if (!result) {
       goto done;
     }
+    // DDL commits an open transaction first
+    if (in_transaction_) {
+      CommitTransaction();
+    }
     ExecuteCreateTableCommand(create_command);
     UpdateTableInfo(root_schema_tables.table_name);
     UpdateTableInfo(root_schema_columns.table_name);
-  } else if (keyword == "INSERT") {
-    result = ParseInsertIntoCommand(sql_command, insert_command);
+    // the catalog tables never wait for a checkpoint
+    Checkpoint();
+  } else if (reader.IsKeyword(0, "INSERT")) {
+    result = ParseInsertIntoCommand(reader, insert_commands);
     if (!result) {
       goto done;
     }
-    ExecuteInsertIntoCommand(insert_command);
-    UpdateTableInfo(insert_command.table_name);
-  } else if (keyword == "SELECT") {
-    result = ParseSelectFromCommand(sql_command, select_command);
+    ExecuteInsertIntoCommand(insert_commands);
+    UpdateTableInfo(insert_commands.front().table_name);
+  } else if (reader.IsKeyword(0, "SELECT")) {
+    result = ParseSelectFromCommand(reader, select_command);
     if (!result) {
       goto done;
     }
     ExecuteSelectFromCommand(select_command);
-  } else if (keyword == "SHOW") {
-    result = ParseShowTableCommand(sql_command);
+  } else if (reader.IsKeyword(0, "EXPLAIN")) {
+    reader.Next();
+    result = ParseSelectFromCommand(reader, select_command);
+    if (!result) {
+      goto done;
+    }
+    ExecuteExplainCommand(select_command);
+  } else if (reader.IsKeyword(0, "SHOW")) {
+    result = ParseShowTableCommand(reader);
     if (!result) {
       goto done;
     }
     ExecuteShowTablesCommand();
-  } else if (keyword == "UPDATE") {
-    result = ParseUpdateSetCommand(sql_command, update_command);
+  } else if (reader.IsKeyword(0, "UPDATE")) {
+    result = ParseUpdateSetCommand(reader, update_command);
     if (!result) {
       goto done;
     }
     ExecuteUpdateSetCommand(update_command);
-  } else if (keyword == "DROP") {
-    result = ParseDropTableCommand(sql_command, drop_command);
+  } else if (reader.IsKeyword(0, "DROP")) {
+    result = ParseDropTableCommand(reader, drop_command);
     if (!result) {
       goto done;
     }
+    if (in_transaction_) {
+      CommitTransaction();
+    }
     ExecuteDropTableCommand(drop_command);
-  } else if (keyword == "EXIT") {
+    UpdateTableInfo(root_schema_tables.table_name);
+    UpdateTableInfo(root_schema_columns.table_name);
+    Checkpoint();
+  } else if (reader.IsKeyword(0, "SET")) {
+    result = ParseSetVariableCommand(reader, set_command);
+    if (!result) {
+      goto done;
+    }
+    ExecuteSetVariableCommand(set_command);
+  } else if (reader.IsKeyword(0, "ANALYZE")) {
+    result = ParseAnalyzeCommand(reader, analyze_command);
+    if (!result) {
+      goto done;
+    }
+    // may create the statistics catalog
+    if (in_transaction_) {
+      CommitTransaction();
+    }
+    ExecuteAnalyzeCommand(analyze_command);
+    Checkpoint();
+  } else if (reader.IsKeyword(0, "COPY")) {
+    result = ParseCopyCommand(reader, copy_command);
+    if (!result) {
+      goto done;
+    }
+    ExecuteCopyCommand(copy_command);
+    if (!copy_command.to_file) {
+      UpdateTableInfo(copy_command.table_name);
+    }
+  } else if (reader.IsKeyword(0, "BEGIN")) {
+    result = ParseTransactionCommand(reader, "BEGIN");
+    if (!result) {
+      goto done;
+    }
+    BeginTransaction();
+  } else if (reader.IsKeyword(0, "COMMIT")) {
+    result = ParseTransactionCommand(reader, "COMMIT");
+    if (!result) {
+      goto done;
+    }
+    if (!in_transaction_) {
+      std::cerr << "There is no transaction in progress" << std::endl;
+      goto done;
+    }
+    CommitTransaction();
+  } else if (reader.IsKeyword(0, "ROLLBACK")) {
+    result = ParseTransactionCommand(reader, "ROLLBACK");
+    if (!result) {
+      goto done;
+    }
+    if (!in_transaction_) {
+      std::cerr << "There is no transaction in progress" << std::endl;
+      goto done;
+    }
+    RollbackTransaction();
+  } else if (reader.IsKeyword(0, "CHECKPOINT")) {
+    result = ParseCheckpointCommand(reader);
+    if (!result) {
+      goto done;
+    }
+    if (in_transaction_) {
+      CommitTransaction();
+    }
+    Checkpoint();
+  } else if (reader.IsKeyword(0, "PREPARE")) {
+    result = ParsePrepareCommand(reader);
+  } else if (reader.IsKeyword(0, "EXECUTE")) {
+    result = ParseExecuteCommand(reader, execute_command) &&
+             RunPreparedStatement(
+                 *prepared_statements_.at(execute_command.statement_name),
+                 execute_command, reader);
+  } else if (reader.IsKeyword(0, "DEALLOCATE")) {
+    result = ParseDeallocateCommand(reader);
+  } else if (reader.IsKeyword(0, "EXIT")) {
     std::cout << "Bye!" << std::endl;
-    SaveRootTableInfo();
     exit = true;
+  } else {
+    result = reader.Fail(0);
   }
 
 done:
   if (!result) {
-    std::cerr << "Syntax error!" << std::endl;
+    std::cerr << "Syntax error " << reader.DescribeError() << "!" << std::endl;
   }
   return exit;
 }
 
-bool DatabaseEngine::ParseCreateTableCommand(const std::string& sql_command,
+bool DatabaseEngine::ParseCreateTableCommand(TokenReader& reader,
                                              CreateTableCommand& command) {
   bool result(false);
   bool is_nullable(false);
+  std::size_t type_index(0);
   std::string temp;
   SchemaDataType type;
   CreateTableColumn column;
-  std::vector<std::string> token;
-  std::vector<std::string> columns;
 
-  // extract table name and remaining
-  result = ExtractStr(sql_command, "\\s*CREATE\\s*TABLE\\s*" + regex_for_name +
-                                       "\\s*\\((.+)(?=\\))\\s*",
-                      token);
-
-  if (!result || token.size() != 2) {
-    result = false;
-    goto done;
-  }
-
-  command.table_name = token.front();
-
-  // split remaining by comma
-  temp = token.at(1);
-  SplitStr(temp, ',', token);
-  if (!token.size()) {
-    result = false;
+  // CREATE TABLE name (name INT PRIMARY KEY [, name type [NOT NULL] ...])
+  result = reader.ExpectKeyword("CREATE") && reader.ExpectKeyword("TABLE") &&
+           reader.ExpectWord(command.table_name) && reader.ExpectSymbol("(");
+  if (!result) {
     goto done;
   }
 
   // first column must be primary key
-  result = ExtractStr(token.front(),
-                      "\\s*" + regex_for_name + "\\s*INT\\s*PRIMARY\\s*KEY\\s*",
-                      columns);
-  if (!result || columns.size() != 1) {
-    result = false;
+  result = reader.ExpectWord(temp) && reader.ExpectKeyword("INT") &&
+           reader.ExpectKeyword("PRIMARY") && reader.ExpectKeyword("KEY");
+  if (!result) {
     goto done;
   }
 
-  column = {columns.front(), Int, primary_key};
+  column = {temp, Int, primary_key};
   command.column_list.push_back(column);
 
   // remaining column
-  for (auto i = 1; i < token.size(); i++) {
-    // first try with NOT NULL
-    result = ExtractStr(token.at(i), "\\s*" + regex_for_name + "\\s*" +
-                                         regex_for_type + "\\s*NOT\\s*NULL\\s*",
-                        columns);
-
-    if (!result || columns.size() != 2) {
-      // second try
-      result = ExtractStr(
-          token.at(i),
-          "\\s*" + regex_for_name + "\\s*" + regex_for_type + "\\s*", columns);
-      if (!result || columns.size() != 2) {
-        result = false;
-        goto done;
-      } else {
-        is_nullable = true;
-      }
-    } else {
-      is_nullable = false;
+  while (reader.MatchSymbol(",")) {
+    result = reader.ExpectWord(column.column_name);
+    if (!result) {
+      goto done;
     }
 
     // check type
-    type = StringToSchemaDataType(columns.at(1));
+    type_index = reader.GetIndex();
+    result = reader.ExpectWord(temp);
+    if (!result) {
+      goto done;
+    }
+    transform(temp.begin(), temp.end(), temp.begin(), ::toupper);
+    type = StringToSchemaDataType(temp);
     if (type == InvalidType) {
-      result = false;
+      result = reader.Fail(type_index);
       goto done;
     }
 
+    is_nullable = true;
+    if (reader.MatchKeyword("NOT")) {
+      result = reader.ExpectKeyword("NULL");
+      if (!result) {
+        goto done;
+      }
+      is_nullable = false;
+    }
+
     // save column
-    column = {columns.front(), type, is_nullable ? could_null : not_null};
+    column.type = type;
+    column.attribute = is_nullable ? could_null : not_null;
     command.column_list.push_back(column);
   }
 
+  result = reader.ExpectSymbol(")") && reader.ExpectEnd();
+
 done:
   return result;
 }
 
-bool DatabaseEngine::ParseInsertIntoCommand(const std::string& sql_command,
-                                            InsertIntoCommand& command) {
+bool DatabaseEngine::ParseInsertIntoCommand(TokenReader& reader,
+                                            InsertIntoCommandList& commands) {
   bool result(false);
-  std::string temp;
-  TypeCode type_code;
-  Value sql_value;
-  CreateTableColumn column_info;
+  std::size_t name_index(0);
+  std::string table_name;
   internal::TableManager* table(nullptr);
-  std::vector<std::string> token;
-  std::vector<std::string> values;
 
-  // Extract table name and remaining
-  result = ExtractStr(sql_command,
-                      "\\s*INSERT\\s*INTO\\s*TABLE\\s*" + regex_for_name +
-                          "\\s*"
-                          "VALUES\\s*\\((.+?)\\)\\s*",
-                      token);
-  if (!result || token.size() != 2) {
-    result = false;
+  // INSERT INTO TABLE name VALUES (value [, value ...]) [, (...) ...]
+  result = reader.ExpectKeyword("INSERT") && reader.ExpectKeyword("INTO") &&
+           reader.ExpectKeyword("TABLE");
+  if (!result) {
     goto done;
   }
 
   // try to load table from memory
-  command.table_name = token.front();
-  table = TryLoadTable(command.table_name);
+  name_index = reader.GetIndex();
+  result = reader.ExpectWord(table_name);
+  if (!result) {
+    goto done;
+  }
+  table = TryLoadTable(table_name);
   if (!table) {
-    result = false;
+    result = reader.Fail(name_index);
     goto done;
   }
 
-  temp = token.at(1);
-  // split remaining by comma
-  SplitStr(temp, ',', token);
-  if (!token.size()) {
-    result = false;
+  result = reader.ExpectKeyword("VALUES");
+  if (!result) {
     goto done;
   }
 
-  // check value list
-  for (auto i = 0; i < token.size(); i++) {
-    column_info = table->GetColumnInfo(i);
-    result = ParseValue(token.at(i), column_info.type, values);
+  commands.clear();
+  do {
+    commands.emplace_back();
+    commands.back().table_name = table_name;
+    result = ParseInsertRow(reader, *table, commands.back());
     if (!result) {
       goto done;
     }
+  } while (reader.MatchSymbol(","));
+
+  result = reader.ExpectEnd();
+
+done:
+  return result;
+}
+
+bool DatabaseEngine::ParseInsertRow(TokenReader& reader,
+                                    internal::TableManager& table,
+                                    InsertIntoCommand& command) {
+  bool result(false);
+  std::size_t value_index(0);
+  std::size_t parameter(0);
+  TypeCode type_code;
+  Value sql_value;
+  CreateTableColumn column_info;
+
+  result = reader.ExpectSymbol("(");
+  if (!result) {
+    goto done;
+  }
+
+  // check value list
+  do {
+    value_index = reader.GetIndex();
+    if (command.value_list.size() >= table.GetColumnNum()) {
+      result = reader.Fail(value_index);
+      goto done;
+    }
 
-    type_code = DataTypeToTypeCode(column_info.type, values.front());
+    column_info = table.GetColumnInfo(command.value_list.size());
+    result = ParseBoundValue(reader, column_info, type_code, sql_value,
+                             parameter);
+    if (!result) {
+      reader.Fail(value_index);
+      goto done;
+    }
     command.type_list.push_back(type_code);
-    sql_value = StringToValue(values.front(), type_code);
+    command.parameter_list.push_back(parameter);
 
-    if (IsNotNullViolate(type_code, column_info.attribute)) {
+    // a placeholder is checked when it is bound
+    if (!parameter && IsNotNullViolate(type_code, column_info.attribute)) {
       std::cerr
           << "Insertion aborted because Not Null violation found for column "
           << column_info.column_name << std::endl;
-      result = false;
+      result = reader.Fail(value_index);
       goto done;
     }
     command.value_list.push_back(sql_value);
-  }
+  } while (reader.MatchSymbol(","));
+
+  result = reader.ExpectSymbol(")");
 
 done:
   return result;
 }
 
-bool DatabaseEngine::ParseSelectFromCommand(const std::string& sql_command,
+bool DatabaseEngine::ParseSelectFromCommand(TokenReader& reader,
                                             SelectFromCommand& command) {
   bool result(false);
-  bool with_where(false);
+  std::size_t list_index(0);
+  std::size_t name_index(0);
+  std::size_t end_index(0);
+  std::size_t item_index(0);
   std::string temp;
-  fs::path file_path;
-  OperatorType op;
-  TypeCode type_code;
-  Value sql_value;
-  WhereClause clause;
-  CreateTableColumn column_info;
-  std::vector<std::string> condition_str;
-  std::vector<std::string> token;
-  std::vector<std::string> columns;
+  Condition condition;
+  OrderByClause order_by;
+  LimitClause limit;
+  AggregateClause aggregate;
+  std::size_t aggregate_num(0);
+  std::size_t table_index(0);
+  std::string column_name;
+  std::string scoped_name;
+  ColumnScope scope;
+  std::vector<Condition> where_parts[2];
   internal::TableManager* table(nullptr);
 
-  // separate them
-  result = ExtractStr(sql_command, "\\s*SELECT\\s*(.*?)\\s*FROM\\s*" +
-                                       regex_for_name + "\\s*WHERE\\s*" +
-                                       regex_for_name + "\\s*([>=<]{1,2})(.+)",
-                      token);
-  if (!result || token.size() != 5) {
-    result = ExtractStr(
-        sql_command,
-        "\\s*SELECT\\s*(.*?)\\s*FROM\\s*" + regex_for_name + "\\s*", token);
-    if (!result || token.size() != 2) {
-      result = false;
-      goto done;
-    } else {
-      with_where = false;
-    }
-  } else {
-    with_where = true;
+  result = reader.ExpectKeyword("SELECT");
+  if (!result) {
+    goto done;
+  }
+
+  // the SELECT list is resolved once FROM has named the tables
+  list_index = reader.GetIndex();
+  result = SkipSelectList(reader) && reader.ExpectKeyword("FROM");
+  if (!result) {
+    goto done;
   }
 
   // check table name
-  command.table_name = token.at(1);
+  name_index = reader.GetIndex();
+  result = reader.ExpectWord(command.table_name);
+  if (!result) {
+    goto done;
+  }
   table = TryLoadTable(command.table_name);
   if (!table) {
-    result = false;
+    result = reader.Fail(name_index);
     goto done;
   }
+  scope.AddTable(command.table_name, table);
+
+  // [[INNER] JOIN table ON column = column] [WHERE expression]
+  // [GROUP BY column [, column ...]] [ORDER BY column [ASC | DESC]]
+  // [LIMIT row_count [OFFSET offset]]
+  if (reader.MatchKeyword("INNER")) {
+    result = reader.ExpectKeyword("JOIN") &&
+             ParseJoin(reader, scope, command);
+    if (!result) {
+      goto done;
+    }
+  } else if (reader.MatchKeyword("JOIN")) {
+    result = ParseJoin(reader, scope, command);
+    if (!result) {
+      goto done;
+    }
+  }
 
-  if (with_where) {
-    // check column name
-    if (!table->IsColumnValid(token.at(2))) {
-      result = false;
+  if (reader.MatchKeyword("WHERE")) {
+    item_index = reader.GetIndex();
+    result = ParseCondition(scope, reader, condition);
+    if (!result) {
       goto done;
     }
 
-    // check operator type
-    op = StringToOperator(token.at(3));
-    if (op == InvalidOp) {
-      result = false;
+    if (!scope.IsJoin()) {
+      // save whole where expression
+      command.where = std::experimental::make_optional(condition);
+    } else {
+      // each table filters its own rows before the join
+      result = SplitJoinCondition(scope, condition, where_parts);
+      if (!result) {
+        reader.Fail(item_index);
+        goto done;
+      }
+      command.where = MakeConjunction(where_parts[0]);
+      command.join->where = MakeConjunction(where_parts[1]);
+    }
+  }
+
+  if (reader.IsKeyword(0, "GROUP")) {
+    // joins do not aggregate
+    result = !scope.IsJoin() || reader.Fail(reader.GetIndex());
+    result = result && reader.ExpectKeyword("GROUP") &&
+             reader.ExpectKeyword("BY");
+    if (!result) {
       goto done;
     }
+    do {
+      item_index = reader.GetIndex();
+      result = reader.ExpectWord(temp);
+      if (!result) {
+        goto done;
+      }
+      if (!scope.Resolve(temp, table_index, column_name, scoped_name)) {
+        result = reader.Fail(item_index);
+        goto done;
+      }
+      command.group_by.push_back(scoped_name);
+    } while (reader.MatchSymbol(","));
+  }
 
-    result = table->GetColumnInfo(token.at(2), column_info);
+  if (reader.MatchKeyword("ORDER")) {
+    result = reader.ExpectKeyword("BY");
+    item_index = reader.GetIndex();
+    result = result && reader.ExpectWord(temp);
     if (!result) {
       goto done;
     }
+    if (!scope.Resolve(temp, table_index, column_name, scoped_name)) {
+      result = reader.Fail(item_index);
+      goto done;
+    }
+    order_by.column_name = scoped_name;
+    order_by.descending = false;
+    if (reader.MatchKeyword("DESC")) {
+      order_by.descending = true;
+    } else {
+      reader.MatchKeyword("ASC");
+    }
+    command.order_by = std::experimental::make_optional(order_by);
+  }
 
-    result = ParseValue(token.at(4), column_info.type, condition_str);
+  if (reader.MatchKeyword("LIMIT")) {
+    limit.offset = 0;
+    result = ParseRowCount(reader, limit.row_count);
+    if (result && reader.MatchKeyword("OFFSET")) {
+      result = ParseRowCount(reader, limit.offset);
+    }
     if (!result) {
       goto done;
     }
+    command.limit = std::experimental::make_optional(limit);
+  }
+
+  result = reader.ExpectEnd();
+  if (!result) {
+    goto done;
+  }
+  end_index = reader.GetIndex();
+
+  // back to the SELECT list
+  reader.Seek(list_index);
+
+  // SELECT *, a join lists the columns of both tables
+  if (reader.MatchSymbol("*") && scope.IsJoin()) {
+    for (std::size_t i = 0; i < 2; i++) {
+      table = scope.GetTable(i);
+      for (std::size_t j = 0; j < table->GetColumnNum(); j++) {
+        command.column_name.push_back(scope.GetTableName(i) + "." +
+                                      table->GetColumnInfo(j).column_name);
+      }
+    }
+  } else if (reader.GetIndex() != list_index) {
+    command.column_name.push_back("*");
+  } else {
+    do {
+      item_index = reader.GetIndex();
+
+      // aggregate(column) or COUNT(*)
+      if (!scope.IsJoin() && reader.IsSymbol(1, "(")) {
+        result = ParseAggregate(table, reader, aggregate, temp);
+        if (!result) {
+          goto done;
+        }
+        command.aggregates.push_back(aggregate);
+        command.column_name.push_back(temp);
+        ++aggregate_num;
+        continue;
+      }
 
-    // convert value
-    type_code = DataTypeToTypeCode(column_info.type, condition_str.front());
-    sql_value = StringToValue(condition_str.front(), type_code);
+      result = reader.ExpectWord(temp);
+      if (!result) {
+        goto done;
+      }
+      if (!scope.Resolve(temp, table_index, column_name, scoped_name)) {
+        result = reader.Fail(item_index);
+        goto done;
+      }
 
-    // save whole where clause
-    clause = {token.at(2), op, type_code, sql_value};
-    command.where = std::experimental::make_optional(clause);
+      command.aggregates.push_back({NoAggregate, scoped_name});
+      command.column_name.push_back(scoped_name);
+    } while (reader.MatchSymbol(","));
   }
 
-  // split column
-  temp = token.front();
-  SplitStr(temp, ',', token);
+  reader.Seek(end_index);
 
-  // SELECT *
-  if (token.size() == 1 && token.front() == "*") {
-    command.column_name.push_back(token.front());
+  if (command.group_by.empty()) {
+    // aggregates make a single row, no plain columns to go with it
+    if (aggregate_num && (aggregate_num != command.column_name.size() ||
+                          command.order_by)) {
+      result = reader.Fail(list_index);
+      goto done;
+    }
+    if (!aggregate_num) {
+      command.aggregates.clear();
+    }
   } else {
-    for (auto i = 0; i < token.size(); i++) {
-      result =
-          ExtractStr(token.at(i), "\\s*" + regex_for_name + "\\s*", columns);
-      if (!result || columns.size() != 1 ||
-          !table->IsColumnValid(columns.at(0))) {
-        result = false;
+    // plain columns and the ORDER BY column must be grouped on
+    for (const auto& item : command.aggregates) {
+      if (NoAggregate == item.type &&
+          !IsGroupColumn(command, item.column_name)) {
+        result = reader.Fail(list_index);
         goto done;
       }
-
-      command.column_name.push_back(columns.front());
+    }
+    if (command.aggregates.empty() ||
+        (command.order_by &&
+         !IsGroupColumn(command, command.order_by->column_name))) {
+      result = reader.Fail(list_index);
+      goto done;
     }
   }
 
@@ -452,166 +787,1193 @@ done:
   return result;
 }
 
-bool DatabaseEngine::ParseShowTableCommand(const std::string& sql_command) {
-  bool result(false);
-  std::vector<std::string> token;
-  result = ExtractStr(sql_command, "\\s*SHOW\\s*TABLES\\s*", token);
-  return (result && token.empty());
+bool DatabaseEngine::SkipSelectList(TokenReader& reader) {
+  std::string word;
+
+  // item := * | column | function ( * | column )
+  do {
+    if (reader.MatchSymbol("*")) {
+      continue;
+    }
+    if (reader.IsKeyword(0, "FROM") || !reader.ExpectWord(word)) {
+      return reader.Fail(reader.GetIndex());
+    }
+    if (reader.MatchSymbol("(") &&
+        !((reader.MatchSymbol("*") || reader.ExpectWord(word)) &&
+          reader.ExpectSymbol(")"))) {
+      return false;
+    }
+  } while (reader.MatchSymbol(","));
+
+  return true;
 }
 
-bool DatabaseEngine::ParseUpdateSetCommand(const std::string& sql_command,
-                                           UpdateSetCommand& command) {
+bool DatabaseEngine::ParseJoin(TokenReader& reader, ColumnScope& scope,
+                               SelectFromCommand& command) {
   bool result(false);
-  std::string temp;
-  TypeCode type_code;
-  Value sql_value;
-  CreateTableColumn column_info;
-  std::vector<std::string> condition_str;
-  std::vector<std::string> token;
-  std::vector<std::string> set_clause;
+  JoinClause join;
+  std::size_t name_index(reader.GetIndex());
+  std::size_t left_index(0);
+  std::size_t right_index(0);
+  std::string left_name;
+  std::string right_name;
+  std::string scoped_name;
+  CreateTableColumn left_info;
+  CreateTableColumn right_info;
   internal::TableManager* table(nullptr);
 
-  result = ExtractStr(sql_command, "\\s*UPDATE\\s*" + regex_for_name +
-                                       "\\s*SET\\s*(.+)\\s*WHERE\\s*" +
-                                       regex_for_name + "\\s*=(.+)",
-                      token);
-  if (!result || token.size() != 4) {
-    result = false;
+  // table ON column = column
+  result = reader.ExpectWord(join.table_name);
+  if (!result) {
     goto done;
   }
 
-  // check table name
-  command.table_name = token.front();
-  table = TryLoadTable(command.table_name);
-  if (!table) {
-    result = false;
+  // a self join would need table aliases
+  if (join.table_name == command.table_name) {
+    result = reader.Fail(name_index);
     goto done;
   }
 
-  // check column name
-  if (!table->IsColumnValid(token.at(2))) {
-    result = false;
+  table = TryLoadTable(join.table_name);
+  if (!table) {
+    result = reader.Fail(name_index);
     goto done;
   }
+  scope.AddTable(join.table_name, table);
 
-  result = table->GetColumnInfo(token.at(2), column_info);
+  name_index = reader.GetIndex() + 1;
+  result = reader.ExpectKeyword("ON") && reader.ExpectWord(left_name) &&
+           reader.ExpectSymbol("=") && reader.ExpectWord(right_name);
   if (!result) {
     goto done;
   }
 
-  result = ParseValue(token.at(3), column_info.type, condition_str);
-  if (!result) {
+  if (!scope.Resolve(left_name, left_index, join.left_column, scoped_name)) {
+    result = reader.Fail(name_index);
+    goto done;
+  }
+  if (!scope.Resolve(right_name, right_index, join.right_column,
+                     scoped_name) ||
+      left_index == right_index) {
+    result = reader.Fail(name_index + 2);
     goto done;
   }
 
-  // convert value
-  type_code = DataTypeToTypeCode(column_info.type, condition_str.front());
-  sql_value = StringToValue(condition_str.front(), type_code);
-
-  // save whole where clause
-  command.where = {token.at(2), Equal, type_code, sql_value};
-
-  // split column
-  temp = token.at(1);
-  SplitStr(temp, ',', token);
-
-  // set clause
-  for (auto i = 0; i < token.size(); i++) {
-    result = ExtractStr(token.at(i), "\\s*" + regex_for_name + "\\s*=(.+)",
-                        set_clause);
-    if (!result || set_clause.size() != 2 ||
-        !table->IsColumnValid(set_clause.front())) {
-      result = false;
-      goto done;
-    }
-
-    // get type
-    result = table->GetColumnInfo(set_clause.front(), column_info);
-    if (!result) {
-      result = false;
-      goto done;
-    }
-
-    // parse value
-    result = ParseValue(set_clause.at(1), column_info.type, condition_str);
-    if (!result) {
-      goto done;
-    }
-
-    // convert value
-    type_code = DataTypeToTypeCode(column_info.type, condition_str.front());
-    sql_value = StringToValue(condition_str.front(), type_code);
-
-    if (IsNotNullViolate(type_code, column_info.attribute)) {
-      std::cerr << "Update aborted because Not Null violation found for column "
-                << column_info.column_name << std::endl;
-      result = false;
-      goto done;
-    }
+  // the FROM table's column goes on the left
+  if (left_index) {
+    std::swap(join.left_column, join.right_column);
+  }
 
-    command.set_list.push_back({set_clause.front(), type_code, sql_value});
+  // keys only compare by value within one type
+  scope.GetTable(0)->GetColumnInfo(join.left_column, left_info);
+  table->GetColumnInfo(join.right_column, right_info);
+  if (left_info.type != right_info.type) {
+    result = reader.Fail(name_index);
+    goto done;
   }
 
+  command.join = std::experimental::make_optional(join);
+
 done:
   return result;
 }
 
-bool DatabaseEngine::ParseDropTableCommand(const std::string& sql_command,
-                                           DropTableCommand& command) {
+bool DatabaseEngine::ParseAggregate(internal::TableManager* table,
+                                    TokenReader& reader,
+                                    AggregateClause& aggregate,
+                                    std::string& label) {
   bool result(false);
-  std::vector<std::string> token;
+  std::size_t function_index(reader.GetIndex());
+  std::size_t column_index(0);
+  std::string function_name;
+  CreateTableColumn column_info;
 
-  result = ExtractStr(sql_command,
-                      "\\s*DROP\\s*TABLE\\s*" + regex_for_name + "\\s*", token);
-  if (!result || token.size() != 1) {
-    result = false;
+  // function ( * | column )
+  result = reader.ExpectWord(function_name) && reader.ExpectSymbol("(");
+  if (!result) {
     goto done;
   }
 
-  // check table
-  command.table_name = token.front();
-  if ((database_tables_.find(command.table_name) == database_tables_.end()) &&
-      !fs::exists(FILE_PATH(command.table_name))) {
-    result = false;
+  transform(function_name.begin(), function_name.end(), function_name.begin(),
+            ::toupper);
+  if (function_name == "COUNT") {
+    aggregate.type = CountAggregate;
+  } else if (function_name == "SUM") {
+    aggregate.type = SumAggregate;
+  } else if (function_name == "MIN") {
+    aggregate.type = MinAggregate;
+  } else if (function_name == "MAX") {
+    aggregate.type = MaxAggregate;
+  } else if (function_name == "AVG") {
+    aggregate.type = AvgAggregate;
+  } else {
+    result = reader.Fail(function_index);
+    goto done;
   }
 
-done:
-  return result;
+  column_index = reader.GetIndex();
+  if (reader.MatchSymbol("*")) {
+    aggregate.column_name = "*";
+  } else {
+    result = reader.ExpectWord(aggregate.column_name);
+    if (!result) {
+      goto done;
+    }
+  }
+
+  result = reader.ExpectSymbol(")");
+  if (!result) {
+    goto done;
+  }
+
+  // only COUNT takes *
+  if (aggregate.column_name == "*") {
+    result = (CountAggregate == aggregate.type) || reader.Fail(column_index);
+    goto done;
+  }
+
+  result = table->GetColumnInfo(aggregate.column_name, column_info);
+  if (!result) {
+    reader.Fail(column_index);
+    goto done;
+  }
+
+  // SUM and AVG need numbers
+  if ((SumAggregate == aggregate.type || AvgAggregate == aggregate.type) &&
+      (column_info.type < TinyInt || column_info.type > Double)) {
+    result = reader.Fail(column_index);
+    goto done;
+  }
+
+done:
+  if (result) {
+    label = function_name + "(" + aggregate.column_name + ")";
+  }
+  return result;
+}
+
+bool DatabaseEngine::ParseShowTableCommand(TokenReader& reader) {
+  return reader.ExpectKeyword("SHOW") && reader.ExpectKeyword("TABLES") &&
+         reader.ExpectEnd();
+}
+
+bool DatabaseEngine::ParseUpdateSetCommand(TokenReader& reader,
+                                           UpdateSetCommand& command) {
+  bool result(false);
+  std::size_t name_index(0);
+  std::size_t column_index(0);
+  std::size_t value_index(0);
+  std::string value;
+  CreateTableColumn column_info;
+  SetClause set_clause;
+  ColumnScope scope;
+  internal::TableManager* table(nullptr);
+
+  // UPDATE name SET column = value [, column = value ...]
+  // WHERE column = value
+  result = reader.ExpectKeyword("UPDATE");
+  if (!result) {
+    goto done;
+  }
+
+  // check table name
+  name_index = reader.GetIndex();
+  result = reader.ExpectWord(command.table_name);
+  if (!result) {
+    goto done;
+  }
+  table = TryLoadTable(command.table_name);
+  if (!table) {
+    result = reader.Fail(name_index);
+    goto done;
+  }
+  scope.AddTable(command.table_name, table);
+
+  result = reader.ExpectKeyword("SET");
+  if (!result) {
+    goto done;
+  }
+
+  // set clause
+  do {
+    column_index = reader.GetIndex();
+    result = reader.ExpectWord(set_clause.column_name);
+    if (!result) {
+      goto done;
+    }
+
+    // get type
+    if (!table->GetColumnInfo(set_clause.column_name, column_info)) {
+      result = reader.Fail(column_index);
+      goto done;
+    }
+
+    // parse value
+    result = reader.ExpectSymbol("=");
+    if (!result) {
+      goto done;
+    }
+    value_index = reader.GetIndex();
+    if (!ParseBoundValue(reader, column_info, set_clause.type_code,
+                         set_clause.value, set_clause.parameter)) {
+      result = reader.Fail(value_index);
+      goto done;
+    }
+
+    if (!set_clause.parameter &&
+        IsNotNullViolate(set_clause.type_code, column_info.attribute)) {
+      std::cerr << "Update aborted because Not Null violation found for column "
+                << column_info.column_name << std::endl;
+      result = reader.Fail(value_index);
+      goto done;
+    }
+
+    command.set_list.push_back(set_clause);
+  } while (reader.MatchSymbol(","));
+
+  // save whole where clause
+  result = reader.ExpectKeyword("WHERE");
+  column_index = reader.GetIndex();
+  result = result && reader.ExpectWord(value) && reader.ExpectSymbol("=") &&
+           ParseWhereClause(scope, reader, column_index, Equal,
+                            command.where) &&
+           reader.ExpectEnd();
+
+done:
+  return result;
+}
+
+bool DatabaseEngine::ParseDropTableCommand(TokenReader& reader,
+                                           DropTableCommand& command) {
+  bool result(false);
+  std::size_t name_index(0);
+
+  result = reader.ExpectKeyword("DROP") && reader.ExpectKeyword("TABLE");
+  name_index = reader.GetIndex();
+  result = result && reader.ExpectWord(command.table_name) &&
+           reader.ExpectEnd();
+  if (!result) {
+    goto done;
+  }
+
+  // check table
+  if ((database_tables_.find(command.table_name) == database_tables_.end()) &&
+      !fs::exists(FILE_PATH(command.table_name))) {
+    result = reader.Fail(name_index);
+  }
+
+done:
+  return result;
+}
+
+bool DatabaseEngine::ParseSetVariableCommand(TokenReader& reader,
+                                             SetVariableCommand& command) {
+  bool result(false);
+
+  // SET name = value
+  result = reader.ExpectKeyword("SET") &&
+           reader.ExpectWord(command.variable_name) &&
+           reader.ExpectSymbol("=") && reader.ExpectWord(command.value) &&
+           reader.ExpectEnd();
+  if (!result) {
+    return false;
+  }
+
+  transform(command.variable_name.begin(), command.variable_name.end(),
+            command.variable_name.begin(), ::tolower);
+
+  return true;
+}
+
+bool DatabaseEngine::ParsePrepareCommand(TokenReader& reader) {
+  bool result(false);
+  std::size_t name_index(0);
+  std::string statement_name;
+
+  // PREPARE name AS statement
+  result = reader.ExpectKeyword("PREPARE");
+  name_index = reader.GetIndex();
+  result = result && reader.ExpectWord(statement_name) &&
+           reader.ExpectKeyword("AS");
+  if (!result) {
+    goto done;
+  }
+
+  if (prepared_statements_.count(statement_name)) {
+    std::cerr << "Prepared statement " << statement_name << " already exists"
+              << std::endl;
+    result = reader.Fail(name_index);
+    goto done;
+  }
+
+  result = PrepareStatement(statement_name, reader);
+
+done:
+  return result;
+}
+
+bool DatabaseEngine::ParseExecuteCommand(TokenReader& reader,
+                                         ExecuteCommand& command) {
+  bool result(false);
+  std::size_t name_index(0);
+
+  // EXECUTE name [(value [, value ...])]
+  result = reader.ExpectKeyword("EXECUTE");
+  name_index = reader.GetIndex();
+  result = result && reader.ExpectWord(command.statement_name);
+  if (!result) {
+    goto done;
+  }
+
+  if (!prepared_statements_.count(command.statement_name)) {
+    result = reader.Fail(name_index);
+    goto done;
+  }
+
+  if (reader.MatchSymbol("(")) {
+    do {
+      if (WordToken != reader.Peek().type &&
+          StringToken != reader.Peek().type) {
+        result = reader.Fail(reader.GetIndex());
+        goto done;
+      }
+      command.arguments.push_back(reader.GetIndex());
+      reader.Next();
+    } while (reader.MatchSymbol(","));
+
+    result = reader.ExpectSymbol(")");
+    if (!result) {
+      goto done;
+    }
+  }
+
+  result = reader.ExpectEnd();
+
+done:
+  return result;
+}
+
+bool DatabaseEngine::ParseDeallocateCommand(TokenReader& reader) {
+  bool result(false);
+  std::size_t name_index(0);
+  std::string statement_name;
+
+  // DEALLOCATE [PREPARE] name | ALL
+  result = reader.ExpectKeyword("DEALLOCATE");
+  reader.MatchKeyword("PREPARE");
+  name_index = reader.GetIndex();
+  result = result && reader.ExpectWord(statement_name) && reader.ExpectEnd();
+  if (!result) {
+    goto done;
+  }
+
+  if (!strcasecmp(statement_name.c_str(), "ALL")) {
+    prepared_statements_.clear();
+  } else if (!prepared_statements_.erase(statement_name)) {
+    result = reader.Fail(name_index);
+  }
+
+done:
+  return result;
+}
+
+bool DatabaseEngine::ParseAnalyzeCommand(TokenReader& reader,
+                                         AnalyzeCommand& command) {
+  bool result(false);
+  std::size_t name_index(0);
+
+  // ANALYZE [name]
+  result = reader.ExpectKeyword("ANALYZE");
+  if (!result || reader.AtEnd()) {
+    goto done;
+  }
+
+  name_index = reader.GetIndex();
+  result = reader.ExpectWord(command.table_name) && reader.ExpectEnd();
+  if (!result) {
+    goto done;
+  }
+
+  // catalog tables are not analyzed
+  if (IsCatalogTable(command.table_name) ||
+      !TryLoadTable(command.table_name)) {
+    result = reader.Fail(name_index);
+  }
+
+done:
+  return result;
+}
+
+bool DatabaseEngine::ParseCopyCommand(TokenReader& reader,
+                                      CopyCommand& command) {
+  bool result(false);
+  std::size_t name_index(0);
+  internal::TableManager* table(nullptr);
+  ColumnScope scope;
+  Condition condition;
+
+  command.to_file = false;
+  command.delimiter = ',';
+  command.header = false;
+  command.where = std::experimental::nullopt;
+  command.binary = false;
+
+  // COPY name FROM 'file' [DELIMITER 'c'] [HEADER]
+  // COPY name [WHERE expression] TO 'file' [[CSV] [HEADER] | BINARY]
+  result = reader.ExpectKeyword("COPY");
+  if (!result) {
+    goto done;
+  }
+
+  name_index = reader.GetIndex();
+  result = reader.ExpectWord(command.table_name);
+  if (!result) {
+    goto done;
+  }
+  table = IsCatalogTable(command.table_name)
+              ? nullptr
+              : TryLoadTable(command.table_name);
+  if (!table) {
+    result = reader.Fail(name_index);
+    goto done;
+  }
+  scope.AddTable(command.table_name, table);
+
+  if (reader.MatchKeyword("WHERE")) {
+    result = ParseCondition(scope, reader, condition) &&
+             reader.ExpectKeyword("TO");
+    if (!result) {
+      goto done;
+    }
+    command.where = std::experimental::make_optional(condition);
+    command.to_file = true;
+  } else if (reader.MatchKeyword("TO")) {
+    command.to_file = true;
+  } else {
+    result = reader.ExpectKeyword("FROM");
+    if (!result) {
+      goto done;
+    }
+  }
+
+  if (StringToken != reader.Peek().type || reader.Peek().text.empty()) {
+    result = reader.Fail(reader.GetIndex());
+    goto done;
+  }
+  command.file_path = reader.Next().text;
+
+  if (command.to_file) {
+    // a header line only on request, as COPY FROM reads one
+    command.binary = reader.MatchKeyword("BINARY");
+    if (!command.binary) {
+      reader.MatchKeyword("CSV");
+      command.header = reader.MatchKeyword("HEADER");
+    }
+    result = reader.ExpectEnd();
+    goto done;
+  }
+
+  if (reader.MatchKeyword("DELIMITER")) {
+    // one character that cannot start or be part of a value
+    const Token& token(reader.Peek());
+    if (StringToken != token.type || token.text.size() != 1 ||
+        std::isalnum(static_cast<unsigned char>(token.text.front())) ||
+        std::string(".-+\"\r\n").find(token.text.front()) !=
+            std::string::npos) {
+      result = reader.Fail(reader.GetIndex());
+      goto done;
+    }
+    command.delimiter = reader.Next().text.front();
+  }
+  command.header = reader.MatchKeyword("HEADER");
+
+  result = reader.ExpectEnd();
+
+done:
+  return result;
+}
+
+bool DatabaseEngine::ParseTransactionCommand(TokenReader& reader,
+                                             const char* keyword) {
+  // BEGIN | COMMIT | ROLLBACK [TRANSACTION]
+  if (!reader.ExpectKeyword(keyword)) {
+    return false;
+  }
+  reader.MatchKeyword("TRANSACTION");
+  return reader.ExpectEnd();
+}
+
+bool DatabaseEngine::ParseCheckpointCommand(TokenReader& reader) {
+  // CHECKPOINT
+  if (!reader.ExpectKeyword("CHECKPOINT")) {
+    return false;
+  }
+  return reader.ExpectEnd();
+}
+
+bool DatabaseEngine::ParseCondition(const ColumnScope& scope,
+                                    TokenReader& reader,
+                                    Condition& condition) {
+  bool result(false);
+  Condition operand;
+  std::vector<Condition> operands;
+
+  // expression := term (OR term)*
+  do {
+    result = ParseConditionTerm(scope, reader, operand);
+    if (!result) {
+      goto done;
+    }
+    operands.push_back(operand);
+  } while (reader.MatchKeyword("OR"));
+
+  if (operands.size() == 1) {
+    condition = operands.front();
+  } else {
+    condition = Condition(OrCondition, operands);
+  }
+
+done:
+  return result;
+}
+
+bool DatabaseEngine::ParseConditionTerm(const ColumnScope& scope,
+                                        TokenReader& reader,
+                                        Condition& condition) {
+  bool result(false);
+  Condition operand;
+  std::vector<Condition> operands;
+
+  // term := factor (AND factor)*
+  do {
+    result = ParseConditionFactor(scope, reader, operand);
+    if (!result) {
+      goto done;
+    }
+    operands.push_back(operand);
+  } while (reader.MatchKeyword("AND"));
+
+  if (operands.size() == 1) {
+    condition = operands.front();
+  } else {
+    condition = Condition(AndCondition, operands);
+  }
+
+done:
+  return result;
+}
+
+bool DatabaseEngine::ParseConditionFactor(const ColumnScope& scope,
+                                          TokenReader& reader,
+                                          Condition& condition) {
+  bool result(false);
+  std::size_t column_index(reader.GetIndex());
+  std::string column_name;
+  OperatorType op;
+  Condition operand;
+  WhereClause clause;
+
+  // factor := NOT factor | ( expression ) | column operator value
+  //         | column [NOT] BETWEEN value AND value
+  if (reader.MatchKeyword("NOT")) {
+    result = ParseConditionFactor(scope, reader, operand);
+    if (!result) {
+      goto done;
+    }
+    condition = Condition(NotCondition, {operand});
+  } else if (reader.MatchSymbol("(")) {
+    result = ParseCondition(scope, reader, condition) &&
+             reader.ExpectSymbol(")");
+  } else if (IsBetween(reader)) {
+    result = ParseBetween(scope, reader, condition);
+  } else {
+    result = reader.ExpectWord(column_name);
+    if (!result) {
+      goto done;
+    }
+
+    // check operator type
+    op = (SymbolToken == reader.Peek().type)
+             ? StringToOperator(reader.Peek().text)
+             : InvalidOp;
+    if (op == InvalidOp) {
+      result = reader.Fail(reader.GetIndex());
+      goto done;
+    }
+    reader.Next();
+
+    result = ParseWhereClause(scope, reader, column_index, op, clause);
+    if (!result) {
+      goto done;
+    }
+    condition = Condition(clause);
+  }
+
+done:
+  return result;
+}
+
+bool DatabaseEngine::IsBetween(const TokenReader& reader) {
+  return reader.IsKeyword(1, "BETWEEN") ||
+         (reader.IsKeyword(1, "NOT") && reader.IsKeyword(2, "BETWEEN"));
+}
+
+bool DatabaseEngine::ParseBetween(const ColumnScope& scope,
+                                  TokenReader& reader, Condition& condition) {
+  bool result(false);
+  bool negate(false);
+  std::size_t column_index(reader.GetIndex());
+  WhereClause lower_clause;
+  WhereClause upper_clause;
+
+  reader.Next();
+  negate = reader.MatchKeyword("NOT");
+  reader.MatchKeyword("BETWEEN");
+
+  // both bounds are inclusive
+  result = ParseWhereClause(scope, reader, column_index, NotSmaller,
+                            lower_clause) &&
+           reader.ExpectKeyword("AND") &&
+           ParseWhereClause(scope, reader, column_index, NotLarger,
+                            upper_clause);
+  if (!result) {
+    goto done;
+  }
+
+  condition = Condition(
+      AndCondition, {Condition(lower_clause), Condition(upper_clause)});
+  if (negate) {
+    condition = Condition(NotCondition, {condition});
+  }
+
+done:
+  return result;
+}
+
+bool DatabaseEngine::ParseWhereClause(const ColumnScope& scope,
+                                      TokenReader& reader,
+                                      const std::size_t& column_index,
+                                      const OperatorType& op,
+                                      WhereClause& clause) {
+  bool result(false);
+  std::size_t table_index(0);
+  std::size_t value_index(reader.GetIndex());
+  std::string bare_name;
+  std::string scoped_name;
+  CreateTableColumn column_info;
+
+  // check column name
+  if (!scope.Resolve(reader.GetToken(column_index).text, table_index,
+                     bare_name, scoped_name)) {
+    result = reader.Fail(column_index);
+    goto done;
+  }
+
+  result = scope.GetTable(table_index)->GetColumnInfo(bare_name, column_info);
+  if (!result) {
+    reader.Fail(column_index);
+    goto done;
+  }
+
+  clause.column_name = scoped_name;
+  clause.condition_operator = op;
+  result = ParseBoundValue(reader, column_info, clause.type_code, clause.value,
+                           clause.parameter);
+  if (!result) {
+    reader.Fail(value_index);
+  }
+
+done:
+  return result;
+}
+
+bool DatabaseEngine::SplitJoinCondition(const ColumnScope& scope,
+                                        Condition& condition,
+                                        std::vector<Condition> (&parts)[2]) {
+  std::size_t table_index(std::numeric_limits<std::size_t>::max());
+
+  if (AndCondition == condition.type) {
+    for (auto& operand : condition.children) {
+      if (!SplitJoinCondition(scope, operand, parts)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  if (!UnqualifyCondition(scope, condition, table_index)) {
+    return false;
+  }
+  parts[table_index].push_back(condition);
+  return true;
+}
+
+bool DatabaseEngine::UnqualifyCondition(const ColumnScope& scope,
+                                        Condition& condition,
+                                        std::size_t& table_index) {
+  std::size_t index(0);
+  std::string column_name;
+  std::string scoped_name;
+
+  if (LeafCondition != condition.type) {
+    for (auto& operand : condition.children) {
+      if (!UnqualifyCondition(scope, operand, table_index)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // the other table's columns are not in that scan
+  scope.Resolve(condition.clause.column_name, index, column_name, scoped_name);
+  if (table_index != std::numeric_limits<std::size_t>::max() &&
+      table_index != index) {
+    return false;
+  }
+
+  table_index = index;
+  condition.clause.column_name = column_name;
+  return true;
+}
+
+std::experimental::optional<Condition> DatabaseEngine::MakeConjunction(
+    const std::vector<Condition>& operands) {
+  if (operands.empty()) {
+    return std::experimental::nullopt;
+  }
+  if (operands.size() == 1) {
+    return std::experimental::make_optional(operands.front());
+  }
+  return std::experimental::make_optional(
+      Condition(AndCondition, operands));
+}
+
+bool DatabaseEngine::ParseValue(const Token& token, const SchemaDataType& type,
+                                std::string& value) {
+  char* end(nullptr);
+
+  // NULL of any type, text keeps it as an empty string
+  if (WordToken == token.type && !strcasecmp(token.text.c_str(), "NULL")) {
+    value = (Text == type) ? "" : "NULL";
+    return true;
+  }
+
+  value = token.text;
+  if (Text == type) {
+    return (StringToken == token.type);
+  } else if (Date == type || DateTime == type) {
+    return (StringToken == token.type || WordToken == token.type);
+  }
+
+  // numbers are unquoted
+  if (WordToken != token.type) {
+    return false;
+  }
+  std::strtod(value.c_str(), &end);
+  return ('\0' == *end);
+}
+
+bool DatabaseEngine::ParseBoundValue(TokenReader& reader,
+                                     const CreateTableColumn& column_info,
+                                     TypeCode& type_code, Value& value,
+                                     std::size_t& parameter) {
+  const Token& token(reader.Next());
+  std::string value_str;
+
+  // $n, the type code of the column until EXECUTE binds a value
+  if (ParamToken == token.type) {
+    if (token.text.size() > max_parameter_digits + 1) {
+      return false;
+    }
+    parameter = std::stoul(token.text.substr(1));
+    type_code = static_cast<TypeCode>(column_info.type);
+    value = Value();
+    return (parameter > 0);
+  }
+
+  parameter = 0;
+  if (!ParseValue(token, column_info.type, value_str)) {
+    return false;
+  }
+  type_code = DataTypeToTypeCode(column_info.type, value_str);
+  value = StringToValue(value_str, type_code);
+  return true;
+}
+
+bool DatabaseEngine::IsNotNullViolate(const TypeCode& type_code,
+                                      const ColumnAttribute& attr) {
+  return (IsTypeCodeNull(type_code) &&
+          (not_null == attr || primary_key == attr));
+}
+
+bool DatabaseEngine::Prepare(const std::string& statement_name,
+                             const std::string& sql_command) {
+  bool result(false);
+  TokenList tokens;
+  TokenReader reader(tokens);
+
+  if (prepared_statements_.count(statement_name)) {
+    std::cerr << "Prepared statement " << statement_name << " already exists"
+              << std::endl;
+    return false;
+  }
+
+  result = Tokenize(sql_command, tokens);
+  if (!result) {
+    reader.Fail(tokens.size() - 1);
+    goto done;
+  }
+
+  result = PrepareStatement(statement_name, reader);
+
+done:
+  if (!result) {
+    std::cerr << "Syntax error " << reader.DescribeError() << "!" << std::endl;
+  }
+  return result;
+}
+
+bool DatabaseEngine::ExecutePrepared(const std::string& statement_name,
+                                     const std::vector<std::string>& arguments) {
+  bool result(false);
+  std::string sql_command("EXECUTE " + statement_name);
+  TokenList tokens;
+  TokenReader reader(tokens);
+  ExecuteCommand command;
+
+  // arguments are literals, spelled out they go through the EXECUTE parser
+  for (std::size_t i = 0; i < arguments.size(); i++) {
+    sql_command += (i ? ", " : " (") + arguments.at(i);
+  }
+  if (!arguments.empty()) {
+    sql_command += ")";
+  }
+
+  result = Tokenize(sql_command, tokens);
+  if (!result) {
+    reader.Fail(tokens.size() - 1);
+    goto done;
+  }
+
+  result = ParseExecuteCommand(reader, command) &&
+           RunPreparedStatement(*prepared_statements_.at(statement_name),
+                                command, reader);
+
+done:
+  if (!result) {
+    std::cerr << "Syntax error " << reader.DescribeError() << "!" << std::endl;
+  }
+  return result;
+}
+
+void DatabaseEngine::Deallocate(const std::string& statement_name) {
+  prepared_statements_.erase(statement_name);
+}
+
+bool DatabaseEngine::PrepareStatement(const std::string& statement_name,
+                                      TokenReader& reader) {
+  std::unique_ptr<PreparedStatement> statement(new PreparedStatement);
+
+  if (!ParsePreparedStatement(reader, *statement)) {
+    return false;
+  }
+
+  prepared_statements_[statement_name] = std::move(statement);
+  return true;
+}
+
+bool DatabaseEngine::ParsePreparedStatement(TokenReader& reader,
+                                            PreparedStatement& statement) {
+  bool result(false);
+
+  if (reader.IsKeyword(0, "INSERT")) {
+    statement.type = InsertStatement;
+    result = ParseInsertIntoCommand(reader, statement.insert_commands);
+  } else if (reader.IsKeyword(0, "SELECT")) {
+    statement.type = SelectStatement;
+    result = ParseSelectFromCommand(reader, statement.select_command);
+  } else if (reader.IsKeyword(0, "UPDATE")) {
+    statement.type = UpdateStatement;
+    result = ParseUpdateSetCommand(reader, statement.update_command);
+  } else {
+    result = reader.Fail(reader.GetIndex());
+  }
+  if (!result) {
+    return false;
+  }
+
+  CollectParameters(statement);
+  return true;
+}
+
+void DatabaseEngine::CollectParameters(PreparedStatement& statement) {
+  CreateTableColumn column_info;
+
+  statement.parameter_num = 0;
+  statement.slots.clear();
+
+  switch (statement.type) {
+    case InsertStatement: {
+      internal::TableManager& table(database_tables_.at(
+          statement.insert_commands.front().table_name));
+      for (auto& command : statement.insert_commands) {
+        for (std::size_t i = 0; i < command.parameter_list.size(); i++) {
+          AddParameterSlot(statement, command.parameter_list.at(i),
+                           table.GetColumnInfo(i), command.type_list.at(i),
+                           command.value_list.at(i));
+        }
+      }
+      break;
+    }
+    case SelectStatement: {
+      SelectFromCommand& command(statement.select_command);
+      if (command.where) {
+        CollectParameters(statement, *command.where);
+      }
+      if (command.join && command.join->where) {
+        CollectParameters(statement, *command.join->where);
+      }
+      break;
+    }
+    case UpdateStatement: {
+      UpdateSetCommand& command(statement.update_command);
+      internal::TableManager& table(database_tables_.at(command.table_name));
+      for (auto& set_clause : command.set_list) {
+        table.GetColumnInfo(set_clause.column_name, column_info);
+        AddParameterSlot(statement, set_clause.parameter, column_info,
+                         set_clause.type_code, set_clause.value);
+      }
+      column_info = {command.where.column_name,
+                     static_cast<SchemaDataType>(command.where.type_code),
+                     could_null};
+      AddParameterSlot(statement, command.where.parameter, column_info,
+                       command.where.type_code, command.where.value);
+      break;
+    }
+    default:
+      break;
+  }
+
+  // bound in the order the arguments are written, the first bad one is the
+  // error
+  std::stable_sort(statement.slots.begin(), statement.slots.end(),
+                   [](const ParameterSlot& l, const ParameterSlot& r) {
+                     return l.index < r.index;
+                   });
+}
+
+void DatabaseEngine::CollectParameters(PreparedStatement& statement,
+                                       Condition& condition) {
+  WhereClause& clause(condition.clause);
+
+  // an unbound leaf still holds the type code of its column
+  if (LeafCondition == condition.type) {
+    AddParameterSlot(statement, clause.parameter,
+                     {clause.column_name,
+                      static_cast<SchemaDataType>(clause.type_code),
+                      could_null},
+                     clause.type_code, clause.value);
+  }
+
+  for (auto& child : condition.children) {
+    CollectParameters(statement, child);
+  }
+}
+
+void DatabaseEngine::AddParameterSlot(PreparedStatement& statement,
+                                      const std::size_t& parameter,
+                                      const CreateTableColumn& column_info,
+                                      TypeCode& type_code, Value& value) {
+  if (!parameter) {
+    return;
+  }
+
+  statement.slots.push_back({parameter - 1, column_info.type,
+                             column_info.attribute, column_info.column_name,
+                             &type_code, &value});
+  statement.parameter_num = std::max(statement.parameter_num, parameter);
+}
+
+bool DatabaseEngine::RunPreparedStatement(PreparedStatement& statement,
+                                          const ExecuteCommand& command,
+                                          TokenReader& reader) {
+  if (command.arguments.size() != statement.parameter_num) {
+    std::cerr << "Prepared statement " << command.statement_name << " takes "
+              << statement.parameter_num << " arguments" << std::endl;
+    return reader.Fail(reader.GetIndex());
+  }
+
+  if (!BindParameters(statement, command, reader)) {
+    return false;
+  }
+
+  switch (statement.type) {
+    case InsertStatement:
+      ExecuteInsertIntoCommand(statement.insert_commands);
+      UpdateTableInfo(statement.insert_commands.front().table_name);
+      break;
+    case SelectStatement:
+      ExecuteSelectFromCommand(statement.select_command);
+      break;
+    case UpdateStatement:
+      ExecuteUpdateSetCommand(statement.update_command);
+      break;
+    default:
+      break;
+  }
+  return true;
+}
+
+bool DatabaseEngine::BindParameters(PreparedStatement& statement,
+                                    const ExecuteCommand& command,
+                                    TokenReader& reader) {
+  std::size_t argument_index(0);
+  std::string value;
+
+  for (auto& slot : statement.slots) {
+    argument_index = command.arguments.at(slot.index);
+    if (!ParseValue(reader.GetToken(argument_index), slot.type, value)) {
+      return reader.Fail(argument_index);
+    }
+
+    *slot.type_code = DataTypeToTypeCode(slot.type, value);
+    *slot.value = StringToValue(value, *slot.type_code);
+
+    if (IsNotNullViolate(*slot.type_code, slot.attribute)) {
+      std::cerr << (InsertStatement == statement.type ? "Insertion"
+                                                      : "Update")
+                << " aborted because Not Null violation found for column "
+                << slot.column_name << std::endl;
+      return reader.Fail(argument_index);
+    }
+  }
+  return true;
+}
+
+void DatabaseEngine::DropPreparedStatements(const std::string& table_name) {
+  auto it = prepared_statements_.begin();
+
+  // statements on a dropped table would point at a schema that is gone
+  while (it != prepared_statements_.end()) {
+    const PreparedStatement& statement(*it->second);
+    bool stale(false);
+    switch (statement.type) {
+      case InsertStatement:
+        stale = (statement.insert_commands.front().table_name == table_name);
+        break;
+      case SelectStatement:
+        stale = (statement.select_command.table_name == table_name ||
+                 (statement.select_command.join &&
+                  statement.select_command.join->table_name == table_name));
+        break;
+      case UpdateStatement:
+        stale = (statement.update_command.table_name == table_name);
+        break;
+      default:
+        break;
+    }
+    it = stale ? prepared_statements_.erase(it) : std::next(it);
+  }
+}
+
+bool DatabaseEngine::ExecuteCachedStatement(const TokenList& tokens,
+                                            TokenReader& reader,
+                                            bool& result) {
+  std::string key;
+  TokenList normalized;
+  ExecuteCommand command;
+  auto res = plan_cache_index_.end();
+
+  if (!plan_cache_size_) {
+    return false;
+  }
+
+  NormalizeStatement(tokens, key, normalized, command.arguments);
+  // more literals than placeholders, a big VALUES list is parsed as is
+  if (command.arguments.size() > max_parameter_num) {
+    return false;
+  }
+
+  res = plan_cache_index_.find(key);
+  if (res != plan_cache_index_.end()) {
+    plan_cache_.splice(plan_cache_.begin(), plan_cache_, res->second);
+  } else {
+    std::unique_ptr<PreparedStatement> statement(new PreparedStatement);
+    TokenReader normalized_reader(normalized);
+
+    // the plain parser reports what is wrong with the statement
+    if (!ParsePreparedStatement(normalized_reader, *statement) ||
+        statement->parameter_num != command.arguments.size()) {
+      return false;
+    }
+
+    ShrinkPlanCache(plan_cache_size_ - 1);
+    plan_cache_.emplace_front(key, std::move(statement));
+    plan_cache_index_.emplace(key, plan_cache_.begin());
+  }
+
+  result = RunPreparedStatement(*plan_cache_.front().second, command, reader);
+  return true;
 }
 
-bool DatabaseEngine::ParseValue(const std::string& value_str,
-                                const SchemaDataType& type,
-                                std::vector<std::string>& values) {
-  bool result(false);
+void DatabaseEngine::NormalizeStatement(const TokenList& tokens,
+                                        std::string& key,
+                                        TokenList& normalized,
+                                        std::vector<std::size_t>& literals) {
+  std::string word;
+
+  // literals become $1, $2, ... in the order written, keywords go upper case
+  // and names keep theirs
+  normalized = tokens;
+  for (std::size_t i = 0; i < tokens.size(); i++) {
+    if (IsLiteral(tokens, i)) {
+      literals.push_back(i);
+      normalized.at(i).type = ParamToken;
+      normalized.at(i).text = "$" + std::to_string(literals.size());
+      key += "? ";
+      continue;
+    }
 
-  if (Text == type) {
-    result = ExtractStr(value_str, "\\s*NULL\\s*", values);
-    if (result) {
-      // convert NULL to internal null representation (empty string)
-      values.resize(1);
-      values.front() = "";
-      return true;
-    }
-    values.resize(1);
-    return ExtractStrInQuotation(value_str, values.front());
-  } else if (Date == type || DateTime == type) {
-    values.resize(1);
-    if (ExtractStrInQuotation(value_str, values.front())) {
-      return true;
+    word = tokens.at(i).text;
+    if (WordToken == tokens.at(i).type) {
+      transform(word.begin(), word.end(), word.begin(), ::toupper);
+      if (!keywords.count(word)) {
+        word = tokens.at(i).text;
+      }
     }
+    key += word + " ";
+  }
+}
+
+bool DatabaseEngine::IsLiteral(const TokenList& tokens,
+                               const std::size_t& index) {
+  const Token& token(tokens.at(index));
+  const char c(token.text.empty() ? '\0' : token.text.front());
+
+  if (StringToken == token.type) {
+    return true;
+  } else if (WordToken != token.type) {
+    return false;
   }
 
-  result = ExtractStr(value_str, "\\s*" + regex_for_value + "\\s*", values);
-  if (!result || values.size() != 1) {
-    result = false;
+  // LIMIT and OFFSET counts are part of the plan
+  if (index && WordToken == tokens.at(index - 1).type &&
+      (!strcasecmp(tokens.at(index - 1).text.c_str(), "LIMIT") ||
+       !strcasecmp(tokens.at(index - 1).text.c_str(), "OFFSET"))) {
+    return false;
   }
-  return result;
+
+  // numbers, unquoted dates and NULL
+  return (std::isdigit(static_cast<unsigned char>(c)) ||
+          ((c == '-' || c == '.') && token.text.size() > 1) ||
+          !strcasecmp(token.text.c_str(), "NULL"));
 }
 
-bool DatabaseEngine::IsNotNullViolate(const TypeCode& type_code,
-                                      const ColumnAttribute& attr) {
-  return (IsTypeCodeNull(type_code) &&
-          (not_null == attr || primary_key == attr));
+void DatabaseEngine::ShrinkPlanCache(const std::size_t& size) {
+  while (plan_cache_.size() > size) {
+    plan_cache_index_.erase(plan_cache_.back().first);
+    plan_cache_.pop_back();
+  }
 }
 
 bool DatabaseEngine::ExecuteCreateTableCommand(
@@ -629,20 +1991,66 @@ bool DatabaseEngine::ExecuteCreateTableCommand(
 
   RegisterTable(command);
 
+  // parsed statements were checked against the old schemas
+  ShrinkPlanCache(0);
+
 done:
   return result;
 }
 
 void DatabaseEngine::ExecuteInsertIntoCommand(
-    const InsertIntoCommand& command) {
-  database_tables_.at(command.table_name).InsertInto(command);
+    const InsertIntoCommandList& commands) {
+  internal::TableManager& table(
+      database_tables_.at(commands.front().table_name));
+
+  MarkStatsStale();
+
+  if (commands.size() == 1) {
+    table.InsertInto(commands.front());
+  } else {
+    table.InsertBatch(commands);
+  }
 }
 
 void DatabaseEngine::ExecuteSelectFromCommand(
     const SelectFromCommand& command) {
-  std::cout << database_tables_.at(command.table_name)
-                   .SelectFrom(command)
-                   .second << std::flush;
+  internal::TableManager& table(database_tables_.at(command.table_name));
+  table.SetThreadPool(thread_pool_);
+  table.SetMemoryBudget(work_memory_);
+
+  if (command.join) {
+    internal::TableManager& other(
+        database_tables_.at(command.join->table_name));
+    other.SetThreadPool(thread_pool_);
+    other.SetMemoryBudget(work_memory_);
+
+    internal::JoinExecutor join(table, other, command, work_memory_);
+    join.SelectFrom(*internal::MakeResultWriter(output_mode_, std::cout));
+    return;
+  }
+
+  table.SelectFrom(command,
+                   *internal::MakeResultWriter(output_mode_, std::cout));
+}
+
+void DatabaseEngine::ExecuteExplainCommand(const SelectFromCommand& command) {
+  internal::TableManager& table(database_tables_.at(command.table_name));
+  table.SetThreadPool(thread_pool_);
+  table.SetMemoryBudget(work_memory_);
+
+  if (command.join) {
+    internal::TableManager& other(
+        database_tables_.at(command.join->table_name));
+    other.SetThreadPool(thread_pool_);
+    other.SetMemoryBudget(work_memory_);
+
+    internal::JoinExecutor join(table, other, command, work_memory_);
+    std::cout << join.Explain() << std::flush;
+    return;
+  }
+
+  std::cout << table.ExplainScan(command.table_name, table.PlanScan(command))
+            << std::flush;
 }
 
 void DatabaseEngine::ExecuteShowTablesCommand(void) {
@@ -659,49 +2067,252 @@ void DatabaseEngine::ExecuteUpdateSetCommand(const UpdateSetCommand& command) {
 void DatabaseEngine::ExecuteDropTableCommand(const DropTableCommand& command) {
   ClearTableInfo(root_schema_tables.table_name, command.table_name);
   ClearTableInfo(root_schema_columns.table_name, command.table_name);
+  database_tables_.erase(command.table_name);
+  catalog_.erase(command.table_name);
   fs::remove(FILE_PATH(command.table_name));
+  DropPreparedStatements(command.table_name);
+  ShrinkPlanCache(0);
+  ClearStatistics(command.table_name);
 }
 
-void DatabaseEngine::SplitStr(const std::string& target_str, const char delimit,
-                              std::vector<std::string>& split_str) {
-  std::stringstream str_stream(target_str);
-  std::string unit_str;
+void DatabaseEngine::ExecuteAnalyzeCommand(const AnalyzeCommand& command) {
+  std::vector<std::string> table_names;
+  internal::TableStatistics statistics;
+
+  if (!command.table_name.empty()) {
+    table_names.push_back(command.table_name);
+  } else {
+    SelectFromCommand query_tables = {root_schema_tables.table_name,
+                                      {"table_name"}};
+    for (const auto& tuple : database_tables_.at(query_tables.table_name)
+                                 .InternalSelectFrom(query_tables)) {
+      const std::string table_name(ValueCast<std::string>(tuple.front().second));
+      if (!IsCatalogTable(table_name)) {
+        table_names.push_back(table_name);
+      }
+    }
+  }
 
-  split_str.clear();
+  for (const auto& table_name : table_names) {
+    internal::TableManager* table(TryLoadTable(table_name));
+    if (!table) {
+      continue;
+    }
 
-  // TODO: check failbit
-  while (getline(str_stream, unit_str, delimit)) {
-    split_str.push_back(unit_str);
+    table->Analyze(internal::default_sample_page_num, statistics);
+    SaveStatistics(table_name, statistics);
+    std::cout << "Table " << table_name << " analyzed, "
+              << statistics.row_count << " rows in " << statistics.page_num
+              << " pages, " << statistics.sampled_page_num << " sampled"
+              << std::endl;
   }
 }
 
-bool DatabaseEngine::ExtractStr(const std::string& target_str,
-                                const std::string& regex_str,
-                                std::vector<std::string>& result_str) {
-  bool result(false);
-  // without regard to case
-  std::regex rgx(regex_str, std::regex::icase);
-  std::smatch match_result;
+void DatabaseEngine::ExecuteCopyCommand(const CopyCommand& command) {
+  internal::TableManager& table(database_tables_.at(command.table_name));
+  internal::CopyReport report;
+  table.SetThreadPool(thread_pool_);
+  table.SetMemoryBudget(work_memory_);
+
+  if (command.to_file) {
+    ExecuteCopyToCommand(command);
+    return;
+  }
 
-  result_str.clear();
+  MarkStatsStale();
 
-  result = std::regex_search(target_str.begin(), target_str.end(), match_result,
-                             rgx);
-  if (result) {
-    for (auto i = 1; i < match_result.size(); i++) {
-      result_str.push_back(match_result[i]);
+  if (!table.CopyFrom(command.file_path, {command.delimiter, command.header},
+                      report)) {
+    if (report.error_row) {
+      std::cerr << "COPY aborted at row " << report.error_row << ": ";
+    } else {
+      std::cerr << "COPY aborted: ";
     }
+    std::cerr << report.error << std::endl;
   }
 
-  return result;
+  std::cout << "Table " << command.table_name << " loaded, "
+            << report.row_num - report.duplicate_num << " rows copied";
+  if (report.duplicate_num) {
+    std::cout << ", " << report.duplicate_num << " duplicates skipped";
+  }
+  std::cout << std::endl;
+}
+
+void DatabaseEngine::ExecuteCopyToCommand(const CopyCommand& command) {
+  internal::TableManager& table(database_tables_.at(command.table_name));
+  SelectFromCommand query = {command.table_name, {"*"}, command.where};
+  std::ofstream out_stream(command.file_path,
+                           std::ios::binary | std::ios::trunc);
+  std::unique_ptr<internal::ResultWriter> writer;
+  auto start(std::chrono::steady_clock::now());
+  uint64_t row_num(0);
+  double seconds(0.0);
+  double size(0.0);
+  struct rusage usage;
+  std::ostringstream report;
+
+  if (!out_stream) {
+    std::cerr << "COPY aborted: cannot open " << command.file_path
+              << std::endl;
+    return;
+  }
+
+  if (command.binary) {
+    writer = internal::MakeResultWriter(internal::BinaryMode, out_stream);
+  } else {
+    writer.reset(new internal::CsvResultWriter(out_stream, command.header));
+  }
+  row_num = table.CopyTo(query, *writer);
+  out_stream.close();
+  if (!out_stream) {
+    std::cerr << "COPY aborted: cannot write " << command.file_path
+              << std::endl;
+    return;
+  }
+
+  seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                          start)
+                .count();
+  size = static_cast<double>(fs::file_size(command.file_path)) / (1 << 20);
+  // peak resident size of the process, in KiB on Linux
+  getrusage(RUSAGE_SELF, &usage);
+
+  report << std::fixed << std::setprecision(2) << "Table "
+         << command.table_name << " exported, " << row_num << " rows, "
+         << size << " MiB in " << seconds << " s ("
+         << (seconds > 0 ? size / seconds : 0.0) << " MiB/s), peak memory "
+         << usage.ru_maxrss / 1024.0 << " MiB";
+  std::cout << report.str() << std::endl;
+}
+
+void DatabaseEngine::BeginTransaction(void) {
+  if (in_transaction_) {
+    std::cerr << "There is already a transaction in progress" << std::endl;
+    return;
+  }
+
+  // the catalog on disk as ROLLBACK loads it again
+  Checkpoint();
+
+  // tables loaded later join in LoadTable
+  for (auto& table : database_tables_) {
+    table.second.BeginTransaction();
+  }
+  in_transaction_ = true;
+}
+
+void DatabaseEngine::CommitTransaction(void) {
+  bool dirty(false);
+
+  in_transaction_ = false;
+  // catalog entries go into the still open catalog files
+  WriteCatalogEntries();
+
+  for (const auto& table : database_tables_) {
+    dirty = dirty || table.second.HasDirtyBlocks();
+  }
+  if (!dirty) {
+    for (auto& table : database_tables_) {
+      table.second.CommitTransaction();
+    }
+    return;
+  }
+
+  // every block of every table and the new catalog roots reach the disk in
+  // the journal before any data file is written; its sync is the commit
+  utils::CommitJournal journal(journal_file);
+  for (const auto& table : database_tables_) {
+    table.second.JournalTransaction(journal);
+  }
+  journal.AddFile(hidden_file, RootTableInfoToString());
+  if (!journal.Write()) {
+    std::cerr << "COMMIT failed, cannot write " << journal_file
+              << ", the transaction is rolled back" << std::endl;
+    journal.Remove();
+    RollbackTransaction();
+    return;
+  }
+
+  // a crash from here on is finished by replaying the journal
+  for (auto& table : database_tables_) {
+    table.second.CommitTransaction();
+  }
+  SaveRootTableInfo();
+  utils::SyncFile(hidden_file);
+  journal.Remove();
+}
+
+void DatabaseEngine::RollbackTransaction(void) {
+  std::vector<std::string> table_names;
+
+  in_transaction_ = false;
+
+  for (auto& table : database_tables_) {
+    table.second.RollbackTransaction();
+    if (!IsCatalogTable(table.first)) {
+      table_names.push_back(table.first);
+    }
+  }
+
+  // pages, root pages and row stats in memory may all be stale; cached
+  // statements expect their tables loaded
+  database_tables_.clear();
+  LoadCatalog();
+  for (const auto& table_name : table_names) {
+    TryLoadTable(table_name);
+  }
+}
+
+void DatabaseEngine::ExecuteSetVariableCommand(
+    const SetVariableCommand& command) {
+  uint64_t number(0);
+
+  if (command.variable_name == "parallelism") {
+    std::size_t max_parallelism(
+        std::max(std::thread::hardware_concurrency(), 1u) *
+        max_parallelism_per_core);
+    if (!ParseVariableNumber(command.value, number) || number < 1 ||
+        number > max_parallelism) {
+      std::cerr << "Variable parallelism must be a positive integer up to "
+                << max_parallelism << std::endl;
+      return;
+    }
+
+    std::size_t parallelism(number);
+    if (parallelism == 1) {
+      thread_pool_.reset();
+    } else if (!thread_pool_ || thread_pool_->GetThreadNum() != parallelism) {
+      thread_pool_ = std::make_shared<utils::ThreadPool>(parallelism);
+    }
+  } else if (command.variable_name == "plan_cache_size") {
+    if (!ParseVariableNumber(command.value, number)) {
+      std::cerr << "Variable plan_cache_size must be a number of statements"
+                << std::endl;
+      return;
+    }
+
+    plan_cache_size_ = number;
+    ShrinkPlanCache(plan_cache_size_);
+  } else if (command.variable_name == "work_memory") {
+    if (!ParseVariableNumber(command.value, number) || number < 1) {
+      std::cerr << "Variable work_memory must be a positive number of bytes"
+                << std::endl;
+      return;
+    }
+
+    work_memory_ = number;
+  } else {
+    std::cerr << "Unknown system variable " << command.variable_name
+              << std::endl;
+  }
 }
 
 const int32_t DatabaseEngine::GetMaxRowid(const std::string& target_table) {
-  SelectFromCommand query_rowid_count = {target_table, {"table_name"}};
+  const internal::TableManager& table(database_tables_.at(target_table));
 
-  auto res =
-      database_tables_.at(target_table).InternalSelectFrom(query_rowid_count);
-  return res.size();
+  // 0 for an empty table
+  return table.GetRowCount() ? table.GetMaxKey() : 0;
 }
 
 void DatabaseEngine::GetRowid(const std::string& target_table,
@@ -715,7 +2326,7 @@ void DatabaseEngine::GetRowid(const std::string& target_table,
   SelectFromCommand query_rowid = {
       target_table,
       {"row_id"},
-      std::experimental::make_optional(where_condition)};
+      std::experimental::make_optional(Condition(where_condition))};
 
   tables_query_result = database_tables_.at(query_rowid.table_name)
                             .InternalSelectFrom(query_rowid);
@@ -723,7 +2334,7 @@ void DatabaseEngine::GetRowid(const std::string& target_table,
   rowid.clear();
 
   for (auto tuple_result : tables_query_result) {
-    int32_t row_id = expr::any_cast<int32_t>(tuple_result.front().second);
+    int32_t row_id = ValueCast<int32_t>(tuple_result.front().second);
     rowid.push_back(row_id);
   }
 }
@@ -731,55 +2342,33 @@ void DatabaseEngine::GetRowid(const std::string& target_table,
 void DatabaseEngine::ClearTableInfo(const std::string& target_table,
                                     const std::string& condition_table) {
   std::vector<int32_t> rowid_list;
-  int32_t max_row_id;
   DeleteFromCommand delete_record;
-  UpdateSetCommand update_rowid;
 
-  max_row_id = GetMaxRowid(target_table);
   GetRowid(target_table, condition_table, rowid_list);
 
-  // do clearance
+  // do clearance, row ids are allocated past the max key so the gaps stay
   for (auto rowid : rowid_list) {
     delete_record = {target_table, {"row_id", Equal, Int, rowid}};
     database_tables_.at(target_table).DeleteFrom(delete_record);
   }
-
-  // update rowid after deleted tuples
-  int32_t max_del_rowid = rowid_list.back();
-  if (max_del_rowid < max_row_id) {
-    for (auto i = 0; i < max_row_id - rowid_list.back(); i++) {
-      update_rowid = {target_table,
-                      {{"row_id", Int, rowid_list.at(i)}},
-                      {"row_id", Equal, Int, max_del_rowid + i + 1}};
-      database_tables_.at(target_table).UpdateSet(update_rowid);
-    }
-  }
 }
 
 void DatabaseEngine::RegisterTable(const CreateTableCommand& table_schema) {
   InsertIntoCommand insert_tables;
   InsertIntoCommand insert_columns;
-  SelectFromCommand query_tables_rowid = {root_schema_tables.table_name,
-                                          {"table_name"}};
-  SelectFromCommand query_columns_rowid = {root_schema_columns.table_name,
-                                           {"table_name"}};
 
   // row id
-  auto res = database_tables_.at(query_tables_rowid.table_name)
-                 .SelectFrom(query_tables_rowid);
-  int32_t tables_row_id = res.first;
-
-  res = database_tables_.at(query_columns_rowid.table_name)
-            .SelectFrom(query_columns_rowid);
-  int32_t columns_row_id = res.first;
+  int32_t tables_row_id = GetMaxRowid(root_schema_tables.table_name);
+  int32_t columns_row_id = GetMaxRowid(root_schema_columns.table_name);
 
   // tables
   insert_tables = {
       root_schema_tables.table_name,
       {Int, static_cast<TypeCode>(Text + table_schema.table_name.size()), Int,
-       Int},
+       Int, BigInt, Int},
       {++tables_row_id, table_schema.table_name, static_cast<int32_t>(0),
-       static_cast<int32_t>(std::numeric_limits<int32_t>::max())}};
+       static_cast<int32_t>(std::numeric_limits<int32_t>::max()),
+       static_cast<int64_t>(0), static_cast<int32_t>(0)}};
   database_tables_.at(insert_tables.table_name).InsertInto(insert_tables);
 
   // columns
@@ -804,172 +2393,461 @@ void DatabaseEngine::RegisterTable(const CreateTableCommand& table_schema) {
                        static_cast<int8_t>(i + 1), is_nullable, column_key}};
     database_tables_.at(insert_columns.table_name).InsertInto(insert_columns);
   }
+
+  CatalogEntry entry = {tables_row_id,
+                        {0, std::numeric_limits<int32_t>::max(), true, 0, 0},
+                        table_schema,
+                        false,
+                        false};
+  catalog_[table_schema.table_name] = entry;
 }
 
 internal::TableManager* DatabaseEngine::LoadTable(
     const std::string& table_name) {
-  TableInfo table_info = LoadTableInfo(table_name);
-  sql::CreateTableCommand table_schema = LoadSchema(table_name);
+  const CatalogEntry& entry(catalog_.at(table_name));
 
   // load table
   auto res = database_tables_.emplace(
       table_name, internal::TableManager(FILE_PATH(table_name)));
-  res.first->second.Load(table_schema, table_info.first, table_info.second);
-
-  return &(res.first->second);
-}
-
-const std::pair<int32_t, int32_t> DatabaseEngine::LoadTableInfo(
-    const std::string& table_name) {
-  sql::CreateTableCommand table_schema;
-  std::vector<sql::TypeValueList> tables_query_result;
-
-  // query info from root tables
-  WhereClause where_condition = {
-      "table_name", Equal, static_cast<TypeCode>(Text + table_name.size()),
-      table_name};
-  SelectFromCommand query_tables_info = {
-      root_schema_tables.table_name,
-      {"*"},
-      std::experimental::make_optional(where_condition)};
-
-  tables_query_result = database_tables_.at(root_schema_tables.table_name)
-                            .InternalSelectFrom(query_tables_info);
-
-  // fanout
-  int32_t root_page =
-      expr::any_cast<int32_t>(tables_query_result.front().at(2).second);
-  // root page
-  int32_t fanout =
-      expr::any_cast<int32_t>(tables_query_result.front().at(3).second);
+  internal::TableManager* table(&(res.first->second));
+  table->Load(entry.schema, entry.info.root_page, entry.info.fanout);
+  RestoreRowStats(entry.info, *table);
+  LoadStatistics(table_name, *table);
+  if (in_transaction_) {
+    table->BeginTransaction();
+  }
 
-  return std::make_pair(root_page, fanout);
+  return table;
 }
 
-const CreateTableCommand DatabaseEngine::LoadSchema(
-    const std::string& table_name) {
-  sql::CreateTableCommand table_schema;
-  std::vector<sql::TypeValueList> columns_query_result;
+void DatabaseEngine::LoadCatalogEntries(void) {
+  SelectFromCommand query_tables = {root_schema_tables.table_name, {"*"}};
+  SelectFromCommand query_columns = {root_schema_columns.table_name, {"*"}};
+  CreateTableColumn column;
+  std::string attribute;
 
-  // query info from root tables
-  WhereClause where_condition = {
-      "table_name", Equal, static_cast<TypeCode>(Text + table_name.size()),
-      table_name};
-  SelectFromCommand query_columns_schema = {
-      root_schema_columns.table_name,
-      {"*"},
-      std::experimental::make_optional(where_condition)};
+  for (const auto& entry_tuple : database_tables_.at(query_tables.table_name)
+                                     .InternalSelectFrom(query_tables)) {
+    CatalogEntry entry = {};
+    entry.row_id = ValueCast<int32_t>(entry_tuple.at(0).second);
+    entry.schema.table_name = ValueCast<std::string>(entry_tuple.at(1).second);
+    entry.info.root_page = ValueCast<int32_t>(entry_tuple.at(2).second);
+    entry.info.fanout = ValueCast<int32_t>(entry_tuple.at(3).second);
+    // row stats, NULL when the entry predates them
+    entry.legacy = IsTypeCodeNull(entry_tuple.at(4).first);
+    entry.info.with_row_stats = !entry.legacy && !stats_stale_;
+    if (!entry.legacy) {
+      entry.info.row_count = ValueCast<int64_t>(entry_tuple.at(4).second);
+      entry.info.max_key = ValueCast<int32_t>(entry_tuple.at(5).second);
+    }
+    catalog_.emplace(entry.schema.table_name, entry);
+  }
 
-  columns_query_result = database_tables_.at(root_schema_columns.table_name)
-                             .InternalSelectFrom(query_columns_schema);
+  // columns come in the order they were registered
+  for (const auto& column_tuple : database_tables_.at(query_columns.table_name)
+                                      .InternalSelectFrom(query_columns)) {
+    auto res =
+        catalog_.find(ValueCast<std::string>(column_tuple.at(1).second));
+    if (res == catalog_.end()) {
+      continue;
+    }
 
-  // form schema
-  table_schema.table_name = table_name;
-  CreateTableColumn column;
-  std::string attribute;
-  for (auto result_tuple : columns_query_result) {
-    column.column_name = expr::any_cast<std::string>(result_tuple.at(2).second);
+    column.column_name = ValueCast<std::string>(column_tuple.at(2).second);
     column.type = StringToSchemaDataType(
-        expr::any_cast<std::string>(result_tuple.at(3).second));
+        ValueCast<std::string>(column_tuple.at(3).second));
     // first check column_key
-    attribute = expr::any_cast<std::string>(result_tuple.at(6).second);
+    attribute = ValueCast<std::string>(column_tuple.at(6).second);
     if (attribute == "PRI") {
       column.attribute = primary_key;
     } else {
       // second check is_nullable
-      attribute = expr::any_cast<std::string>(result_tuple.at(5).second);
+      attribute = ValueCast<std::string>(column_tuple.at(5).second);
       column.attribute = (attribute == "YES") ? could_null : not_null;
     }
-    table_schema.column_list.push_back(column);
+    res->second.schema.column_list.push_back(column);
   }
-
-  return table_schema;
 }
 
 const TableInfo DatabaseEngine::LoadRootTableInfo(
     const std::string& table_name) {
-  int32_t root_page(0);
-  int32_t fanout(0);
+  TableInfo table_info = {};
+  std::string line;
   std::ifstream infile(hidden_file);
 
+  // root_page fanout [row_count max_key]
   if (table_name == root_schema_tables.table_name) {
-    infile >> root_page >> fanout;
+    std::getline(infile, line);
   } else if (table_name == root_schema_columns.table_name) {
     infile.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-    infile >> root_page >> fanout;
+    std::getline(infile, line);
   }
 
   infile.close();
 
-  return std::make_pair(root_page, fanout);
+  std::istringstream fields(line);
+  fields >> table_info.root_page >> table_info.fanout;
+  table_info.with_row_stats =
+      static_cast<bool>(fields >> table_info.row_count >> table_info.max_key);
+
+  return table_info;
+}
+
+void DatabaseEngine::RestoreRowStats(const TableInfo& table_info,
+                                     internal::TableManager& table) {
+  if (table_info.with_row_stats) {
+    table.SetRowStats(table_info.row_count, table_info.max_key);
+  } else {
+    table.CountRows();
+  }
 }
 
 void DatabaseEngine::UpdateTableInfo(const std::string& table_name) {
   // table must be loaded
-  if (database_tables_.find(table_name) == database_tables_.end()) {
+  if (database_tables_.find(table_name) == database_tables_.end() ||
+      catalog_.find(table_name) == catalog_.end()) {
     return;
   }
 
   // get current info
-  internal::TableManager* table = &(database_tables_.at(table_name));
-  int32_t root_page = table->GetRootPage();
-  int32_t fanout = table->GetFanout();
-
-  // query table's row_id
-  std::vector<sql::TypeValueList> tables_query_result;
-  WhereClause where_condition = {
-      "table_name", Equal, static_cast<TypeCode>(Text + table_name.size()),
-      table_name};
-
-  SelectFromCommand query_rowid = {
-      root_schema_tables.table_name,
-      {"row_id"},
-      std::experimental::make_optional(where_condition)};
+  const internal::TableManager& table(database_tables_.at(table_name));
+  CatalogEntry& entry(catalog_.at(table_name));
+  TableInfo info = {table.GetRootPage(), table.GetFanout(), true,
+                    table.GetRowCount(), table.GetMaxKey()};
+  bool moved(info.root_page != entry.info.root_page ||
+             info.fanout != entry.info.fanout);
+
+  if (!moved && entry.info.with_row_stats &&
+      info.row_count == entry.info.row_count &&
+      info.max_key == entry.info.max_key) {
+    return;
+  }
+  entry.info = info;
+  entry.dirty = true;
 
-  tables_query_result = database_tables_.at(root_schema_tables.table_name)
-                            .InternalSelectFrom(query_rowid);
+  // a stale root page loses the table, stale row stats are only counts
+  if (moved && !in_transaction_) {
+    WriteTableInfo(table_name, entry);
+    // and the catalog tables, should the write have moved theirs
+    SaveRootTableInfo();
+  }
+}
 
-  int32_t row_id =
-      expr::any_cast<int32_t>(tables_query_result.front().front().second);
+void DatabaseEngine::WriteTableInfo(const std::string& table_name,
+                                    CatalogEntry& entry) {
+  const TableInfo& info(entry.info);
+
+  entry.dirty = false;
+
+  // entry predates the row stats, cells are updated in place so rewrite it
+  if (entry.legacy) {
+    DeleteFromCommand delete_record = {root_schema_tables.table_name,
+                                       {"row_id", Equal, Int, entry.row_id}};
+    InsertIntoCommand insert_tables = {
+        root_schema_tables.table_name,
+        {Int, static_cast<TypeCode>(Text + table_name.size()), Int, Int,
+         BigInt, Int},
+        {entry.row_id, table_name, info.root_page, info.fanout,
+         info.row_count, info.max_key}};
+    database_tables_.at(root_schema_tables.table_name)
+        .DeleteFrom(delete_record);
+    database_tables_.at(root_schema_tables.table_name)
+        .InsertInto(insert_tables);
+    entry.legacy = false;
+    return;
+  }
 
   // update info
-  where_condition = {"row_id", Equal, Int, row_id};
+  WhereClause where_condition = {"row_id", Equal, Int, entry.row_id};
   UpdateSetCommand update_command = {
       root_schema_tables.table_name,
-      {{"root_page", Int, root_page}, {"fanout", Int, fanout}},
+      {{"root_page", Int, info.root_page},
+       {"fanout", Int, info.fanout},
+       {"row_count", BigInt, info.row_count},
+       {"max_key", Int, info.max_key}},
       where_condition};
 
   database_tables_.at(root_schema_tables.table_name).UpdateSet(update_command);
 }
 
-void DatabaseEngine::SaveRootTableInfo(void) {
-  int32_t root_page;
-  int32_t fanout;
+void DatabaseEngine::WriteCatalogEntries(void) {
+  for (auto& entry : catalog_) {
+    if (entry.second.dirty) {
+      WriteTableInfo(entry.first, entry.second);
+    }
+  }
+}
+
+void DatabaseEngine::Checkpoint(void) {
+  WriteCatalogEntries();
+  SaveRootTableInfo();
+  if (stats_stale_) {
+    fs::remove(stale_stats_file);
+    stats_stale_ = false;
+  }
+}
+
+void DatabaseEngine::MarkStatsStale(void) {
+  // COMMIT writes the row stats with the rows
+  if (stats_stale_ || in_transaction_) {
+    return;
+  }
+
+  std::ofstream marker(stale_stats_file);
+  marker.close();
+  stats_stale_ = true;
+}
+
+void DatabaseEngine::RecountRowStats(void) {
+  std::vector<std::string> table_names;
+
+  // the catalog tables were counted as they were loaded, loading the others
+  // counts theirs
+  for (const auto& entry : catalog_) {
+    if (database_tables_.find(entry.first) == database_tables_.end()) {
+      table_names.push_back(entry.first);
+    }
+  }
+  for (const auto& table_name : table_names) {
+    if (TryLoadTable(table_name)) {
+      UpdateTableInfo(table_name);
+    }
+  }
+
+  Checkpoint();
+}
+
+const std::string DatabaseEngine::RootTableInfoToString(void) {
+  std::ostringstream out_stream;
+
+  for (auto table_name :
+       {root_schema_tables.table_name, root_schema_columns.table_name}) {
+    const internal::TableManager& table(database_tables_.at(table_name));
+    out_stream << table.GetRootPage() << " " << table.GetFanout() << " "
+               << table.GetRowCount() << " " << table.GetMaxKey() << "\n";
+  }
+  return out_stream.str();
+}
 
+void DatabaseEngine::SaveRootTableInfo(void) {
   // overwrite existed one
   std::ofstream outfile(hidden_file);
 
-  root_page = database_tables_.at(root_schema_tables.table_name).GetRootPage();
-  fanout = database_tables_.at(root_schema_tables.table_name).GetFanout();
-  outfile << root_page << " " << fanout << "\n";
+  outfile << RootTableInfoToString();
+  outfile.close();
+}
+
+void DatabaseEngine::SaveStatistics(
+    const std::string& table_name,
+    const internal::TableStatistics& statistics) {
+  InsertIntoCommand insert_tables;
+  InsertIntoCommand insert_columns;
+  int32_t tables_row_id(0);
+  int32_t columns_row_id(0);
+
+  // catalog tables of the statistics come with the first ANALYZE
+  for (const auto& schema :
+       {statistics_schema_tables, statistics_schema_columns}) {
+    if (!TryLoadTable(schema.table_name)) {
+      ExecuteCreateTableCommand(schema);
+      UpdateTableInfo(root_schema_tables.table_name);
+      UpdateTableInfo(root_schema_columns.table_name);
+    }
+  }
+
+  // the previous ANALYZE is replaced
+  ClearStatistics(table_name);
 
-  root_page = database_tables_.at(root_schema_columns.table_name).GetRootPage();
-  fanout = database_tables_.at(root_schema_columns.table_name).GetFanout();
-  outfile << root_page << " " << fanout << "\n";
+  tables_row_id = GetMaxRowid(statistics_schema_tables.table_name);
+  columns_row_id = GetMaxRowid(statistics_schema_columns.table_name);
 
-  outfile.close();
+  insert_tables = {
+      statistics_schema_tables.table_name,
+      {Int, static_cast<TypeCode>(Text + table_name.size()), BigInt, Int,
+       Int},
+      {++tables_row_id, table_name, statistics.row_count,
+       static_cast<int32_t>(statistics.page_num),
+       static_cast<int32_t>(statistics.sampled_page_num)}};
+  database_tables_.at(insert_tables.table_name).InsertInto(insert_tables);
+
+  for (const auto& column : statistics.columns) {
+    const std::string histogram(internal::HistogramToString(column.histogram));
+    insert_columns = {
+        statistics_schema_columns.table_name,
+        {Int, static_cast<TypeCode>(Text + table_name.size()),
+         static_cast<TypeCode>(Text + column.column_name.size()), BigInt,
+         Double, static_cast<TypeCode>(Text + column.min_value.size()),
+         static_cast<TypeCode>(Text + column.max_value.size()),
+         static_cast<TypeCode>(Text + histogram.size())},
+        {++columns_row_id, table_name, column.column_name,
+         static_cast<int64_t>(column.distinct_num), column.null_fraction,
+         column.min_value, column.max_value, histogram}};
+    database_tables_.at(insert_columns.table_name).InsertInto(insert_columns);
+  }
+
+  UpdateTableInfo(statistics_schema_tables.table_name);
+  UpdateTableInfo(statistics_schema_columns.table_name);
+}
+
+void DatabaseEngine::LoadStatistics(const std::string& table_name,
+                                    internal::TableManager& table) {
+  internal::TableStatistics statistics = {};
+  internal::ColumnStatistics column;
+  std::vector<sql::TypeValueList> query_result;
+
+  if (IsCatalogTable(table_name) ||
+      !TryLoadTable(statistics_schema_tables.table_name) ||
+      !TryLoadTable(statistics_schema_columns.table_name)) {
+    return;
+  }
+
+  WhereClause where_condition = {
+      "table_name", Equal, static_cast<TypeCode>(Text + table_name.size()),
+      table_name};
+  SelectFromCommand query_tables = {
+      statistics_schema_tables.table_name,
+      {"row_count", "page_count", "sampled_pages"},
+      std::experimental::make_optional(Condition(where_condition))};
+  SelectFromCommand query_columns = {
+      statistics_schema_columns.table_name,
+      {"column_name", "distinct_count", "null_fraction", "min_value",
+       "max_value", "histogram"},
+      std::experimental::make_optional(Condition(where_condition))};
+
+  // never analyzed
+  query_result = database_tables_.at(query_tables.table_name)
+                     .InternalSelectFrom(query_tables);
+  if (query_result.empty()) {
+    return;
+  }
+  statistics.row_count = ValueCast<int64_t>(query_result.front().at(0).second);
+  statistics.page_num = ValueCast<int32_t>(query_result.front().at(1).second);
+  statistics.sampled_page_num =
+      ValueCast<int32_t>(query_result.front().at(2).second);
+
+  // a text NULL reads as an empty string
+  query_result = database_tables_.at(query_columns.table_name)
+                     .InternalSelectFrom(query_columns);
+  for (const auto& tuple : query_result) {
+    column.column_name = ValueCast<std::string>(tuple.at(0).second);
+    column.distinct_num = ValueCast<int64_t>(tuple.at(1).second);
+    column.null_fraction = ValueCast<double>(tuple.at(2).second);
+    column.min_value = ValueCast<std::string>(tuple.at(3).second);
+    column.max_value = ValueCast<std::string>(tuple.at(4).second);
+    column.with_range = !IsTypeCodeNull(tuple.at(3).first);
+    column.histogram =
+        internal::StringToHistogram(ValueCast<std::string>(tuple.at(5).second));
+    statistics.columns.push_back(column);
+  }
+
+  table.SetStatistics(statistics);
+}
+
+void DatabaseEngine::ClearStatistics(const std::string& table_name) {
+  for (const auto& schema :
+       {statistics_schema_tables, statistics_schema_columns}) {
+    if (schema.table_name == table_name || !TryLoadTable(schema.table_name)) {
+      continue;
+    }
+    ClearTableInfo(schema.table_name, table_name);
+    UpdateTableInfo(schema.table_name);
+  }
+}
+
+bool DatabaseEngine::IsCatalogTable(const std::string& table_name) {
+  return !table_name.compare(0, 9, "tinybase_");
+}
+
+bool DatabaseEngine::ParseRowCount(TokenReader& reader, uint64_t& row_count) {
+  const Token& token(reader.Peek());
+
+  if (WordToken != token.type || token.text.size() > 18 ||
+      !std::all_of(token.text.begin(), token.text.end(), ::isdigit)) {
+    return reader.Fail(reader.GetIndex());
+  }
+
+  row_count = std::stoull(reader.Next().text);
+  return true;
+}
+
+bool DatabaseEngine::ParseVariableNumber(const std::string& value,
+                                         uint64_t& number) {
+  // 19 digits may not fit, leading zeros count for nothing
+  auto pos = value.find_first_not_of('0');
+  if (value.empty() ||
+      !std::all_of(value.begin(), value.end(), ::isdigit) ||
+      (pos != std::string::npos && value.size() - pos > 18)) {
+    return false;
+  }
+
+  number = std::stoull(value);
+  return true;
+}
+
+bool DatabaseEngine::IsDotCommand(const std::string& line) {
+  auto pos = line.find_first_not_of(" \t");
+  return (pos != std::string::npos && line.at(pos) == '.');
+}
+
+void DatabaseEngine::ExecuteDotCommand(const std::string& line) {
+  std::istringstream in_stream(line);
+  std::string name;
+  std::string argument;
+  std::string rest;
+  internal::OutputMode mode(output_mode_);
+
+  in_stream >> name >> argument >> rest;
+  if (name != ".mode" || !rest.empty()) {
+    std::cerr << "Unknown command " << line << std::endl;
+    return;
+  }
+
+  if (argument.empty()) {
+    std::cout << "Output mode is " << internal::OutputModeToString(mode)
+              << std::endl;
+  } else if (!internal::ParseOutputMode(argument, mode)) {
+    std::cerr << "Unknown output mode " << argument
+              << ", choose table, csv, tsv, jsonl or binary" << std::endl;
+  } else {
+    output_mode_ = mode;
+  }
+}
+
+bool DatabaseEngine::IsBlank(const std::string& str) {
+  return std::all_of(str.begin(), str.end(), ::isspace);
+}
+
+bool DatabaseEngine::IsGroupColumn(const SelectFromCommand& command,
+                                   const std::string& column_name) {
+  return std::find(command.group_by.begin(), command.group_by.end(),
+                   column_name) != command.group_by.end();
 }
 
-const bool DatabaseEngine::ExtractStrInQuotation(const std::string& target,
-                                                 std::string& result_str) {
-  auto str_begin(target.find_first_of('\''));
-  auto str_end(target.find_last_of('\''));
+bool ColumnScope::Resolve(const std::string& name, std::size_t& table_index,
+                          std::string& column_name,
+                          std::string& scoped_name) const {
+  std::size_t match_num(0);
+
+  for (std::size_t i = 0; i < tables_.size(); i++) {
+    const std::string prefix(tables_.at(i).first + ".");
+    std::string column(name);
+
+    if (!name.compare(0, prefix.size(), prefix)) {
+      column = name.substr(prefix.size());
+    }
+    if (tables_.at(i).second->IsColumnValid(column)) {
+      table_index = i;
+      column_name = column;
+      ++match_num;
+    }
+  }
 
-  if (str_begin == std::string::npos || str_end == std::string::npos) {
+  // a bare name both tables have is ambiguous
+  if (match_num != 1) {
     return false;
   }
 
-  result_str = target.substr(str_begin + 1, str_end - str_begin - 1);
+  scoped_name = IsJoin() ? tables_.at(table_index).first + "." + column_name
+                         : column_name;
   return true;
 }
 
@@ -978,8 +2856,9 @@ internal::TableManager* DatabaseEngine::TryLoadTable(
   internal::TableManager* handler(nullptr);
 
   if (database_tables_.find(table_name) == database_tables_.end()) {
-    // check file
-    if (fs::exists(FILE_PATH(table_name))) {
+    // check catalog and file
+    if (catalog_.find(table_name) != catalog_.end() &&
+        fs::exists(FILE_PATH(table_name))) {
       handler = LoadTable(table_name);
     }
   } else {
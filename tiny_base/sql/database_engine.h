@@ -1,68 +1,293 @@
 #ifndef TINY_BASE_DATABASE_ENGINE_H_
 #define TINY_BASE_DATABASE_ENGINE_H_
 
+#include <list>
+#include <memory>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "sql_command.h"
+#include "sql_lexer.h"
 #include "table_manager.h"
+#include "thread_pool.h"
 
 namespace sql {
 
-using TableInfo = std::pair<int32_t, int32_t>;
+// catalog entry of a table, catalogs written before the row stats were kept
+// have none and the table is recounted on load
+struct TableInfo {
+  int32_t root_page;
+  int32_t fanout;
+  bool with_row_stats;
+  int64_t row_count;
+  int32_t max_key;
+};
+
+// A table as tinybase_tables and tinybase_columns describe it, read once and
+// kept for the session. Changes are made here first and written back later.
+struct CatalogEntry {
+  // of the row in tinybase_tables
+  int32_t row_id;
+  TableInfo info;
+  CreateTableCommand schema;
+  // info differs from the row
+  bool dirty;
+  // the row has no row stats yet
+  bool legacy;
+};
+
+// tables whose columns a statement may name. A column is written as
+// table.column, or bare when a single table has it.
+class ColumnScope {
+ public:
+  void AddTable(const std::string& table_name, internal::TableManager* table) {
+    tables_.emplace_back(table_name, table);
+  }
+
+  bool IsJoin(void) const { return tables_.size() > 1; }
+
+  internal::TableManager* GetTable(const std::size_t& table_index) const {
+    return tables_.at(table_index).second;
+  }
+
+  const std::string& GetTableName(const std::size_t& table_index) const {
+    return tables_.at(table_index).first;
+  }
+
+  // scoped_name is how the command refers to the column: bare for a single
+  // table, qualified in a join
+  bool Resolve(const std::string& name, std::size_t& table_index,
+               std::string& column_name, std::string& scoped_name) const;
+
+ private:
+  std::vector<std::pair<std::string, internal::TableManager*>> tables_;
+};
+
+enum StatementType { InsertStatement, SelectStatement, UpdateStatement };
+
+// where EXECUTE writes the argument of $(index + 1), the pointers stay valid
+// as a prepared statement never moves
+struct ParameterSlot {
+  std::size_t index;
+  SchemaDataType type;
+  ColumnAttribute attribute;
+  std::string column_name;
+  TypeCode* type_code;
+  Value* value;
+};
+
+// parsed and checked against the schema once by PREPARE, EXECUTE only binds
+// the arguments
+struct PreparedStatement {
+  StatementType type;
+  InsertIntoCommandList insert_commands;
+  SelectFromCommand select_command;
+  UpdateSetCommand update_command;
+  std::size_t parameter_num;
+  std::vector<ParameterSlot> slots;
+};
+
+// most recently used first, keyed on the normalized statement
+using PlanCacheList =
+    std::list<std::pair<std::string, std::unique_ptr<PreparedStatement>>>;
 
 class DatabaseEngine {
  public:
   DatabaseEngine(void);
   void Run(const std::string file_path);
 
+  // Prepared INSERT, SELECT or UPDATE with $1, $2, ... in place of values.
+  // Arguments are literals as written in SQL, such as 5, 'text' or NULL.
+  bool Prepare(const std::string& statement_name,
+               const std::string& sql_command);
+  bool ExecutePrepared(const std::string& statement_name,
+                       const std::vector<std::string>& arguments);
+  void Deallocate(const std::string& statement_name);
+
+  // how SELECT prints its rows, also set by .mode
+  void SetOutputMode(const internal::OutputMode& mode) { output_mode_ = mode; }
+
  private:
   static const std::string hidden_file;
-  static const std::string regex_for_name;
-  static const std::string regex_for_value;
-  static const std::string regex_for_type;
+  // redo journal of the COMMIT in progress
+  static const std::string journal_file;
+  // there while row stats on disk may be behind the tables
+  static const std::string stale_stats_file;
   static const CreateTableCommand root_schema_tables;
   static const CreateTableCommand root_schema_columns;
+  // ANALYZE results, created by the first ANALYZE
+  static const CreateTableCommand statistics_schema_tables;
+  static const CreateTableCommand statistics_schema_columns;
+  // $1 to $9999
+  static const std::size_t max_parameter_digits = 4;
+  static const std::size_t max_parameter_num = 9999;
+  static const std::size_t default_plan_cache_size = 256;
+  // threads per hardware thread SET parallelism allows at most
+  static const std::size_t max_parallelism_per_core = 4;
+  // case folded in the plan cache key
+  static const std::unordered_set<std::string> keywords;
 
   std::unordered_map<std::string, internal::TableManager> database_tables_;
+  std::unordered_map<std::string, std::unique_ptr<PreparedStatement>>
+      prepared_statements_;
+  PlanCacheList plan_cache_;
+  std::unordered_map<std::string, PlanCacheList::iterator> plan_cache_index_;
+
+  // session variables
+  utils::ThreadPoolHandle thread_pool_;
+  std::size_t work_memory_;
+  std::size_t plan_cache_size_;
+  internal::OutputMode output_mode_;
+
+  // between BEGIN and COMMIT or ROLLBACK, every loaded table keeps its
+  // writes in memory and catalog entries wait for the commit
+  bool in_transaction_;
+  std::unordered_map<std::string, CatalogEntry> catalog_;
+  bool stats_stale_;
 
   bool Execute(const std::string& sql_command);
 
-  // parser
-  bool ParseCreateTableCommand(const std::string& sql_command,
+  // parser, recursive descent over the tokens of one statement
+  bool ParseCreateTableCommand(TokenReader& reader,
                                CreateTableCommand& command);
-  bool ParseInsertIntoCommand(const std::string& sql_command,
-                              InsertIntoCommand& command);
-  bool ParseSelectFromCommand(const std::string& sql_command,
-                              SelectFromCommand& command);
-  bool ParseShowTableCommand(const std::string& sql_command);
-  bool ParseUpdateSetCommand(const std::string& sql_command,
-                             UpdateSetCommand& command);
-  bool ParseDropTableCommand(const std::string& sql_command,
-                             DropTableCommand& command);
-
-  static bool ParseValue(const std::string& value_str,
-                         const SchemaDataType& type,
-                         std::vector<std::string>& values);
+  bool ParseInsertIntoCommand(TokenReader& reader,
+                              InsertIntoCommandList& commands);
+  static bool ParseInsertRow(TokenReader& reader,
+                             internal::TableManager& table,
+                             InsertIntoCommand& command);
+  bool ParseSelectFromCommand(TokenReader& reader, SelectFromCommand& command);
+  static bool SkipSelectList(TokenReader& reader);
+  bool ParseJoin(TokenReader& reader, ColumnScope& scope,
+                 SelectFromCommand& command);
+  bool ParseShowTableCommand(TokenReader& reader);
+  static bool ParseAggregate(internal::TableManager* table,
+                             TokenReader& reader, AggregateClause& aggregate,
+                             std::string& label);
+  bool ParseUpdateSetCommand(TokenReader& reader, UpdateSetCommand& command);
+  bool ParseDropTableCommand(TokenReader& reader, DropTableCommand& command);
+  bool ParseSetVariableCommand(TokenReader& reader,
+                               SetVariableCommand& command);
+  bool ParsePrepareCommand(TokenReader& reader);
+  bool ParseExecuteCommand(TokenReader& reader, ExecuteCommand& command);
+  bool ParseDeallocateCommand(TokenReader& reader);
+  bool ParseAnalyzeCommand(TokenReader& reader, AnalyzeCommand& command);
+  bool ParseCopyCommand(TokenReader& reader, CopyCommand& command);
+  static bool ParseTransactionCommand(TokenReader& reader,
+                                      const char* keyword);
+  static bool ParseCheckpointCommand(TokenReader& reader);
+
+  // WHERE expression
+  static bool ParseCondition(const ColumnScope& scope, TokenReader& reader,
+                             Condition& condition);
+  static bool ParseConditionTerm(const ColumnScope& scope,
+                                 TokenReader& reader, Condition& condition);
+  static bool ParseConditionFactor(const ColumnScope& scope,
+                                   TokenReader& reader, Condition& condition);
+  static bool IsBetween(const TokenReader& reader);
+  static bool ParseBetween(const ColumnScope& scope, TokenReader& reader,
+                           Condition& condition);
+  // column is the token at column_index, the value is read from the reader
+  static bool ParseWhereClause(const ColumnScope& scope, TokenReader& reader,
+                               const std::size_t& column_index,
+                               const OperatorType& op, WhereClause& clause);
+
+  // WHERE of a join, every AND conjunct must name a single table and goes to
+  // the scan of that table
+  static bool SplitJoinCondition(const ColumnScope& scope,
+                                 Condition& condition,
+                                 std::vector<Condition> (&parts)[2]);
+  static bool UnqualifyCondition(const ColumnScope& scope,
+                                 Condition& condition,
+                                 std::size_t& table_index);
+  static std::experimental::optional<Condition> MakeConjunction(
+      const std::vector<Condition>& operands);
+
+  static bool ParseValue(const Token& token, const SchemaDataType& type,
+                         std::string& value);
+  // a literal or a $n placeholder, which keeps the column type and no value
+  static bool ParseBoundValue(TokenReader& reader,
+                              const CreateTableColumn& column_info,
+                              TypeCode& type_code, Value& value,
+                              std::size_t& parameter);
 
   static bool IsNotNullViolate(const TypeCode& type_code,
                                const ColumnAttribute& attr);
 
   // Executor
   bool ExecuteCreateTableCommand(const CreateTableCommand& command);
-  void ExecuteInsertIntoCommand(const InsertIntoCommand& command);
+  void ExecuteInsertIntoCommand(const InsertIntoCommandList& commands);
   void ExecuteSelectFromCommand(const SelectFromCommand& command);
+  void ExecuteExplainCommand(const SelectFromCommand& command);
   void ExecuteShowTablesCommand(void);
   void ExecuteUpdateSetCommand(const UpdateSetCommand& command);
   void ExecuteDropTableCommand(const DropTableCommand& command);
+  void ExecuteSetVariableCommand(const SetVariableCommand& command);
+  void ExecuteAnalyzeCommand(const AnalyzeCommand& command);
+  void ExecuteCopyCommand(const CopyCommand& command);
+  void ExecuteCopyToCommand(const CopyCommand& command);
+
+  // transactions
+  void BeginTransaction(void);
+  void CommitTransaction(void);
+  // loaded tables are loaded again from disk
+  void RollbackTransaction(void);
+
+  // prepared statements
+  bool PrepareStatement(const std::string& statement_name,
+                        TokenReader& reader);
+  bool ParsePreparedStatement(TokenReader& reader,
+                              PreparedStatement& statement);
+  void CollectParameters(PreparedStatement& statement);
+  static void CollectParameters(PreparedStatement& statement,
+                                Condition& condition);
+  static void AddParameterSlot(PreparedStatement& statement,
+                               const std::size_t& parameter,
+                               const CreateTableColumn& column_info,
+                               TypeCode& type_code, Value& value);
+  bool RunPreparedStatement(PreparedStatement& statement,
+                            const ExecuteCommand& command,
+                            TokenReader& reader);
+  static bool BindParameters(PreparedStatement& statement,
+                             const ExecuteCommand& command,
+                             TokenReader& reader);
+  void DropPreparedStatements(const std::string& table_name);
+
+  // plan cache, INSERT, SELECT and UPDATE with their literals taken out
+  bool ExecuteCachedStatement(const TokenList& tokens, TokenReader& reader,
+                              bool& result);
+  static void NormalizeStatement(const TokenList& tokens, std::string& key,
+                                 TokenList& normalized,
+                                 std::vector<std::size_t>& literals);
+  static bool IsLiteral(const TokenList& tokens, const std::size_t& index);
+  void ShrinkPlanCache(const std::size_t& size);
 
   // Manage table
+  void LoadCatalog(void);
+  // every entry of the catalog tables into catalog_
+  void LoadCatalogEntries(void);
   void RegisterTable(const CreateTableCommand& table_schema);
-  const TableInfo LoadTableInfo(const std::string& table_name);
   const TableInfo LoadRootTableInfo(const std::string& table_name);
-  const CreateTableCommand LoadSchema(const std::string& table_name);
   internal::TableManager* LoadTable(const std::string& table_name);
   internal::TableManager* TryLoadTable(const std::string& table_name);
+  // takes the root page, fanout and row stats of a loaded table into its
+  // entry; a moved root page or a new fanout is written at once outside a
+  // transaction, the rest waits for a checkpoint
   void UpdateTableInfo(const std::string& table_name);
+  void WriteTableInfo(const std::string& table_name, CatalogEntry& entry);
+  void WriteCatalogEntries(void);
+  // dirty entries and the roots of the catalog tables
+  void Checkpoint(void);
+  // before an INSERT or COPY FROM outside a transaction, as its row stats
+  // wait for a checkpoint
+  void MarkStatsStale(void);
+  // counts the rows of every table again when the last session ended
+  // without a checkpoint
+  void RecountRowStats(void);
+  static void RestoreRowStats(const TableInfo& table_info,
+                              internal::TableManager& table);
+  // roots and row stats of the catalog tables as the hidden file holds them
+  const std::string RootTableInfoToString(void);
+
   void SaveRootTableInfo(void);
 
   void GetRowid(const std::string& target_table,
@@ -74,16 +299,28 @@ class DatabaseEngine {
   void ClearTableInfo(const std::string& target_table,
                       const std::string& condition_table);
 
+  // statistics catalog
+  void SaveStatistics(const std::string& table_name,
+                      const internal::TableStatistics& statistics);
+  void LoadStatistics(const std::string& table_name,
+                      internal::TableManager& table);
+  void ClearStatistics(const std::string& table_name);
+  static bool IsCatalogTable(const std::string& table_name);
+
   // helper
-  static bool ExtractStr(const std::string& target_str,
-                         const std::string& regex_str,
-                         std::vector<std::string>& result_str);
+  static bool ParseRowCount(TokenReader& reader, uint64_t& row_count);
+
+  // false unless all digits and small enough for uint64_t
+  static bool ParseVariableNumber(const std::string& value, uint64_t& number);
+
+  static bool IsGroupColumn(const SelectFromCommand& command,
+                            const std::string& column_name);
 
-  static void SplitStr(const std::string& target_str, const char delimit,
-                       std::vector<std::string>& split_str);
+  // shell commands such as .mode csv
+  static bool IsDotCommand(const std::string& line);
+  void ExecuteDotCommand(const std::string& line);
 
-  static const bool ExtractStrInQuotation(const std::string& target,
-                                          std::string& result_str);
+  static bool IsBlank(const std::string& str);
 };
 
 }  // namespace sql
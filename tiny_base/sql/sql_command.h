@@ -22,29 +22,98 @@ using TypeValue = std::pair<TypeCode, Value>;
 using ValueList = std::vector<Value>;
 using TypeValueList = std::vector<TypeValue>;
 
+// one row of an INSERT
 struct InsertIntoCommand {
   std::string table_name;
   TypeCodeList type_list;
   ValueList value_list;
+  // parallel to value_list in a prepared statement, see WhereClause
+  std::vector<std::size_t> parameter_list;
 };
 
+// rows of a multi-row VALUES list in the order written
+using InsertIntoCommandList = std::vector<InsertIntoCommand>;
+
 struct WhereClause {
   std::string column_name;
   OperatorType condition_operator;
   TypeCode type_code;
   Value value;
+  // n of a $n placeholder bound at EXECUTE, 0 for a literal
+  std::size_t parameter = 0;
+};
+
+enum ConditionType { LeafCondition, AndCondition, OrCondition, NotCondition };
+
+// WHERE expression tree, leaves are single comparisons
+struct Condition {
+  ConditionType type;
+  WhereClause clause;
+  std::vector<Condition> children;
+
+  Condition(void) : type(LeafCondition) {}
+
+  Condition(const WhereClause& leaf) : type(LeafCondition), clause(leaf) {}
+
+  Condition(const ConditionType& node_type,
+            const std::vector<Condition>& operands)
+      : type(node_type), children(operands) {}
+};
+
+struct OrderByClause {
+  std::string column_name;
+  bool descending;
+};
+
+struct LimitClause {
+  uint64_t row_count;
+  uint64_t offset;
+};
+
+enum AggregateType {
+  NoAggregate,
+  CountAggregate,
+  SumAggregate,
+  MinAggregate,
+  MaxAggregate,
+  AvgAggregate
+};
+
+// aggregate in the SELECT list, column "*" is COUNT(*), NoAggregate is a
+// GROUP BY column
+struct AggregateClause {
+  AggregateType type;
+  std::string column_name;
+};
+
+// INNER JOIN of the FROM table with one more table on equal columns. WHERE
+// is split per table at parse time: the command keeps the FROM table's part
+// and the join the other's. The SELECT list and ORDER BY of a join use
+// qualified table.column names.
+struct JoinClause {
+  std::string table_name;
+  std::string left_column;
+  std::string right_column;
+  std::experimental::optional<Condition> where;
 };
 
 struct SelectFromCommand {
   std::string table_name;
   std::vector<std::string> column_name;
-  std::experimental::optional<WhereClause> where;
+  std::experimental::optional<Condition> where;
+  std::vector<std::string> group_by;
+  std::experimental::optional<OrderByClause> order_by;
+  std::experimental::optional<LimitClause> limit;
+  // parallel to column_name for aggregate queries, empty otherwise
+  std::vector<AggregateClause> aggregates;
+  std::experimental::optional<JoinClause> join;
 };
 
 struct SetClause {
   std::string column_name;
   TypeCode type_code;
   Value value;
+  std::size_t parameter = 0;
 };
 
 struct UpdateSetCommand {
@@ -62,6 +131,36 @@ struct DropTableCommand {
   std::string table_name;
 };
 
+struct SetVariableCommand {
+  std::string variable_name;
+  std::string value;
+};
+
+// empty table_name for every table
+struct AnalyzeCommand {
+  std::string table_name;
+};
+
+// COPY name FROM 'file', or COPY name [WHERE ...] TO 'file'
+struct CopyCommand {
+  std::string table_name;
+  std::string file_path;
+  bool to_file;
+  // FROM only
+  char delimiter;
+  // the first line names the columns
+  bool header;
+  // TO only
+  std::experimental::optional<Condition> where;
+  bool binary;
+};
+
+struct ExecuteCommand {
+  std::string statement_name;
+  // token indexes of the argument literals
+  std::vector<std::size_t> arguments;
+};
+
 }  // namespace sql
 
 #endif  // TINY_BASE_SQL_COMMAND_H_
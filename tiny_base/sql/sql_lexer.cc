@@ -0,0 +1,196 @@
+#include <strings.h>
+#include <cctype>
+#include <cstring>
+#include <limits>
+
+#include "sql_lexer.h"
+
+namespace sql {
+
+namespace {
+
+bool IsWordChar(const char c) {
+  // names and unquoted values such as -1.5 or 2016-01-15_12:00:05
+  return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.' ||
+         c == '-' || c == ':';
+}
+
+bool IsOperatorChar(const char c) { return c == '<' || c == '>' || c == '='; }
+
+bool IsPunctuation(const char c) {
+  return c == '(' || c == ')' || c == ',' || c == '*' || c == ';';
+}
+
+}  // namespace
+
+bool Tokenize(const std::string& statement, TokenList& tokens) {
+  std::size_t pos(0);
+  std::size_t begin(0);
+  bool result(true);
+
+  tokens.clear();
+
+  while (pos < statement.size()) {
+    const char c(statement[pos]);
+    begin = pos;
+
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      pos++;
+      continue;
+    }
+
+    if (IsWordChar(c)) {
+      while (pos < statement.size() && IsWordChar(statement[pos])) {
+        pos++;
+      }
+      tokens.push_back({WordToken, statement.substr(begin, pos - begin),
+                        begin});
+    } else if (IsOperatorChar(c)) {
+      while (pos < statement.size() && IsOperatorChar(statement[pos])) {
+        pos++;
+      }
+      tokens.push_back({SymbolToken, statement.substr(begin, pos - begin),
+                        begin});
+    } else if (c == '$' && pos + 1 < statement.size() &&
+               std::isdigit(static_cast<unsigned char>(statement[pos + 1]))) {
+      pos++;
+      while (pos < statement.size() &&
+             std::isdigit(static_cast<unsigned char>(statement[pos]))) {
+        pos++;
+      }
+      tokens.push_back({ParamToken, statement.substr(begin, pos - begin),
+                        begin});
+    } else if (IsPunctuation(c)) {
+      tokens.push_back({SymbolToken, std::string(1, c), begin});
+      pos++;
+    } else if (c == '\'') {
+      Token token = {StringToken, "", begin};
+      for (pos++; pos < statement.size(); pos++) {
+        if (statement[pos] != '\'') {
+          token.text.push_back(statement[pos]);
+        } else if (pos + 1 < statement.size() && statement[pos + 1] == '\'') {
+          token.text.push_back('\'');
+          pos++;
+        } else {
+          break;
+        }
+      }
+      if (pos >= statement.size()) {
+        result = false;
+        break;
+      }
+      pos++;
+      tokens.push_back(std::move(token));
+    } else {
+      result = false;
+      break;
+    }
+  }
+
+  // a failed scan ends at the offending character
+  if (result) {
+    tokens.push_back({EndToken, "", statement.size()});
+  } else {
+    tokens.push_back({EndToken, statement.substr(begin, 1), begin});
+  }
+
+  return result;
+}
+
+TokenReader::TokenReader(const TokenList& tokens)
+    : tokens_(tokens),
+      index_(0),
+      error_index_(std::numeric_limits<std::size_t>::max()) {}
+
+const Token& TokenReader::Peek(const std::size_t& offset) const {
+  return GetToken(index_ + offset);
+}
+
+const Token& TokenReader::GetToken(const std::size_t& index) const {
+  // past the end it stays on the EndToken
+  return tokens_.at(index < tokens_.size() ? index : tokens_.size() - 1);
+}
+
+const Token& TokenReader::Next(void) {
+  const Token& token(Peek());
+
+  if (EndToken != token.type) {
+    index_++;
+  }
+  return token;
+}
+
+bool TokenReader::IsKeyword(const std::size_t& offset,
+                            const char* keyword) const {
+  const Token& token(Peek(offset));
+
+  return (WordToken == token.type &&
+          token.text.size() == std::strlen(keyword) &&
+          !strcasecmp(token.text.c_str(), keyword));
+}
+
+bool TokenReader::IsSymbol(const std::size_t& offset,
+                           const char* symbol) const {
+  const Token& token(Peek(offset));
+
+  return (SymbolToken == token.type && token.text == symbol);
+}
+
+bool TokenReader::MatchKeyword(const char* keyword) {
+  if (!IsKeyword(0, keyword)) {
+    return false;
+  }
+
+  index_++;
+  return true;
+}
+
+bool TokenReader::MatchSymbol(const char* symbol) {
+  if (!IsSymbol(0, symbol)) {
+    return false;
+  }
+
+  index_++;
+  return true;
+}
+
+bool TokenReader::ExpectKeyword(const char* keyword) {
+  return MatchKeyword(keyword) || Fail(index_);
+}
+
+bool TokenReader::ExpectSymbol(const char* symbol) {
+  return MatchSymbol(symbol) || Fail(index_);
+}
+
+bool TokenReader::ExpectWord(std::string& word) {
+  if (WordToken != Peek().type) {
+    return Fail(index_);
+  }
+
+  word = Next().text;
+  return true;
+}
+
+bool TokenReader::ExpectEnd(void) { return AtEnd() || Fail(index_); }
+
+bool TokenReader::Fail(const std::size_t& index) {
+  // the first failure is the cause, callers unwinding add nothing
+  if (error_index_ == std::numeric_limits<std::size_t>::max()) {
+    error_index_ = index;
+  }
+  return false;
+}
+
+const std::string TokenReader::DescribeError(void) const {
+  const Token& token(GetToken(
+      error_index_ == std::numeric_limits<std::size_t>::max() ? index_
+                                                              : error_index_));
+
+  if (EndToken == token.type && token.text.empty()) {
+    return "at end of statement";
+  }
+  return "near '" + token.text + "' at position " +
+         std::to_string(token.position + 1);
+}
+
+}  // namespace sql
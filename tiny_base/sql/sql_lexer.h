@@ -0,0 +1,78 @@
+#ifndef TINY_BASE_SQL_LEXER_H_
+#define TINY_BASE_SQL_LEXER_H_
+
+#include <string>
+#include <vector>
+
+namespace sql {
+
+enum TokenType { WordToken, StringToken, ParamToken, SymbolToken, EndToken };
+
+// A word is a keyword, a name or an unquoted value, a string is the text
+// between single quotes with '' standing for a quote, a param is a $n
+// placeholder of a prepared statement, a symbol is punctuation or a
+// comparison operator. position is the offset of the first character in the
+// statement.
+struct Token {
+  TokenType type;
+  std::string text;
+  std::size_t position;
+};
+
+using TokenList = std::vector<Token>;
+
+// splits a statement in one pass, the list always ends with an EndToken.
+// A character no token starts with or an unterminated string stops the scan
+// there and gives false.
+bool Tokenize(const std::string& statement, TokenList& tokens);
+
+// Cursor over the tokens of one statement. Match* take an optional token,
+// Expect* a required one and record the first token that went wrong.
+class TokenReader {
+ public:
+  explicit TokenReader(const TokenList& tokens);
+
+  const Token& Peek(const std::size_t& offset = 0) const;
+
+  const Token& GetToken(const std::size_t& index) const;
+
+  const Token& Next(void);
+
+  std::size_t GetIndex(void) const { return index_; }
+
+  void Seek(const std::size_t& index) { index_ = index; }
+
+  bool AtEnd(void) const { return EndToken == Peek().type; }
+
+  // keywords compare without regard to case
+  bool IsKeyword(const std::size_t& offset, const char* keyword) const;
+
+  bool IsSymbol(const std::size_t& offset, const char* symbol) const;
+
+  bool MatchKeyword(const char* keyword);
+
+  bool MatchSymbol(const char* symbol);
+
+  bool ExpectKeyword(const char* keyword);
+
+  bool ExpectSymbol(const char* symbol);
+
+  bool ExpectWord(std::string& word);
+
+  bool ExpectEnd(void);
+
+  // marks the token at index as the error, always false
+  bool Fail(const std::size_t& index);
+
+  // where the statement went wrong, the current token if nothing failed
+  const std::string DescribeError(void) const;
+
+ private:
+  const TokenList& tokens_;
+  std::size_t index_;
+  std::size_t error_index_;
+};
+
+}  // namespace sql
+
+#endif  // TINY_BASE_SQL_LEXER_H_
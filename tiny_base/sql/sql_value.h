@@ -4,16 +4,17 @@
 #include <algorithm>
 #include <cstring>
 #include <ctime>
-#include <experimental/any>
+#include <functional>
 #include <iostream>
 #include <iomanip>
+#include <new>
 #include <string>
+#include <typeinfo>
+#include <utility>
 #include <vector>
 
 namespace sql {
 
-namespace expr = std::experimental;
-
 enum SchemaDataType {
   TinyInt = 0x04,
   SmallInt = 0x05,
@@ -35,7 +36,187 @@ enum NullType {
 };
 
 using TypeCode = uint8_t;
-using Value = std::experimental::any;
+
+// Tagged value of a single column. Fixed width types (DATE and DATETIME are
+// int64_t seconds) live inline, so only TEXT beyond the small string buffer
+// touches the heap.
+class Value {
+ public:
+  enum Tag : uint8_t {
+    EmptyTag,
+    Int8Tag,
+    Int16Tag,
+    Int32Tag,
+    Int64Tag,
+    FloatTag,
+    DoubleTag,
+    StringTag
+  };
+
+  Value(void) : tag_(EmptyTag) {}
+  Value(const int8_t& value) : tag_(Int8Tag) { storage_.value_8 = value; }
+  Value(const int16_t& value) : tag_(Int16Tag) { storage_.value_16 = value; }
+  Value(const int32_t& value) : tag_(Int32Tag) { storage_.value_32 = value; }
+  Value(const int64_t& value) : tag_(Int64Tag) { storage_.value_64 = value; }
+  Value(const float& value) : tag_(FloatTag) { storage_.value_float = value; }
+  Value(const double& value) : tag_(DoubleTag) {
+    storage_.value_double = value;
+  }
+  Value(const std::string& value) : tag_(StringTag) {
+    new (&storage_.value_str) std::string(value);
+  }
+  Value(std::string&& value) : tag_(StringTag) {
+    new (&storage_.value_str) std::string(std::move(value));
+  }
+
+  Value(const Value& other) : tag_(EmptyTag) { CopyFrom(other); }
+  Value(Value&& other) noexcept : tag_(EmptyTag) { MoveFrom(other); }
+
+  ~Value(void) { Reset(); }
+
+  Value& operator=(const Value& other) {
+    if (this != &other) {
+      Reset();
+      CopyFrom(other);
+    }
+    return *this;
+  }
+
+  Value& operator=(Value&& other) noexcept {
+    if (this != &other) {
+      Reset();
+      MoveFrom(other);
+    }
+    return *this;
+  }
+
+  Tag GetTag(void) const { return tag_; }
+
+  bool Empty(void) const { return (EmptyTag == tag_); }
+
+  template <typename T>
+  const T& Get(void) const;
+
+ private:
+  Tag tag_;
+  union Storage {
+    Storage(void) {}
+    ~Storage(void) {}
+    int8_t value_8;
+    int16_t value_16;
+    int32_t value_32;
+    int64_t value_64;
+    float value_float;
+    double value_double;
+    std::string value_str;
+  } storage_;
+
+  void Reset(void) {
+    if (StringTag == tag_) {
+      storage_.value_str.~basic_string();
+    }
+    tag_ = EmptyTag;
+  }
+
+  void CopyFrom(const Value& other) {
+    if (StringTag == other.tag_) {
+      new (&storage_.value_str) std::string(other.storage_.value_str);
+    } else {
+      CopyScalar(other);
+    }
+    tag_ = other.tag_;
+  }
+
+  void MoveFrom(Value& other) {
+    if (StringTag == other.tag_) {
+      new (&storage_.value_str)
+          std::string(std::move(other.storage_.value_str));
+    } else {
+      CopyScalar(other);
+    }
+    tag_ = other.tag_;
+  }
+
+  // the active fixed width member of other
+  void CopyScalar(const Value& other) {
+    switch (other.tag_) {
+      case Int8Tag:
+        storage_.value_8 = other.storage_.value_8;
+        break;
+      case Int16Tag:
+        storage_.value_16 = other.storage_.value_16;
+        break;
+      case Int32Tag:
+        storage_.value_32 = other.storage_.value_32;
+        break;
+      case Int64Tag:
+        storage_.value_64 = other.storage_.value_64;
+        break;
+      case FloatTag:
+        storage_.value_float = other.storage_.value_float;
+        break;
+      case DoubleTag:
+        storage_.value_double = other.storage_.value_double;
+        break;
+      default:
+        break;
+    }
+  }
+
+  void Check(const Tag& tag) const {
+    if (tag != tag_) {
+      throw std::bad_cast();
+    }
+  }
+};
+
+template <>
+inline const int8_t& Value::Get(void) const {
+  Check(Int8Tag);
+  return storage_.value_8;
+}
+
+template <>
+inline const int16_t& Value::Get(void) const {
+  Check(Int16Tag);
+  return storage_.value_16;
+}
+
+template <>
+inline const int32_t& Value::Get(void) const {
+  Check(Int32Tag);
+  return storage_.value_32;
+}
+
+template <>
+inline const int64_t& Value::Get(void) const {
+  Check(Int64Tag);
+  return storage_.value_64;
+}
+
+template <>
+inline const float& Value::Get(void) const {
+  Check(FloatTag);
+  return storage_.value_float;
+}
+
+template <>
+inline const double& Value::Get(void) const {
+  Check(DoubleTag);
+  return storage_.value_double;
+}
+
+template <>
+inline const std::string& Value::Get(void) const {
+  Check(StringTag);
+  return storage_.value_str;
+}
+
+// throws std::bad_cast on type mismatch
+template <typename T>
+inline const T& ValueCast(const Value& value) {
+  return value.Get<T>();
+}
 
 enum OperatorType {
   Equal,
@@ -63,71 +244,6 @@ inline bool IsTypeCodeNull(const TypeCode& type_code) {
           Text == type_code);
 }
 
-static const Value BytesToValue(const TypeCode& type_code,
-                                const std::vector<char>& bytes) {
-  Value to_value;
-
-  switch (type_code) {
-    case OneByteNull:
-    case TwoByteNull:
-    case FourByteNull:
-    case EightByteNull:
-      to_value = 0;
-      break;
-    case TinyInt: {
-      int8_t value_8;
-      std::memcpy(&value_8, bytes.data(), sizeof(value_8));
-      to_value = value_8;
-    } break;
-    case SmallInt: {
-      int16_t value_16;
-      std::memcpy(&value_16, bytes.data(), sizeof(value_16));
-      to_value = value_16;
-    } break;
-    case Int: {
-      int32_t value_32;
-      std::memcpy(&value_32, bytes.data(), sizeof(value_32));
-      to_value = value_32;
-    } break;
-    case BigInt: {
-      int64_t value_64;
-      std::memcpy(&value_64, bytes.data(), sizeof(value_64));
-      to_value = value_64;
-    } break;
-    case Real: {
-      float value_float;
-      std::memcpy(&value_float, bytes.data(), sizeof(value_float));
-      to_value = value_float;
-    } break;
-    case Double: {
-      double value_double;
-      std::memcpy(&value_double, bytes.data(), sizeof(value_double));
-      to_value = value_double;
-    } break;
-    case DateTime: {
-      int64_t value_date_time;
-      std::memcpy(&value_date_time, bytes.data(), sizeof(value_date_time));
-      to_value = value_date_time;
-    } break;
-    case Date: {
-      int64_t value_date;
-      std::memcpy(&value_date, bytes.data(), sizeof(value_date));
-      to_value = value_date;
-    } break;
-    default:
-      break;
-  }
-
-  // contain empty string for NULL
-  if (type_code >= Text) {
-    std::string value_str;
-    std::copy(bytes.begin(), bytes.end(), std::back_inserter(value_str));
-    to_value = value_str;
-  }
-
-  return to_value;
-}
-
 static void ValueToBytes(const TypeCode& type_code, const Value& value,
                          std::vector<char>& bytes) {
   // book space
@@ -137,38 +253,38 @@ static void ValueToBytes(const TypeCode& type_code, const Value& value,
   switch (type_code) {
     case OneByteNull:
     case TinyInt: {
-      int8_t value_8 = expr::any_cast<int8_t>(value);
+      int8_t value_8 = ValueCast<int8_t>(value);
       std::memcpy(bytes.data(), &value_8, size);
     } break;
     case TwoByteNull:
     case SmallInt: {
-      int16_t value_16 = expr::any_cast<int16_t>(value);
+      int16_t value_16 = ValueCast<int16_t>(value);
       std::memcpy(bytes.data(), &value_16, size);
     } break;
     case FourByteNull:
     case Int: {
-      int32_t value_32 = expr::any_cast<int32_t>(value);
+      int32_t value_32 = ValueCast<int32_t>(value);
       std::memcpy(bytes.data(), &value_32, size);
     } break;
     case EightByteNull:
     case BigInt: {
-      int64_t value_64 = expr::any_cast<int64_t>(value);
+      int64_t value_64 = ValueCast<int64_t>(value);
       std::memcpy(bytes.data(), &value_64, size);
     } break;
     case Real: {
-      float value_float = expr::any_cast<float>(value);
+      float value_float = ValueCast<float>(value);
       std::memcpy(bytes.data(), &value_float, size);
     } break;
     case Double: {
-      double value_double = expr::any_cast<double>(value);
+      double value_double = ValueCast<double>(value);
       std::memcpy(bytes.data(), &value_double, size);
     } break;
     case DateTime: {
-      int64_t value_date_time = expr::any_cast<int64_t>(value);
+      int64_t value_date_time = ValueCast<int64_t>(value);
       std::memcpy(bytes.data(), &value_date_time, size);
     } break;
     case Date: {
-      int64_t value_date = expr::any_cast<int64_t>(value);
+      int64_t value_date = ValueCast<int64_t>(value);
       std::memcpy(bytes.data(), &value_date, size);
     } break;
     default:
@@ -177,64 +293,97 @@ static void ValueToBytes(const TypeCode& type_code, const Value& value,
 
   // contain empty string for NULL
   if (type_code >= Text) {
-    std::string value_str = expr::any_cast<std::string>(value);
+    std::string value_str = ValueCast<std::string>(value);
     std::copy(value_str.begin(), value_str.end(), bytes.begin());
   }
 }
 
-static const std::string BytesToString(const TypeCode& type_code,
-                                       const std::vector<char>& bytes) {
-  std::string res_str;
+// inverse of ValueToBytes, the bytes stay in host order
+static const Value BytesToValue(const TypeCode& type_code, const char* bytes) {
+  Value value;
 
   switch (type_code) {
-    case OneByteNull:
-    case TwoByteNull:
-    case FourByteNull:
-    case EightByteNull:
-      res_str = "NULL";
-      break;
     case TinyInt: {
       int8_t value_8;
-      std::memcpy(&value_8, bytes.data(), sizeof(value_8));
-      res_str = std::to_string(value_8);
+      std::memcpy(&value_8, bytes, sizeof(value_8));
+      value = value_8;
     } break;
     case SmallInt: {
       int16_t value_16;
-      std::memcpy(&value_16, bytes.data(), sizeof(value_16));
-      res_str = std::to_string(value_16);
+      std::memcpy(&value_16, bytes, sizeof(value_16));
+      value = value_16;
     } break;
     case Int: {
       int32_t value_32;
-      std::memcpy(&value_32, bytes.data(), sizeof(value_32));
-      res_str = std::to_string(value_32);
+      std::memcpy(&value_32, bytes, sizeof(value_32));
+      value = value_32;
     } break;
-    case BigInt: {
+    case BigInt:
+    case DateTime:
+    case Date: {
       int64_t value_64;
-      std::memcpy(&value_64, bytes.data(), sizeof(value_64));
-      res_str = std::to_string(value_64);
+      std::memcpy(&value_64, bytes, sizeof(value_64));
+      value = value_64;
     } break;
     case Real: {
       float value_float;
-      std::memcpy(&value_float, bytes.data(), sizeof(value_float));
-      res_str = std::to_string(value_float);
+      std::memcpy(&value_float, bytes, sizeof(value_float));
+      value = value_float;
     } break;
     case Double: {
       double value_double;
-      std::memcpy(&value_double, bytes.data(), sizeof(value_double));
-      res_str = std::to_string(value_double);
+      std::memcpy(&value_double, bytes, sizeof(value_double));
+      value = value_double;
     } break;
+    default:
+      break;
+  }
+
+  // contain empty string for NULL
+  if (type_code >= Text) {
+    value = std::string(bytes, TypeCodeToSize(type_code));
+  }
+
+  return value;
+}
+
+static const std::string ValueToString(const TypeCode& type_code,
+                                       const Value& value) {
+  std::string res_str;
+
+  switch (type_code) {
+    case OneByteNull:
+    case TwoByteNull:
+    case FourByteNull:
+    case EightByteNull:
+      res_str = "NULL";
+      break;
+    case TinyInt:
+      res_str = std::to_string(ValueCast<int8_t>(value));
+      break;
+    case SmallInt:
+      res_str = std::to_string(ValueCast<int16_t>(value));
+      break;
+    case Int:
+      res_str = std::to_string(ValueCast<int32_t>(value));
+      break;
+    case BigInt:
+      res_str = std::to_string(ValueCast<int64_t>(value));
+      break;
+    case Real:
+      res_str = std::to_string(ValueCast<float>(value));
+      break;
+    case Double:
+      res_str = std::to_string(ValueCast<double>(value));
+      break;
     case DateTime: {
-      int64_t value_date_time;
-      std::memcpy(&value_date_time, bytes.data(), sizeof(value_date_time));
-      std::time_t date_time(value_date_time);
+      std::time_t date_time(ValueCast<int64_t>(value));
       std::stringstream str_stream;
       str_stream << std::put_time(std::localtime(&date_time), "%F_%T");
       res_str = str_stream.str();
     } break;
     case Date: {
-      int64_t value_date;
-      std::memcpy(&value_date, bytes.data(), sizeof(value_date));
-      std::time_t date(value_date);
+      std::time_t date(ValueCast<int64_t>(value));
       std::stringstream str_stream;
       str_stream << std::put_time(std::localtime(&date), "%F");
       res_str = str_stream.str();
@@ -245,9 +394,7 @@ static const std::string BytesToString(const TypeCode& type_code,
 
   // contain empty string for NULL
   if (type_code >= Text) {
-    std::string value_str;
-    std::copy(bytes.begin(), bytes.end(), std::back_inserter(value_str));
-    res_str = value_str;
+    res_str = ValueCast<std::string>(value);
   }
 
   return res_str;
@@ -310,7 +457,7 @@ inline bool Compare(const std::time_t& lhs, const std::time_t& rhs,
   return result;
 }
 
-static const bool CompareValue(const Value& lhs, const Value& rhs,
+static bool CompareValue(const Value& lhs, const Value& rhs,
                                const TypeCode& l_type_code,
                                const TypeCode& r_type_code,
                                const OperatorType& operator_type) {
@@ -324,45 +471,45 @@ static const bool CompareValue(const Value& lhs, const Value& rhs,
   // compare non-null, non-string value
   switch (l_type_code) {
     case TinyInt: {
-      int8_t lhs_value_8 = expr::any_cast<int8_t>(lhs);
-      int8_t rhs_value_8 = expr::any_cast<int8_t>(rhs);
+      int8_t lhs_value_8 = ValueCast<int8_t>(lhs);
+      int8_t rhs_value_8 = ValueCast<int8_t>(rhs);
       result = Compare(lhs_value_8, rhs_value_8, operator_type);
     } break;
     case SmallInt: {
-      int16_t lhs_value_16 = expr::any_cast<int16_t>(lhs);
-      int16_t rhs_value_16 = expr::any_cast<int16_t>(rhs);
+      int16_t lhs_value_16 = ValueCast<int16_t>(lhs);
+      int16_t rhs_value_16 = ValueCast<int16_t>(rhs);
       result = Compare(lhs_value_16, rhs_value_16, operator_type);
     } break;
     case Int: {
-      int32_t lhs_value_32 = expr::any_cast<int32_t>(lhs);
-      int32_t rhs_value_32 = expr::any_cast<int32_t>(rhs);
+      int32_t lhs_value_32 = ValueCast<int32_t>(lhs);
+      int32_t rhs_value_32 = ValueCast<int32_t>(rhs);
       result = Compare(lhs_value_32, rhs_value_32, operator_type);
     } break;
     case BigInt: {
-      int64_t lhs_value_64 = expr::any_cast<int64_t>(lhs);
-      int64_t rhs_value_64 = expr::any_cast<int64_t>(rhs);
+      int64_t lhs_value_64 = ValueCast<int64_t>(lhs);
+      int64_t rhs_value_64 = ValueCast<int64_t>(rhs);
       result = Compare(lhs_value_64, rhs_value_64, operator_type);
     } break;
     case Real: {
-      float lhs_value_float = expr::any_cast<float>(lhs);
-      float rhs_value_float = expr::any_cast<float>(rhs);
+      float lhs_value_float = ValueCast<float>(lhs);
+      float rhs_value_float = ValueCast<float>(rhs);
       result = Compare(lhs_value_float, rhs_value_float, operator_type);
     } break;
     case Double: {
-      double lhs_value_double = expr::any_cast<double>(lhs);
-      double rhs_value_double = expr::any_cast<double>(rhs);
+      double lhs_value_double = ValueCast<double>(lhs);
+      double rhs_value_double = ValueCast<double>(rhs);
       result = Compare(lhs_value_double, rhs_value_double, operator_type);
     } break;
     case DateTime: {
-      int64_t lhs_value_date_time = expr::any_cast<int64_t>(lhs);
-      int64_t rhs_value_date_time = expr::any_cast<int64_t>(rhs);
+      int64_t lhs_value_date_time = ValueCast<int64_t>(lhs);
+      int64_t rhs_value_date_time = ValueCast<int64_t>(rhs);
       std::time_t lhs_date_time(lhs_value_date_time);
       std::time_t rhs_date_time(rhs_value_date_time);
       result = Compare(lhs_date_time, rhs_date_time, operator_type);
     } break;
     case Date: {
-      int64_t lhs_value_date = expr::any_cast<int64_t>(lhs);
-      int64_t rhs_value_date = expr::any_cast<int64_t>(rhs);
+      int64_t lhs_value_date = ValueCast<int64_t>(lhs);
+      int64_t rhs_value_date = ValueCast<int64_t>(rhs);
       std::time_t lhs_date(lhs_value_date);
       std::time_t rhs_date(rhs_value_date);
       result = Compare(lhs_date, rhs_date, operator_type);
@@ -372,15 +519,150 @@ static const bool CompareValue(const Value& lhs, const Value& rhs,
   }
 
   if (l_type_code > Text && r_type_code > Text) {
-    std::string lhs_value_str = std::experimental::any_cast<std::string>(lhs);
-    std::string rhs_value_str = std::experimental::any_cast<std::string>(rhs);
+    std::string lhs_value_str = ValueCast<std::string>(lhs);
+    std::string rhs_value_str = ValueCast<std::string>(rhs);
     result = Compare(lhs_value_str, rhs_value_str, operator_type);
   }
 
   return result;
 }
 
-static const SchemaDataType StringToSchemaDataType(
+template <typename T>
+int CompareOrder(const T& lhs, const T& rhs) {
+  return (lhs > rhs) - (lhs < rhs);
+}
+
+// three way comparison for sorting, NULL sorts before any value
+static int CompareOrder(const Value& lhs, const Value& rhs,
+                              const TypeCode& l_type_code,
+                              const TypeCode& r_type_code) {
+  int order(0);
+  bool l_null(IsTypeCodeNull(l_type_code));
+  bool r_null(IsTypeCodeNull(r_type_code));
+
+  if (l_null || r_null) {
+    return static_cast<int>(r_null) - static_cast<int>(l_null);
+  }
+
+  switch (l_type_code) {
+    case TinyInt:
+      order = CompareOrder(ValueCast<int8_t>(lhs), ValueCast<int8_t>(rhs));
+      break;
+    case SmallInt:
+      order = CompareOrder(ValueCast<int16_t>(lhs), ValueCast<int16_t>(rhs));
+      break;
+    case Int:
+      order = CompareOrder(ValueCast<int32_t>(lhs), ValueCast<int32_t>(rhs));
+      break;
+    case BigInt:
+    case DateTime:
+    case Date:
+      order = CompareOrder(ValueCast<int64_t>(lhs), ValueCast<int64_t>(rhs));
+      break;
+    case Real:
+      order = CompareOrder(ValueCast<float>(lhs), ValueCast<float>(rhs));
+      break;
+    case Double:
+      order = CompareOrder(ValueCast<double>(lhs), ValueCast<double>(rhs));
+      break;
+    default:
+      break;
+  }
+
+  if (l_type_code > Text) {
+    order = ValueCast<std::string>(lhs).compare(ValueCast<std::string>(rhs));
+    order = (order > 0) - (order < 0);
+  }
+
+  return order;
+}
+
+// std::hash of an integer is the integer itself, spread the bits before
+// masking them into a slot or a partition
+static std::size_t MixHash(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+// hash consistent with CompareOrder equality, all NULLs hash alike
+static std::size_t HashValue(const Value& value,
+                                   const TypeCode& type_code) {
+  std::size_t hash(0);
+
+  if (IsTypeCodeNull(type_code)) {
+    return hash;
+  }
+
+  switch (type_code) {
+    case TinyInt:
+      hash = std::hash<int64_t>()(ValueCast<int8_t>(value));
+      break;
+    case SmallInt:
+      hash = std::hash<int64_t>()(ValueCast<int16_t>(value));
+      break;
+    case Int:
+      hash = std::hash<int64_t>()(ValueCast<int32_t>(value));
+      break;
+    case BigInt:
+    case DateTime:
+    case Date:
+      hash = std::hash<int64_t>()(ValueCast<int64_t>(value));
+      break;
+    case Real:
+      hash = std::hash<double>()(ValueCast<float>(value));
+      break;
+    case Double:
+      hash = std::hash<double>()(ValueCast<double>(value));
+      break;
+    default:
+      break;
+  }
+
+  if (type_code > Text) {
+    hash = std::hash<std::string>()(ValueCast<std::string>(value));
+  }
+
+  return hash;
+}
+
+// numeric view of a fixed width value, dates are their stored integer
+static double ValueToDouble(const Value& value,
+                                  const TypeCode& type_code) {
+  double number(0.0);
+
+  switch (type_code) {
+    case TinyInt:
+      number = ValueCast<int8_t>(value);
+      break;
+    case SmallInt:
+      number = ValueCast<int16_t>(value);
+      break;
+    case Int:
+      number = ValueCast<int32_t>(value);
+      break;
+    case BigInt:
+    case DateTime:
+    case Date:
+      number = ValueCast<int64_t>(value);
+      break;
+    case Real:
+      number = ValueCast<float>(value);
+      break;
+    case Double:
+      number = ValueCast<double>(value);
+      break;
+    default:
+      break;
+  }
+
+  return number;
+}
+
+static SchemaDataType StringToSchemaDataType(
     const std::string& type_str) {
   SchemaDataType type(InvalidType);
   std::string converted_str;
@@ -449,7 +731,7 @@ static const std::string DataTypeToString(const SchemaDataType& type) {
   return out_str;
 }
 
-static const OperatorType StringToOperator(const std::string& operator_str) {
+static OperatorType StringToOperator(const std::string& operator_str) {
   OperatorType compare_operator(InvalidOp);
 
   if (operator_str == "=") {
@@ -469,6 +751,36 @@ static const OperatorType StringToOperator(const std::string& operator_str) {
   return compare_operator;
 }
 
+// operator of NOT (lhs op rhs), a NULL operand fails both
+static OperatorType NegateOperator(const OperatorType& operator_type) {
+  OperatorType negated(InvalidOp);
+
+  switch (operator_type) {
+    case Equal:
+      negated = Unequal;
+      break;
+    case Unequal:
+      negated = Equal;
+      break;
+    case Larger:
+      negated = NotLarger;
+      break;
+    case Smaller:
+      negated = NotSmaller;
+      break;
+    case NotLarger:
+      negated = Larger;
+      break;
+    case NotSmaller:
+      negated = Smaller;
+      break;
+    default:
+      break;
+  }
+
+  return negated;
+}
+
 static const Value StringToValue(const std::string& value_str,
                                  const TypeCode& type_code) {
   Value sql_value;
@@ -539,7 +851,7 @@ inline const std::string IsAttributePrimary(const ColumnAttribute& attribute) {
   return (attribute == primary_key) ? "PRI" : "";
 }
 
-inline const ColumnAttribute StringToAttribute(const std::string& attr_str) {
+inline ColumnAttribute StringToAttribute(const std::string& attr_str) {
   ColumnAttribute attribute;
 
   if ("PRIMARY KEY" == attr_str) {
@@ -553,7 +865,7 @@ inline const ColumnAttribute StringToAttribute(const std::string& attr_str) {
   return attribute;
 }
 
-static const uint8_t DataTypeToTypeCode(const SchemaDataType& schema_type,
+static uint8_t DataTypeToTypeCode(const SchemaDataType& schema_type,
                                         const std::string& value_str) {
   uint8_t type_code = static_cast<uint8_t>(schema_type);
 
@@ -0,0 +1,13 @@
+CREATE TABLE t (id INT PRIMARY KEY, name TEXT, v DOUBLE, d DATE);
+INSERT INTO TABLE t VALUES (1, 'plain', 1.5, '2020-01-02');
+INSERT INTO TABLE t VALUES (2, 'comma, "quote"', -2.25, '1999-12-31');
+INSERT INTO TABLE t VALUES (3, 'null below', NULL, NULL);
+COPY t TO 't.csv';
+CREATE TABLE plain_copy (id INT PRIMARY KEY, name TEXT, v DOUBLE, d DATE);
+COPY plain_copy FROM 't.csv';
+SELECT * FROM plain_copy;
+COPY t WHERE id > 1 TO 'header.csv' CSV HEADER;
+CREATE TABLE header_copy (id INT PRIMARY KEY, name TEXT, v DOUBLE, d DATE);
+COPY header_copy FROM 'header.csv' HEADER;
+SELECT * FROM header_copy;
+EXIT;
@@ -0,0 +1,15 @@
+CREATE TABLE t (id INT PRIMARY KEY, a INT, s TEXT);
+INSERT INTO TABLE t VALUES (1, 10, 'x');
+INSERT INTO TABLE t VALUES (2, NULL, NULL);
+INSERT INTO TABLE t VALUES (3, 30, 'y');
+INSERT INTO TABLE t VALUES (4, 40, 'x');
+SELECT id FROM t WHERE NOT a = 10;
+SELECT id FROM t WHERE a <> 10;
+SELECT id FROM t WHERE NOT NOT a = 10;
+SELECT id FROM t WHERE NOT (a = 10 OR s = 'y');
+SELECT id FROM t WHERE NOT (a > 20 AND s = 'x');
+SELECT id FROM t WHERE NOT s = 'x';
+SELECT id FROM t WHERE a NOT BETWEEN 5 AND 15;
+SELECT id FROM t WHERE NOT a BETWEEN 35 AND 45;
+SELECT id FROM t WHERE NOT id = 2;
+EXIT;
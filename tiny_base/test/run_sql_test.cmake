@@ -0,0 +1,20 @@
+# Runs SCRIPT through TINY_BASE in an empty WORK_DIR and compares what it
+# prints with EXPECTED. COPY TO reports times and sizes, those lines are left
+# out.
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+execute_process(COMMAND ${TINY_BASE} ${SCRIPT}
+                WORKING_DIRECTORY ${WORK_DIR}
+                OUTPUT_VARIABLE output
+                ERROR_VARIABLE output
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "${SCRIPT} exited with ${result}:\n${output}")
+endif()
+
+string(REGEX REPLACE "[^\n]* exported, [^\n]*\n" "" output "${output}")
+file(READ ${EXPECTED} expected)
+if(NOT output STREQUAL expected)
+  message(FATAL_ERROR "${SCRIPT} printed:\n${output}\nexpected:\n${expected}")
+endif()
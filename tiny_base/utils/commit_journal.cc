@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include "commit_journal.h"
+#include "endian_util.h"
+
+namespace utils {
+
+namespace {
+
+const char journal_magic[] = {'T', 'B', 'J', '1'};
+constexpr uint64_t fnv_offset_basis = 14695981039346656037ULL;
+constexpr uint64_t fnv_prime = 1099511628211ULL;
+
+void HashBytes(const char* data, const std::size_t& size, uint64_t& hash) {
+  for (std::size_t i = 0; i < size; i++) {
+    hash ^= static_cast<uint8_t>(data[i]);
+    hash *= fnv_prime;
+  }
+}
+
+bool ReadBytes(std::istream& in_stream, char* data, const std::size_t& size,
+               uint64_t& hash) {
+  if (!in_stream.read(data, size)) {
+    return false;
+  }
+  HashBytes(data, size, hash);
+  return true;
+}
+
+template <typename T>
+bool ReadInteger(std::istream& in_stream, T& value, uint64_t& hash) {
+  if (!ReadBytes(in_stream, reinterpret_cast<char*>(&value), sizeof(T),
+                 hash)) {
+    return false;
+  }
+  value = SwapEndian<T>(value);
+  return true;
+}
+
+}  // namespace
+
+CommitJournal::CommitJournal(const fs::path& journal_path)
+    : journal_path_(journal_path),
+      out_stream_(journal_path, std::ios::binary | std::ios::trunc),
+      hash_(fnv_offset_basis) {
+  Append(journal_magic, sizeof(journal_magic));
+}
+
+void CommitJournal::AddBlock(const fs::path& file_path,
+                             const FileOffset& offset, const char* data,
+                             const FileOffset& length) {
+  AppendRecord(BlockRecord, file_path, offset, data, length);
+}
+
+void CommitJournal::AddFile(const fs::path& file_path,
+                            const std::string& content) {
+  AppendRecord(FileRecord, file_path, 0, content.data(), content.size());
+}
+
+bool CommitJournal::Write(void) {
+  AppendInteger<uint8_t>(EndRecord);
+  uint64_t hash(SwapEndian<uint64_t>(hash_));
+  out_stream_.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+  out_stream_.close();
+  if (!out_stream_) {
+    return false;
+  }
+
+  // the journal and its name in the directory
+  return SyncFile(journal_path_) && SyncFile(journal_path_.parent_path());
+}
+
+void CommitJournal::Remove(void) {
+  fs::remove(journal_path_);
+  SyncFile(journal_path_.parent_path());
+}
+
+void CommitJournal::Recover(const fs::path& journal_path) {
+  if (!fs::exists(journal_path)) {
+    return;
+  }
+
+  if (Replay(journal_path, false)) {
+    Replay(journal_path, true);
+  }
+  fs::remove(journal_path);
+  SyncFile(journal_path.parent_path());
+}
+
+void CommitJournal::Append(const char* data, const std::size_t& size) {
+  out_stream_.write(data, size);
+  HashBytes(data, size, hash_);
+}
+
+template <typename T>
+void CommitJournal::AppendInteger(const T& value) {
+  T big_endian(SwapEndian<T>(value));
+  Append(reinterpret_cast<const char*>(&big_endian), sizeof(T));
+}
+
+void CommitJournal::AppendRecord(const RecordKind& kind,
+                                 const fs::path& file_path,
+                                 const uint64_t& offset, const char* data,
+                                 const std::size_t& size) {
+  const std::string path(file_path.string());
+
+  AppendInteger<uint8_t>(kind);
+  AppendInteger<uint16_t>(path.size());
+  Append(path.data(), path.size());
+  AppendInteger<uint64_t>(offset);
+  AppendInteger<uint32_t>(size);
+  Append(data, size);
+}
+
+bool CommitJournal::Replay(const fs::path& journal_path, const bool& apply) {
+  std::ifstream in_stream(journal_path, std::ios::binary);
+  uint64_t hash(fnv_offset_basis);
+  char magic[sizeof(journal_magic)];
+  uint8_t kind(0);
+  uint16_t path_size(0);
+  std::string path;
+  uint64_t offset(0);
+  uint32_t size(0);
+  std::vector<char> data;
+  std::set<std::string> touched_paths;
+  uint64_t stored_hash(0);
+
+  if (!ReadBytes(in_stream, magic, sizeof(magic), hash) ||
+      !std::equal(magic, magic + sizeof(magic), journal_magic)) {
+    return false;
+  }
+
+  // no end record is a torn journal
+  while (true) {
+    if (!ReadInteger(in_stream, kind, hash)) {
+      return false;
+    } else if (EndRecord == kind) {
+      break;
+    }
+
+    if (!ReadInteger(in_stream, path_size, hash)) {
+      return false;
+    }
+    path.resize(path_size);
+    if (!ReadBytes(in_stream, &path[0], path_size, hash) ||
+        !ReadInteger(in_stream, offset, hash) ||
+        !ReadInteger(in_stream, size, hash)) {
+      return false;
+    }
+    data.resize(size);
+    if (!ReadBytes(in_stream, data.data(), size, hash)) {
+      return false;
+    }
+
+    if (!apply) {
+      continue;
+    }
+    if (FileRecord == kind) {
+      std::ofstream out_stream(path, std::ios::binary | std::ios::trunc);
+      out_stream.write(data.data(), size);
+    } else {
+      // a file appended to in the transaction may not be there at all
+      if (!fs::exists(path)) {
+        std::ofstream create_stream(path, std::ios::binary);
+      }
+      std::fstream out_stream(path,
+                              std::ios::binary | std::ios::in | std::ios::out);
+      out_stream.seekp(offset);
+      out_stream.write(data.data(), size);
+    }
+    touched_paths.insert(path);
+  }
+
+  if (!in_stream.read(reinterpret_cast<char*>(&stored_hash),
+                      sizeof(stored_hash))) {
+    return false;
+  }
+
+  for (const auto& touched_path : touched_paths) {
+    SyncFile(touched_path);
+  }
+  return (SwapEndian<uint64_t>(stored_hash) == hash);
+}
+
+}  // namespace utils
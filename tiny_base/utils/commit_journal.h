@@ -0,0 +1,67 @@
+#ifndef TINY_BASE_COMMIT_JOURNAL_H_
+#define TINY_BASE_COMMIT_JOURNAL_H_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include "file_util.h"
+
+namespace utils {
+
+// Redo journal of a COMMIT. Every block the transaction changed goes into one
+// file that is synced before any data file is touched; that sync is the
+// commit point. A crash before it leaves a torn journal and the data files as
+// they were, a crash after it leaves a whole journal that Recover applies
+// again. All integers are big endian:
+//   header  "TBJ1"
+//   record  u8 kind, u16 path size and the path, u64 offset, u32 data size
+//           and the data
+//   end     u8 end_record, u64 FNV-1a hash of all bytes before it
+class CommitJournal {
+ public:
+  explicit CommitJournal(const fs::path& journal_path);
+
+  CommitJournal(const CommitJournal&) = delete;
+
+  CommitJournal& operator=(const CommitJournal&) = delete;
+
+  void AddBlock(const fs::path& file_path, const FileOffset& offset,
+                const char* data, const FileOffset& length);
+
+  // replaces the whole file
+  void AddFile(const fs::path& file_path, const std::string& content);
+
+  // writes the end record and syncs, false when the journal did not reach
+  // the disk and the transaction must not be applied
+  bool Write(void);
+
+  // once every data file is synced
+  void Remove(void);
+
+  // applies a whole journal left by a crash and removes it, a torn one is
+  // only removed
+  static void Recover(const fs::path& journal_path);
+
+ private:
+  enum RecordKind : uint8_t { BlockRecord, FileRecord, EndRecord = 0xFF };
+
+  fs::path journal_path_;
+  std::ofstream out_stream_;
+  uint64_t hash_;
+
+  void Append(const char* data, const std::size_t& size);
+
+  template <typename T>
+  void AppendInteger(const T& value);
+
+  void AppendRecord(const RecordKind& kind, const fs::path& file_path,
+                    const uint64_t& offset, const char* data,
+                    const std::size_t& size);
+
+  // false when the journal is torn, applies the records when apply is set
+  static bool Replay(const fs::path& journal_path, const bool& apply);
+};
+
+}  // namespace utils
+
+#endif  // TINY_BASE_COMMIT_JOURNAL_H_
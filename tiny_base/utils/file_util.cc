@@ -1,8 +1,17 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+
+#include "commit_journal.h"
 #include "file_util.h"
 
 namespace utils {
 
-FileUtil::FileUtil(const fs::path& file_path) : file_path_(file_path) {
+constexpr FileOffset FileUtil::block_size;
+
+FileUtil::FileUtil(const fs::path& file_path)
+    : file_path_(file_path), in_transaction_(false), disk_size_(0) {
   Open();
 }
 
@@ -30,22 +39,127 @@ void FileUtil::Open(void) {
 
 FileSize FileUtil::GetFileSize(void) {
   file_stream_.ignore(std::numeric_limits<std::streamsize>::max());
-  return file_stream_.gcount();
+  FileSize size(file_stream_.gcount());
+
+  // blocks appended in the transaction
+  if (!dirty_blocks_.empty()) {
+    size = std::max<FileSize>(
+        size, (dirty_blocks_.rbegin()->first + 1) * block_size);
+  }
+  return size;
 }
 
 void FileUtil::Read(const FilePosition& start_position, char* data_in,
                     const FileOffset& length) {
+  FileOffset position(start_position);
+  FileOffset done(0);
+
   // TODO: error handling
-  file_stream_.seekg(start_position);
-  file_stream_.read(data_in, length);
+  if (dirty_blocks_.empty()) {
+    file_stream_.seekg(start_position);
+    file_stream_.read(data_in, length);
+    return;
+  }
+
+  // block by block, from memory when dirty
+  while (done < length) {
+    FileOffset offset(position % block_size);
+    FileOffset size(std::min(length - done, block_size - offset));
+    auto res = dirty_blocks_.find(position / block_size);
+
+    if (res != dirty_blocks_.end()) {
+      std::memcpy(data_in + done, res->second.data() + offset, size);
+    } else {
+      file_stream_.seekg(position);
+      file_stream_.read(data_in + done, size);
+    }
+    done += size;
+    position += size;
+  }
 }
 
 void FileUtil::Write(const FilePosition& start_position, const char* data_out,
                      const FileOffset& length) {
+  FileOffset position(start_position);
+  FileOffset done(0);
+
   // TODO: error handling
-  file_stream_.seekp(start_position);
-  file_stream_.write(data_out, length);
+  if (!in_transaction_) {
+    file_stream_.seekp(start_position);
+    file_stream_.write(data_out, length);
+    file_stream_.flush();
+    return;
+  }
+
+  while (done < length) {
+    FileOffset offset(position % block_size);
+    FileOffset size(std::min(length - done, block_size - offset));
+
+    std::memcpy(GetDirtyBlock(position / block_size).data() + offset,
+                data_out + done, size);
+    done += size;
+    position += size;
+  }
+}
+
+void FileUtil::Begin(void) {
   file_stream_.flush();
+  disk_size_ = fs::file_size(file_path_);
+  in_transaction_ = true;
+}
+
+void FileUtil::JournalDirtyBlocks(CommitJournal& journal) const {
+  for (const auto& block : dirty_blocks_) {
+    journal.AddBlock(file_path_, block.first * block_size,
+                     block.second.data(), block_size);
+  }
+}
+
+void FileUtil::Commit(void) {
+  in_transaction_ = false;
+  if (dirty_blocks_.empty()) {
+    return;
+  }
+
+  for (const auto& block : dirty_blocks_) {
+    file_stream_.seekp(block.first * block_size);
+    file_stream_.write(block.second.data(), block_size);
+  }
+  file_stream_.flush();
+  dirty_blocks_.clear();
+  SyncFile(file_path_);
+}
+
+void FileUtil::Rollback(void) {
+  in_transaction_ = false;
+  dirty_blocks_.clear();
+}
+
+std::vector<char>& FileUtil::GetDirtyBlock(const FileOffset& block) {
+  auto res = dirty_blocks_.find(block);
+
+  if (res == dirty_blocks_.end()) {
+    res = dirty_blocks_.emplace(block, std::vector<char>(block_size, 0)).first;
+    if (block * block_size < disk_size_) {
+      file_stream_.seekg(block * block_size);
+      file_stream_.read(res->second.data(), block_size);
+      // a short last block
+      file_stream_.clear();
+    }
+  }
+  return res->second;
+}
+
+bool SyncFile(const fs::path& file_path) {
+  // the stream has no sync of its own, any descriptor of the file will do
+  int fd(::open(file_path.c_str(), O_RDONLY));
+  bool result(false);
+
+  if (fd >= 0) {
+    result = !::fsync(fd);
+    ::close(fd);
+  }
+  return result;
 }
 
 }  // namespace utils
@@ -2,14 +2,17 @@
 #define TINY_BASE_FILE_UTIL_H_
 
 #include <fstream>
+#include <map>
 #include <memory>
 #include <string>
+#include <vector>
 #include <experimental/filesystem>
 
 namespace fs = std::experimental::filesystem;
 
 namespace utils {
 
+class CommitJournal;
 class FileUtil;
 
 using FileHandle = std::shared_ptr<FileUtil>;
@@ -36,13 +39,44 @@ class FileUtil {
   void Write(const FilePosition& start_position, const char* data_out,
              const FileOffset& length);
 
+  // Writes from Begin on stay in memory as dirty blocks that reads see.
+  // Commit writes them out in file order and syncs once, Rollback drops them.
+  // A commit over several files is only atomic with the blocks of all of
+  // them in a CommitJournal first.
+  void Begin(void);
+
+  void JournalDirtyBlocks(CommitJournal& journal) const;
+
+  void Commit(void);
+
+  void Rollback(void);
+
+  bool InTransaction(void) const { return in_transaction_; }
+
+  // other handles on the file do not see the dirty blocks
+  bool HasDirtyBlocks(void) const { return !dirty_blocks_.empty(); }
+
  private:
+  // the page size of the tables
+  static constexpr FileOffset block_size = 512;
+
   fs::path file_path_;
   std::fstream file_stream_;
+  bool in_transaction_;
+  // size on disk when the transaction began
+  FileSize disk_size_;
+  std::map<FileOffset, std::vector<char>> dirty_blocks_;
 
   void Open(void);
+
+  // the dirty copy of a block, read from disk on first use
+  std::vector<char>& GetDirtyBlock(const FileOffset& block);
 };
 
+// fsync through a descriptor of its own, a directory syncs its entries; false
+// when it could not be synced
+bool SyncFile(const fs::path& file_path);
+
 }  // namespace utils
 
 #endif  // TINY_BASE_FILE_UTIL_H_
@@ -0,0 +1,114 @@
+#include "thread_pool.h"
+
+namespace utils {
+
+ThreadPool::ThreadPool(const std::size_t& thread_num)
+    : queued_(0), pending_(0), stop_(false) {
+  for (std::size_t i = 0; i < thread_num; i++) {
+    queues_.emplace_back(new WorkQueue);
+  }
+
+  for (std::size_t i = 0; i < thread_num; i++) {
+    workers_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool(void) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::Run(std::vector<Task>& tasks) {
+  if (tasks.empty()) {
+    return;
+  }
+
+  // counted before a worker can see them, a task finished early must not
+  // take pending_ below the tasks still to come
+  std::unique_lock<std::mutex> lock(mutex_);
+  error_ = nullptr;
+  pending_ += tasks.size();
+  queued_ += tasks.size();
+
+  // deal tasks round robin, stealing evens out the rest
+  for (std::size_t i = 0; i < tasks.size(); i++) {
+    WorkQueue& queue(*queues_.at(i % queues_.size()));
+    std::lock_guard<std::mutex> queue_lock(queue.mutex);
+    queue.tasks.push_back(std::move(tasks.at(i)));
+  }
+
+  wake_.notify_all();
+  done_.wait(lock, [this] { return !pending_; });
+
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+}
+
+void ThreadPool::WorkerLoop(const std::size_t& worker) {
+  Task task;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this] { return stop_ || queued_; });
+      if (stop_) {
+        return;
+      }
+    }
+
+    while (PopTask(worker, task)) {
+      std::exception_ptr error;
+      try {
+        task(worker);
+      } catch (...) {
+        error = std::current_exception();
+      }
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (error && !error_) {
+        error_ = error;
+      }
+      if (!--pending_) {
+        done_.notify_all();
+      }
+    }
+  }
+}
+
+bool ThreadPool::PopTask(const std::size_t& worker, Task& task) {
+  // own queue first
+  {
+    WorkQueue& queue(*queues_.at(worker));
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      --queued_;
+      return true;
+    }
+  }
+
+  // steal from the others
+  for (std::size_t i = 1; i < queues_.size(); i++) {
+    WorkQueue& queue(*queues_.at((worker + i) % queues_.size()));
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+      --queued_;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+}  // namespace utils
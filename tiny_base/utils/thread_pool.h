@@ -0,0 +1,61 @@
+#ifndef TINY_BASE_THREAD_POOL_H_
+#define TINY_BASE_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+class ThreadPool;
+
+using ThreadPoolHandle = std::shared_ptr<ThreadPool>;
+
+// Fixed set of workers, each with its own task deque. A worker takes tasks
+// from the front of its own deque and steals from the back of the others
+// once it runs dry.
+class ThreadPool {
+ public:
+  // argument is the index of the worker running the task
+  using Task = std::function<void(const std::size_t&)>;
+
+  ThreadPool(const std::size_t& thread_num);
+
+  ~ThreadPool(void);
+
+  std::size_t GetThreadNum(void) const { return workers_.size(); }
+
+  // blocks until every task has finished, rethrows the first exception
+  void Run(std::vector<Task>& tasks);
+
+ private:
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::thread> workers_;
+  std::vector<std::unique_ptr<WorkQueue>> queues_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  std::atomic<std::size_t> queued_;
+  std::size_t pending_;
+  bool stop_;
+  std::exception_ptr error_;
+
+  void WorkerLoop(const std::size_t& worker);
+
+  bool PopTask(const std::size_t& worker, Task& task);
+};
+
+}  // namespace utils
+
+#endif  // TINY_BASE_THREAD_POOL_H_